@@ -0,0 +1,158 @@
+#include "AnimationClips.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Funny
+{
+	std::vector<AnimationClips::Clip> AnimationClips::m_Clips;
+	std::vector<SDL_Rect> AnimationClips::m_FrameRects;
+	std::vector<float> AnimationClips::m_FrameEnds;
+	std::unordered_map<std::string, uint32_t> AnimationClips::m_ClipIDs;
+
+	uint32_t AnimationClips::addClip(std::string name, TextureHandle texture, SDL_Point origin, const std::vector<AnimationFrame>& frames, bool loop)
+	{
+		auto existing = m_ClipIDs.find(name);
+		if (existing != m_ClipIDs.end())
+		{
+			std::cout << "Animation clip " << name << " already exists." << std::endl;
+			return existing->second;
+		}
+
+		if (frames.empty())
+		{
+			std::cout << "Animation clip " << name << " has no frames." << std::endl;
+			return INVALID_CLIP;
+		}
+
+		for (const AnimationFrame& frame : frames)
+		{
+			if (!(frame.duration > 0))
+			{
+				std::cout << "Animation clip " << name << " has a frame that doesn't last any time." << std::endl;
+				return INVALID_CLIP;
+			}
+		}
+
+		Clip clip;
+		clip.texture = texture;
+		clip.firstFrame = (uint32_t)m_FrameRects.size();
+		clip.frameCount = (uint32_t)frames.size();
+		clip.loop = loop;
+
+		bool uniform = true;
+		float end = 0;
+		for (const AnimationFrame& frame : frames)
+		{
+			end += frame.duration;
+			uniform = uniform && (frame.duration == frames[0].duration);
+
+			m_FrameRects.push_back(SDL_Rect { frame.rect.x + origin.x, frame.rect.y + origin.y, frame.rect.w, frame.rect.h });
+			m_FrameEnds.push_back(end);
+		}
+
+		clip.length = end;
+		clip.inverseLength = 1.0f / end;
+		clip.inverseFrameDuration = uniform ? 1.0f / frames[0].duration : 0;
+
+		uint32_t clipID = (uint32_t)m_Clips.size();
+		m_Clips.push_back(clip);
+		m_ClipIDs[name] = clipID;
+		return clipID;
+	}
+
+	bool AnimationClips::getClipID(std::string name, uint32_t& clipID)
+	{
+		auto found = m_ClipIDs.find(name);
+		if (found == m_ClipIDs.end())
+		{
+			return false;
+		}
+
+		clipID = found->second;
+		return true;
+	}
+
+	float AnimationClips::getClipLength(uint32_t clipID)
+	{
+		return (clipID < m_Clips.size()) ? m_Clips[clipID].length : 0;
+	}
+
+	void AnimationClips::clear()
+	{
+		m_Clips.clear();
+		m_FrameRects.clear();
+		m_FrameEnds.clear();
+		m_ClipIDs.clear();
+	}
+
+	/*
+	* Looping clips wrap with a floor rather than fmod
+	* so time stays positive when playing backwards.
+	* Clips that don't loop just hold their first or
+	* last frame once they run off either end.
+	* 
+	* Everything an Animator needs is in the compact
+	* arrays or the clip buffers, and the Renderable
+	* is found through the dense Entity to index map,
+	* so there's nothing slower than a load per
+	* Animator in here. Animators on Entities with no
+	* Renderable still advance, they just don't draw.
+	*/
+	void AnimationClips::animate(ComponentArray<Animator>& animators, ComponentArray<Renderable>& renderables, float deltaTime)
+	{
+		FUNNY_PROFILE_SCOPE("AnimateSprites");
+
+		Animator* animatorData = animators.Data();
+		Renderable* renderableData = renderables.Data();
+		const Clip* clips = m_Clips.data();
+		const SDL_Rect* frameRects = m_FrameRects.data();
+		const float* frameEnds = m_FrameEnds.data();
+		const uint32_t clipCount = (uint32_t)m_Clips.size();
+
+		const int count = animators.Size();
+		for (int i = 0; i < count; i++)
+		{
+			Animator& animator = animatorData[i];
+			if (animator.clipID >= clipCount) { continue; }
+
+			const Clip& clip = clips[animator.clipID];
+
+			float time = animator.time + deltaTime * animator.speed;
+			if (clip.loop)
+			{
+				time -= std::floor(time * clip.inverseLength) * clip.length;
+			}
+			else
+			{
+				time = std::min(std::max(time, 0.0f), clip.length);
+			}
+			animator.time = time;
+
+			uint32_t frame = 0;
+			if (clip.inverseFrameDuration > 0)
+			{
+				frame = std::min((uint32_t)(time * clip.inverseFrameDuration), clip.frameCount - 1);
+			}
+			else
+			{
+				const float* ends = frameEnds + clip.firstFrame;
+				while (frame + 1 < clip.frameCount && time >= ends[frame])
+				{
+					frame++;
+				}
+			}
+
+			int renderableIndex = renderables.GetIndex(animators.GetEntity(i));
+			if (renderableIndex == ComponentArray<Renderable>::INVALID_INDEX) { continue; }
+
+			Renderable& renderable = renderableData[renderableIndex];
+			renderable.sourceRect = frameRects[clip.firstFrame + frame];
+			if (clip.texture != INVALID_TEXTURE)
+			{
+				renderable.texture = clip.texture;
+			}
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include "Common.h"
+#include "ComponentArray.hpp"
+
+namespace Funny
+{
+	struct AnimationFrame
+	{
+		SDL_Rect rect;		// Where the frame is on the clip's image
+		float duration;		// In seconds
+	};
+
+	/*
+	* Every animation clip's frames, packed back to
+	* back into a few flat buffers shared by all of
+	* them, so an Animator only has to store a clip
+	* ID. Like the ResourceManager it's all static.
+	* 
+	* Clips get made from an image's texture handle
+	* and where that image starts on it (the texture
+	* can be an atlas page, see getTextureHandle) and
+	* frame rects are stored already offset by that,
+	* ready to be copied straight into a Renderable.
+	* 
+	* animate does the actual playback, advancing
+	* every Animator and writing out the frame it
+	* landed on in a single pass over the compact
+	* component arrays. Clips where every frame
+	* lasts as long (the usual case) work out their
+	* frame with a multiply instead of searching.
+	*/
+	class AnimationClips
+	{
+	public:
+		static const uint32_t INVALID_CLIP = 0xFFFFFFFF;
+
+		static uint32_t addClip(std::string name, TextureHandle texture, SDL_Point origin, const std::vector<AnimationFrame>& frames, bool loop = true);
+		static bool getClipID(std::string name, uint32_t& clipID);
+		static float getClipLength(uint32_t clipID);
+		static size_t getClipCount() { return m_Clips.size(); }
+		static size_t getFrameCount() { return m_FrameRects.size(); }
+		static void clear();
+
+		static void animate(ComponentArray<Animator>& animators, ComponentArray<Renderable>& renderables, float deltaTime);
+
+	private:
+		struct Clip
+		{
+			TextureHandle texture;
+			uint32_t firstFrame;
+			uint32_t frameCount;
+			float length;
+			float inverseLength;
+			float inverseFrameDuration;		// 0 unless every frame lasts the same amount of time
+			bool loop;
+		};
+
+		static std::vector<Clip> m_Clips;
+		static std::vector<SDL_Rect> m_FrameRects;		// Every clip's frame rects, one clip after the other
+		static std::vector<float> m_FrameEnds;			// When each frame ends, in seconds from the start of its clip
+		static std::unordered_map<std::string, uint32_t> m_ClipIDs;
+	};
+}
@@ -0,0 +1,12 @@
+#include "AnimationSystem.h"
+#include "AnimationClips.h"
+#include "Engine.h"
+
+namespace Funny
+{
+	void AnimationSystem::Update()
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+		AnimationClips::animate(*coordinator->GetComponentArray<Animator>(), *coordinator->GetComponentArray<Renderable>(), Engine::getDeltaTime());
+	}
+}
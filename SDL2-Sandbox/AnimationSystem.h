@@ -0,0 +1,22 @@
+#pragma once
+#include "System.hpp"
+
+namespace Funny
+{
+	/*
+	* Plays every Animator's clip once per tick.
+	* Rather than going through our managed set
+	* Entity by Entity, Update hands the whole
+	* Animator and Renderable arrays over to
+	* AnimationClips::animate, which walks them
+	* in one pass. The signature is still set up
+	* as Animator + Renderable so the managed set
+	* says who's animating, for anything that
+	* wants to know.
+	*/
+	class AnimationSystem : public System
+	{
+	public:
+		void Update() override;
+	};
+}
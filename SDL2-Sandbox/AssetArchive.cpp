@@ -0,0 +1,244 @@
+#include "AssetArchive.h"
+#include "Common.h"
+#include "Profiler.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Funny
+{
+	static const char ARCHIVE_MAGIC[4] = { 'F', 'P', 'A', 'K' };
+
+	/*
+	* Maps the file read only. Once the view exists
+	* it keeps the file open on its own, so the
+	* handles get closed straight away and Close
+	* only has to unmap.
+	*/
+	bool AssetArchive::Open(const std::string& path)
+	{
+		FUNNY_PROFILE_SCOPE("OpenAssetArchive");
+
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			std::cout << "Unable to open asset archive " << path << std::endl;
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		HANDLE mapping = GetFileSizeEx(file, &size) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		void* data = (mapping != nullptr) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		if (mapping != nullptr) { CloseHandle(mapping); }
+		CloseHandle(file);
+
+		if (data == nullptr)
+		{
+			std::cout << "Unable to map asset archive " << path << std::endl;
+			return false;
+		}
+
+		m_Size = (size_t)size.QuadPart;
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			std::cout << "Unable to open asset archive " << path << std::endl;
+			return false;
+		}
+
+		struct stat status;
+		void* data = (fstat(file, &status) == 0 && status.st_size > 0) ? mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+		close(file);
+
+		if (data == MAP_FAILED)
+		{
+			std::cout << "Unable to map asset archive " << path << std::endl;
+			return false;
+		}
+
+		m_Size = (size_t)status.st_size;
+#endif
+
+		m_Data = (const uint8_t*)data;
+		m_Path = path;
+
+		if (!ReadIndex())
+		{
+			std::cout << "Asset archive " << path << " is damaged or from another version, ignoring it" << std::endl;
+			Close();
+			return false;
+		}
+
+		std::cout << "Opened asset archive [" << path << "] with " << m_Images.size() << " images (" << m_Size / 1024 << " KB)" << std::endl;
+		return true;
+	}
+
+	void AssetArchive::Close()
+	{
+		if (m_Data == nullptr) { return; }
+
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+#else
+		munmap((void*)m_Data, m_Size);
+#endif
+
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Path.clear();
+		m_Images.clear();
+	}
+
+	bool AssetArchive::Find(const std::string& name, ArchivedImage& image) const
+	{
+		auto found = m_Images.find(name);
+		if (found == m_Images.end())
+		{
+			return false;
+		}
+
+		image = found->second;
+		return true;
+	}
+
+	/*
+	* Checks everything the index points at lies
+	* inside the file before trusting any of it,
+	* since a truncated write would otherwise have
+	* us reading past the end of the mapping.
+	*/
+	bool AssetArchive::ReadIndex()
+	{
+		if (m_Size < sizeof(Header)) { return false; }
+
+		Header header;
+		std::memcpy(&header, m_Data, sizeof(header));
+		if (std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header.version != VERSION) { return false; }
+		if (SDL_BYTESPERPIXEL(header.pixelFormat) != 4) { return false; }
+
+		uint64_t indexEnd = sizeof(Header) + (uint64_t)header.imageCount * sizeof(IndexEntry);
+		if (indexEnd > m_Size || header.namesOffset < indexEnd || header.namesOffset + header.namesSize > m_Size) { return false; }
+
+		const char* names = (const char*)m_Data + header.namesOffset;
+		for (uint32_t i = 0; i < header.imageCount; i++)
+		{
+			IndexEntry entry;
+			std::memcpy(&entry, m_Data + sizeof(Header) + i * sizeof(IndexEntry), sizeof(entry));
+
+			if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize) { return false; }
+			if (entry.pitch < entry.width * 4 || entry.dataOffset + (uint64_t)entry.pitch * entry.height > m_Size) { return false; }
+
+			ArchivedImage image;
+			image.pixels = m_Data + entry.dataOffset;
+			image.width = (int)entry.width;
+			image.height = (int)entry.height;
+			image.pitch = (int)entry.pitch;
+			image.format = header.pixelFormat;
+			m_Images[std::string(names + entry.nameOffset, entry.nameLength)] = image;
+		}
+
+		return true;
+	}
+
+	bool AssetArchive::Write(const std::string& path, const std::vector<std::pair<std::string, SDL_Surface*>>& images)
+	{
+		FUNNY_PROFILE_SCOPE("WriteAssetArchive");
+
+		std::vector<SDL_Surface*> converted;
+		for (const auto& image : images)
+		{
+			SDL_Surface* surface = SDL_ConvertSurfaceFormat(image.second, PIXEL_FORMAT, 0);
+			if (surface == nullptr)
+			{
+				std::cout << "Unable to convert " << image.first << " for the asset archive! SDL Error: " << SDL_GetError() << std::endl;
+				for (SDL_Surface* done : converted) { SDL_FreeSurface(done); }
+				return false;
+			}
+			converted.push_back(surface);
+		}
+
+		auto align = [](uint64_t offset) { return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT; };
+
+		std::string names;
+		std::vector<IndexEntry> index(images.size());
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			index[i].nameOffset = (uint32_t)names.size();
+			index[i].nameLength = (uint32_t)images[i].first.size();
+			index[i].width = (uint32_t)converted[i]->w;
+			index[i].height = (uint32_t)converted[i]->h;
+			index[i].pitch = (uint32_t)converted[i]->w * 4;
+			index[i].reserved = 0;
+			names += images[i].first;
+		}
+
+		Header header;
+		std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+		header.version = VERSION;
+		header.imageCount = (uint32_t)images.size();
+		header.pixelFormat = PIXEL_FORMAT;
+		header.namesOffset = sizeof(Header) + index.size() * sizeof(IndexEntry);
+		header.namesSize = names.size();
+
+		uint64_t offset = align(header.namesOffset + header.namesSize);
+		for (size_t i = 0; i < index.size(); i++)
+		{
+			index[i].dataOffset = offset;
+			offset = align(offset + (uint64_t)index[i].pitch * index[i].height);
+		}
+
+		std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		bool written = file.is_open();
+		if (written)
+		{
+			file.write((const char*)&header, sizeof(header));
+			file.write((const char*)index.data(), (std::streamsize)(index.size() * sizeof(IndexEntry)));
+			file.write(names.data(), (std::streamsize)names.size());
+
+			for (size_t i = 0; i < index.size(); i++)
+			{
+				static const char padding[DATA_ALIGNMENT] = {};
+				file.write(padding, (std::streamsize)(index[i].dataOffset - (uint64_t)file.tellp()));
+
+				SDL_LockSurface(converted[i]);
+				for (int row = 0; row < converted[i]->h; row++)
+				{
+					file.write((const char*)converted[i]->pixels + row * converted[i]->pitch, index[i].pitch);
+				}
+				SDL_UnlockSurface(converted[i]);
+			}
+
+			written = file.good();
+		}
+
+		for (SDL_Surface* surface : converted)
+		{
+			SDL_FreeSurface(surface);
+		}
+
+		if (!written)
+		{
+			std::cout << "Unable to write asset archive " << path << std::endl;
+			return false;
+		}
+
+		std::cout << "Packed " << images.size() << " images into [" << path << "] (" << offset / 1024 << " KB)" << std::endl;
+		return true;
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <SDL2/SDL.h>
+
+namespace Funny
+{
+	/*
+	* An image sitting in an open archive, ready to
+	* be handed straight to SDL_UpdateTexture. The
+	* pixels point into the archive's mapping, so
+	* they're only good for as long as it's open.
+	*/
+	struct ArchivedImage
+	{
+		const uint8_t* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+		int pitch = 0;
+		uint32_t format = 0;
+	};
+
+	/*
+	* A single file holding every image already
+	* decoded, with the color key turned into alpha,
+	* in the pixel format renderers take without
+	* converting. Opening one maps the whole file
+	* into memory and reads the index, after which
+	* loading an image is just a lookup.
+	*
+	* Layout (all little endian, as written):
+	*   Header
+	*   IndexEntry for every image
+	*   Every image's name, back to back
+	*   Every image's pixel rows, each image starting
+	*   on a 64 byte boundary
+	*
+	* Archives get made offline by Write (see the
+	* --pack-assets option) and never change once
+	* they're open.
+	*/
+	class AssetArchive
+	{
+	public:
+		static const uint32_t VERSION = 1;
+		static const uint32_t PIXEL_FORMAT = SDL_PIXELFORMAT_ARGB8888;
+
+		AssetArchive() = default;
+		~AssetArchive() { Close(); }
+
+		AssetArchive(const AssetArchive&) = delete;
+		AssetArchive& operator=(const AssetArchive&) = delete;
+
+		bool Open(const std::string& path);
+		void Close();
+		bool IsOpen() const { return m_Data != nullptr; }
+
+		// Safe from any thread while the archive is open
+		bool Find(const std::string& name, ArchivedImage& image) const;
+
+		size_t GetImageCount() const { return m_Images.size(); }
+		size_t GetSize() const { return m_Size; }
+		const std::string& GetPath() const { return m_Path; }
+
+		// Converts each surface without taking ownership of it, any color key becomes alpha
+		static bool Write(const std::string& path, const std::vector<std::pair<std::string, SDL_Surface*>>& images);
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t imageCount;
+			uint32_t pixelFormat;
+			uint64_t namesOffset;
+			uint64_t namesSize;
+		};
+
+		struct IndexEntry
+		{
+			uint32_t nameOffset;	// Into the names
+			uint32_t nameLength;
+			uint32_t width;
+			uint32_t height;
+			uint32_t pitch;
+			uint32_t reserved;
+			uint64_t dataOffset;	// From the start of the file
+		};
+
+		static const size_t DATA_ALIGNMENT = 64;
+
+		std::string m_Path;
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+		std::unordered_map<std::string, ArchivedImage> m_Images;
+
+		bool ReadIndex();
+	};
+}
@@ -0,0 +1,175 @@
+#include "AssetBenchmark.h"
+#include "Engine.h"
+#include "Profiler.h"
+#include "ResourceManager.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Funny
+{
+	/*
+	* Loads every image under a name of its own (so
+	* nothing the game already loaded gets touched)
+	* and unloads them all again afterwards. An
+	* empty archive path loads from the PNGs, with
+	* or without the decode cache. Cache stats are
+	* just for this pass.
+	*/
+	double AssetBenchmark::loadAll(const std::vector<std::string>& paths, bool decodeCache, const std::string& archivePath, DecodeCacheStats* cacheStats)
+	{
+		ResourceManager::closeDecodeCache();
+		DecodeCacheStats before = ResourceManager::getDecodeCacheStats();
+
+		int64_t start = Profiler::nowMicros();
+
+		if (decodeCache)
+		{
+			ResourceManager::openDecodeCache();
+		}
+
+		if (!archivePath.empty())
+		{
+			ResourceManager::openArchive(archivePath);
+		}
+
+		for (const std::string& path : paths)
+		{
+			ResourceManager::loadSDLTexture(path, "Asset bench " + path);
+		}
+
+		int64_t end = Profiler::nowMicros();
+
+		for (const std::string& path : paths)
+		{
+			ResourceManager::unloadTexture("Asset bench " + path);
+		}
+		ResourceManager::closeArchive();
+		ResourceManager::closeDecodeCache();
+
+		if (cacheStats != nullptr)
+		{
+			DecodeCacheStats after = ResourceManager::getDecodeCacheStats();
+			cacheStats->hits = after.hits - before.hits;
+			cacheStats->misses = after.misses - before.misses;
+			cacheStats->stale = after.stale - before.stale;
+			cacheStats->writes = after.writes - before.writes;
+			cacheStats->evictions = after.evictions - before.evictions;
+		}
+
+		return (double)(end - start) / 1000.0;
+	}
+
+	/*
+	* Only clean pages get dropped, which is all of
+	* them for files we've just read. The archive was
+	* only just written though, so that gets flushed
+	* to disk first.
+	*/
+	bool AssetBenchmark::dropFileCache(const std::vector<std::string>& paths)
+	{
+#ifdef __linux__
+		bool dropped = true;
+		for (const std::string& path : paths)
+		{
+			int file = open(path.c_str(), O_RDONLY);
+			if (file < 0)
+			{
+				dropped = false;
+				continue;
+			}
+
+			fdatasync(file);
+			dropped = (posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0) && dropped;
+			close(file);
+		}
+		return dropped;
+#else
+		(void)paths;
+		return false;
+#endif
+	}
+
+	int AssetBenchmark::run(const AssetBenchmarkSettings& settings)
+	{
+		if (Engine::isHeadless())
+		{
+			std::cout << "Asset benchmarks need a renderer, they can't run headless." << std::endl;
+			return 1;
+		}
+
+		std::vector<std::string> paths = ResourceManager::findImages(settings.directory);
+		if (paths.empty())
+		{
+			std::cout << "No images to load in " << settings.directory << std::endl;
+			return 1;
+		}
+
+		ResourceManager::closeArchive();
+		ResourceManager::closeDecodeCache();
+		ResourceManager::setDecodeCacheEnabled(true);
+		if (!ResourceManager::packAssets(settings.directory, settings.archivePath))
+		{
+			return 1;
+		}
+
+		std::error_code error;
+		std::string gameCacheDirectory = ResourceManager::getDecodeCacheDirectory();
+		std::string cacheDirectory = (std::filesystem::temp_directory_path(error) / "funny-asset-bench-cache").string();
+
+		std::filesystem::remove_all(cacheDirectory, error);
+		if (error)
+		{
+			std::cout << "Unable to empty decode cache directory " << cacheDirectory << ": " << error.message() << std::endl;
+			return 1;
+		}
+		ResourceManager::setDecodeCacheDirectory(cacheDirectory);
+
+		bool pngDropped = dropFileCache(paths);
+		double pngCold = loadAll(paths, false, "");
+		bool cacheDropped = dropFileCache(paths);
+		DecodeCacheStats cacheColdStats;
+		double cacheCold = loadAll(paths, true, "", &cacheColdStats);
+		bool archiveDropped = dropFileCache({ settings.archivePath });
+		double archiveCold = loadAll(paths, false, settings.archivePath);
+
+		std::vector<double> pngWarm;
+		std::vector<double> cacheWarm;
+		std::vector<double> archiveWarm;
+		DecodeCacheStats cacheWarmStats;
+		for (int rep = 0; rep < std::max(1, settings.reps); rep++)
+		{
+			pngWarm.push_back(loadAll(paths, false, ""));
+			cacheWarm.push_back(loadAll(paths, true, "", &cacheWarmStats));
+			archiveWarm.push_back(loadAll(paths, false, settings.archivePath));
+		}
+
+		std::filesystem::remove_all(cacheDirectory, error);
+		ResourceManager::setDecodeCacheDirectory(gameCacheDirectory);
+
+		std::sort(pngWarm.begin(), pngWarm.end());
+		std::sort(cacheWarm.begin(), cacheWarm.end());
+		std::sort(archiveWarm.begin(), archiveWarm.end());
+
+		auto report = [&paths](const char* bench, bool dropped, double coldMs, const std::vector<double>& warmMs, const std::string& extra = "")
+		{
+			std::cout << "{\"suite\":\"asset_load\",\"bench\":\"" << bench << "\",\"images\":" << paths.size()
+				<< (dropped ? ",\"cold_ms\":" : ",\"first_pass_ms\":") << coldMs << ",\"warm_ms_median\":" << warmMs[warmMs.size() / 2]
+				<< ",\"warm_ms_min\":" << warmMs.front() << extra << "}" << std::endl;
+		};
+
+		// Warm numbers are from the last rep
+		std::string cacheCounts = ",\"cold_hits\":" + std::to_string(cacheColdStats.hits) + ",\"cold_misses\":" + std::to_string(cacheColdStats.misses)
+			+ ",\"warm_hits\":" + std::to_string(cacheWarmStats.hits) + ",\"warm_misses\":" + std::to_string(cacheWarmStats.misses);
+
+		report("png", pngDropped, pngCold, pngWarm);
+		report("decode_cache", cacheDropped, cacheCold, cacheWarm, cacheCounts);
+		report("archive", archiveDropped, archiveCold, archiveWarm);
+		return 0;
+	}
+}
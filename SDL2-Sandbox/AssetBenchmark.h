@@ -0,0 +1,52 @@
+#pragma once
+#include "Common.h"
+#include "DecodeCache.h"
+
+namespace Funny
+{
+	struct AssetBenchmarkSettings
+	{
+		std::string directory = "assets";
+		std::string archivePath = "assets.pak";	// Packed fresh from the directory before timing
+		int reps = 10;
+	};
+
+	/*
+	* Times loading every PNG in a directory onto
+	* the renderer, once from the PNGs themselves,
+	* once through the decode cache and once through
+	* an asset archive packed from them, each load
+	* counted from nothing to every texture uploaded
+	* (opening the cache or archive included).
+	*
+	* The first pass of each is the cold start.
+	* Packing the archive reads every PNG and writes
+	* the archive, leaving all of it in the OS's file
+	* cache, so right before each cold pass we ask the
+	* OS to drop whatever it has cached of the files
+	* that pass reads. Where we can't (anywhere but
+	* Linux) the pass only counts as the first one in
+	* this process, and gets reported as first_pass_ms
+	* instead of cold_ms. Every pass after that is a
+	* warm start and gets reported as a median over
+	* the reps.
+	*
+	* The decode cache passes use a directory of their
+	* own in the temp directory, emptied before the
+	* cold pass and deleted afterwards, since the
+	* game's cache will already hold every image we
+	* loaded at startup. Its hits and misses get
+	* reported alongside, so a cold pass that wasn't
+	* all misses shows up.
+	*/
+	class AssetBenchmark
+	{
+	public:
+		// Expects the engine to already be initialized, hands back an exit code for main
+		static int run(const AssetBenchmarkSettings& settings);
+
+	private:
+		static double loadAll(const std::vector<std::string>& paths, bool decodeCache, const std::string& archivePath, DecodeCacheStats* cacheStats = nullptr);
+		static bool dropFileCache(const std::vector<std::string>& paths);
+	};
+}
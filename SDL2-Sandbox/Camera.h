@@ -0,0 +1,48 @@
+#pragma once
+#include <SDL2/SDL.h>
+#include "Vector.h"
+
+namespace Funny
+{
+	/*
+	* Describes what part of the world we're
+	* looking at and where on the window it
+	* ends up. Position is the world space point
+	* that lands on the top left corner of the
+	* viewport, and zoom scales world units into
+	* pixels (so 2 means everything looks twice
+	* as big and we see half as much world).
+	*/
+	struct Camera
+	{
+		Vector2 position;
+		float zoom = 1.0f;
+		SDL_Rect viewport { 0, 0, 0, 0 };
+
+		/*
+		* The rectangle of world space the viewport
+		* currently covers, used for culling.
+		*/
+		SDL_FRect GetWorldBounds() const
+		{
+			return SDL_FRect
+			{
+				position.x,
+				position.y,
+				(float)viewport.w / zoom,
+				(float)viewport.h / zoom
+			};
+		}
+
+		SDL_FRect WorldToScreen(const SDL_FRect& world) const
+		{
+			return SDL_FRect
+			{
+				(world.x - position.x) * zoom + (float)viewport.x,
+				(world.y - position.y) * zoom + (float)viewport.y,
+				world.w * zoom,
+				world.h * zoom
+			};
+		}
+	};
+}
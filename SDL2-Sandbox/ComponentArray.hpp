@@ -47,7 +47,7 @@ namespace Funny
 		*/
 		void InsertComponent(Entity entity, T component)
 		{
-			assert(m_EntityToID.find(entity) == m_EntityToID.end() && "This Entity already has this component!");
+			assert(m_EntityToID[entity] == INVALID_INDEX && "This Entity already has this component!");
 
 			m_Components[m_ActiveCount] = component;
 			m_IDToEntity[m_ActiveCount] = entity;
@@ -65,7 +65,7 @@ namespace Funny
 		*/
 		void RemoveComponent(Entity entity)
 		{
-			assert(m_EntityToID.find(entity) != m_EntityToID.end() && "This Entity doesn't have this component type!");
+			assert(m_EntityToID[entity] != INVALID_INDEX && "This Entity doesn't have this component type!");
 
 			/*
 			* Keep track of the data we're working with
@@ -84,24 +84,23 @@ namespace Funny
 			m_Components[compIndexTarget] = m_Components[compIndexLast];
 
 			/*
-			* Since the given Entity no longer has the component
-			* of this array's type, we remove its key from the
-			* EntityToIndex map.
-			* 
-			* We also remove the index to Entity pairing of the
-			* old last index since it now just contains stale data.
-			*/
-			m_EntityToID.erase(entity);
-			m_IDToEntity.erase(compIndexLast);
-
-			/*
-			* We also need to update the Entity-index pairing of
+			* We need to update the Entity-index pairing of
 			* the overwritten "deleted" index and the moved Entity
 			* so they both refer to their new positions.
 			*/
 			m_EntityToID[entityLastComp] = compIndexTarget;
 			m_IDToEntity[compIndexTarget] = entityLastComp;
 
+			/*
+			* Since the given Entity no longer has the component
+			* of this array's type, we mark it as having no index.
+			* This has to come after the moved Entity is updated
+			* in case the removed component was the last one.
+			* The old last index's Entity pairing is just stale
+			* data now, nothing past the active count is read.
+			*/
+			m_EntityToID[entity] = INVALID_INDEX;
+
 			/*
 			* Lastly we decrement active count to account for having
 			* one less component and to avoid incrementing into
@@ -119,11 +118,26 @@ namespace Funny
 		*/
 		T& GetComponent(Entity entity)
 		{
-			assert(m_EntityToID.find(entity) != m_EntityToID.end() && "This Entity doesn't have this component type!");
+			assert(m_EntityToID[entity] != INVALID_INDEX && "This Entity doesn't have this component type!");
 
 			return m_Components[m_EntityToID[entity]];
 		}
 
+		/*
+		* Direct access to the compact array, for
+		* systems that want to run over every one of
+		* these components in a single pass rather
+		* than looking each one up by Entity. Indices
+		* go from 0 to Size() and get shuffled around
+		* whenever a component is removed.
+		*/
+		T* Data() { return m_Components.data(); }
+		int Size() const { return m_ActiveCount; }
+		Entity GetEntity(int index) const { return m_IDToEntity[index]; }
+
+		// The given Entity's index into Data(), or INVALID_INDEX if it doesn't have this component
+		int GetIndex(Entity entity) const { return m_EntityToID[entity]; }
+
 		/*
 		* Since this function is called when a given
 		* Entity is deleted, we only have to have this
@@ -132,16 +146,30 @@ namespace Funny
 		*/
 		void EntityDestroyed(Entity entity) override
 		{
-			if (m_EntityToID.find(entity) != m_EntityToID.end())
+			if (m_EntityToID[entity] != INVALID_INDEX)
 			{
 				RemoveComponent(entity);
 			}
 		}
 
+		static const int INVALID_INDEX = -1;
+
+		/*
+		* Both mappings are plain arrays rather than
+		* hash maps, since Entities and indices are
+		* both small and dense already. Lookups are
+		* then a single load, which matters for any
+		* system reading a component off every Entity.
+		*/
+		ComponentArray()
+		{
+			m_EntityToID.fill(INVALID_INDEX);
+		}
+
 	private:
 		std::array<T, MAX_ENTITIES> m_Components{};		// Where we keep all of our components
-		std::unordered_map<int, Entity> m_IDToEntity{}; // Lets us get the Entity a component is attached to based on its index
-		std::unordered_map<Entity, int> m_EntityToID{};	// Lets us get the index of a component attached to a given Entity through the Entity
+		std::array<Entity, MAX_ENTITIES> m_IDToEntity{};	// Lets us get the Entity a component is attached to based on its index
+		std::array<int, MAX_ENTITIES> m_EntityToID{};		// Lets us get the index of a component attached to a given Entity through the Entity
 		int m_ActiveCount = 0;							// Keeps track of all active components so we know when to stop looping through the compact array
 	};
 }
\ No newline at end of file
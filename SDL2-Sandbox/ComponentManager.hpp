@@ -124,20 +124,14 @@ namespace Funny
 			}
 		}
 
-	private:
-		std::unordered_map<const char*, ComponentType> m_ComponentTypes;					 // Keeps track of what Type ID corresponds to each component
-		std::unordered_map<const char*, std::shared_ptr<IComponentArray>> m_ComponentArrays; // Keeps track the component array associated with each component
-																							 // We manage the arrays as shared pointers so we can pass them around safely
-
-		ComponentType m_NextTypeID = 0;														 // Keeps track of the next ID to assign to a newly registered component
-
 		/*
 		* A convenience function that handles
 		* grabbing the component array of the
 		* given templated component type from the
 		* array map without having to manually
 		* get the name from the templated type
-		* each time.
+		* each time. Public so systems can walk
+		* an array directly, see ComponentArray::Data.
 		*/
 		template<typename T>
 		std::shared_ptr<ComponentArray<T>> GetComponentArray()
@@ -149,5 +143,12 @@ namespace Funny
 			// We need to cast to the specific array type so we don't return the pointer as the interface class.
 			return std::static_pointer_cast<ComponentArray<T>>(m_ComponentArrays[typeName]);
 		}
+
+	private:
+		std::unordered_map<const char*, ComponentType> m_ComponentTypes;					 // Keeps track of what Type ID corresponds to each component
+		std::unordered_map<const char*, std::shared_ptr<IComponentArray>> m_ComponentArrays; // Keeps track the component array associated with each component
+																							 // We manage the arrays as shared pointers so we can pass them around safely
+
+		ComponentType m_NextTypeID = 0;														 // Keeps track of the next ID to assign to a newly registered component
 	};
 }
\ No newline at end of file
@@ -211,7 +211,7 @@ namespace Funny
 		template<typename T>
 		void RemoveComponent(Entity entity)
 		{
-			m_ComponentManager->RemoveComponent<T>();
+			m_ComponentManager->RemoveComponent<T>(entity);
 
 			Signature entSignature = m_EntityManager->GetEntitySignature(entity);
 			ComponentType compType = m_ComponentManager->GetComponentType<T>();
@@ -233,6 +233,12 @@ namespace Funny
 			return m_ComponentManager->GetComponentType<T>();
 		}
 
+		template<typename T>
+		std::shared_ptr<ComponentArray<T>> GetComponentArray()
+		{
+			return m_ComponentManager->GetComponentArray<T>();
+		}
+
 		/*
 		* Handle systems
 		*/
@@ -259,6 +265,11 @@ namespace Funny
 			m_SystemManager->UpdateSystems();
 		}
 
+		void DrawSystems(float alpha)
+		{
+			m_SystemManager->DrawSystems(alpha);
+		}
+
 	private:
 		std::unique_ptr<EntityManager> m_EntityManager;
 		std::unique_ptr<ComponentManager> m_ComponentManager;
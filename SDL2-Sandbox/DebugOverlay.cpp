@@ -0,0 +1,319 @@
+#include "DebugOverlay.h"
+
+#include <algorithm>
+
+#include "ImGui/imgui.h"
+#include "ImGui/imgui_impl_sdl2.h"
+#include "ImGui/imgui_impl_sdlrenderer2.h"
+
+#include "Engine.h"
+#include "LevelLoader.h"
+#include "Profiler.h"
+#include "RenderSystem.h"
+#include "ResourceManager.h"
+#include "TextRenderer.h"
+
+namespace Funny
+{
+	bool DebugOverlay::m_Initialized = false;
+	bool DebugOverlay::m_Visible = true;
+
+	bool DebugOverlay::init(SDL_Window* window)
+	{
+		if (m_Initialized) { return true; }
+
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		ImGui::StyleColorsDark();
+
+		if (!ImGui_ImplSDL2_InitForOther(window))
+		{
+			std::cout << "Could not initialize ImGui debug overlay." << std::endl;
+			ImGui::DestroyContext();
+			return false;
+		}
+
+		// The backend would otherwise make its font texture during the first NewFrame
+		bool initialized = false;
+		Engine::getCoordinator()->GetSystem<RenderSystem>()->RunOnRenderThread([&initialized](SDL_Renderer* renderer)
+		{
+			initialized = ImGui_ImplSDLRenderer2_Init(renderer) && ImGui_ImplSDLRenderer2_CreateDeviceObjects();
+		});
+
+		if (!initialized)
+		{
+			std::cout << "Could not initialize ImGui debug overlay." << std::endl;
+			ImGui_ImplSDL2_Shutdown();
+			ImGui::DestroyContext();
+			return false;
+		}
+
+		m_Initialized = true;
+		return true;
+	}
+
+	void DebugOverlay::shutdown()
+	{
+		if (!m_Initialized) { return; }
+
+		Engine::getCoordinator()->GetSystem<RenderSystem>()->RunOnRenderThread([](SDL_Renderer*) { ImGui_ImplSDLRenderer2_Shutdown(); });
+		ImGui_ImplSDL2_Shutdown();
+		ImGui::DestroyContext();
+
+		m_Initialized = false;
+	}
+
+	void DebugOverlay::processEvent(const SDL_Event& e)
+	{
+		if (!m_Initialized) { return; }
+
+		if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3 && e.key.repeat == 0)
+		{
+			m_Visible = !m_Visible;
+		}
+
+		ImGui_ImplSDL2_ProcessEvent(&e);
+	}
+
+	void DebugOverlay::beginFrame()
+	{
+		if (!m_Initialized) { return; }
+
+		ImGui_ImplSDL2_NewFrame();
+
+		// What the platform side would've asked the renderer for itself
+		int width = 0;
+		int height = 0;
+		Engine::getCoordinator()->GetSystem<RenderSystem>()->GetOutputSize(width, height);
+
+		ImGuiIO& io = ImGui::GetIO();
+		if (io.DisplaySize.x > 0 && io.DisplaySize.y > 0 && width > 0 && height > 0)
+		{
+			io.DisplayFramebufferScale = ImVec2((float)width / io.DisplaySize.x, (float)height / io.DisplaySize.y);
+		}
+
+		ImGui::NewFrame();
+
+		if (m_Visible)
+		{
+			drawProfiler();
+			drawRendererStats();
+		}
+	}
+
+	void DebugOverlay::endFrame(OverlayDrawData& drawData)
+	{
+		drawData.clear();
+		if (!m_Initialized) { return; }
+
+		ImGui::Render();
+
+		ImDrawData* source = ImGui::GetDrawData();
+		for (int i = 0; i < source->CmdListsCount; i++)
+		{
+			// Lists with nothing in them would keep an otherwise empty overlay from counting as empty
+			if (source->CmdLists[i]->VtxBuffer.Size == 0) { continue; }
+			drawData.m_Lists.push_back(source->CmdLists[i]->CloneOutput());
+		}
+
+		drawData.m_DisplayPos[0] = source->DisplayPos.x;
+		drawData.m_DisplayPos[1] = source->DisplayPos.y;
+		drawData.m_DisplaySize[0] = source->DisplaySize.x;
+		drawData.m_DisplaySize[1] = source->DisplaySize.y;
+		drawData.m_FramebufferScale[0] = source->FramebufferScale.x;
+		drawData.m_FramebufferScale[1] = source->FramebufferScale.y;
+	}
+
+	/*
+	* Should be called after everything else has
+	* been drawn for the frame but before we
+	* present, so the overlay ends up on top.
+	*/
+	void DebugOverlay::renderDrawData(const OverlayDrawData& drawData)
+	{
+		if (!m_Initialized || drawData.isEmpty()) { return; }
+
+		ImDrawData data;
+		data.Valid = true;
+		data.DisplayPos = ImVec2(drawData.m_DisplayPos[0], drawData.m_DisplayPos[1]);
+		data.DisplaySize = ImVec2(drawData.m_DisplaySize[0], drawData.m_DisplaySize[1]);
+		data.FramebufferScale = ImVec2(drawData.m_FramebufferScale[0], drawData.m_FramebufferScale[1]);
+
+		// Added by hand since AddDrawList would want to check write
+		// pointers that only the original lists have set
+		for (ImDrawList* list : drawData.m_Lists)
+		{
+			data.CmdLists.push_back(list);
+			data.CmdListsCount++;
+			data.TotalVtxCount += list->VtxBuffer.Size;
+			data.TotalIdxCount += list->IdxBuffer.Size;
+		}
+
+		ImGui_ImplSDLRenderer2_RenderDrawData(&data);
+	}
+
+	void OverlayDrawData::clear()
+	{
+		for (ImDrawList* list : m_Lists)
+		{
+			IM_DELETE(list);
+		}
+
+		m_Lists.clear();
+	}
+
+	void DebugOverlay::drawProfiler()
+	{
+		RollingHistory frames = Profiler::getFrameHistory();
+
+		ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+		ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Profiler");
+
+		ImGui::Text("%.1f FPS (rolling)", Engine::getFPS());
+		ImGui::Text("Frame ms  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f",
+			frames.percentile(50), frames.percentile(95), frames.percentile(99), frames.max());
+
+		// Plot the ring starting from its oldest sample so time reads left to right
+		int plotOffset = (frames.count() == RollingHistory::CAPACITY) ? frames.offset() : 0;
+		ImGui::PlotLines("##FrameTimes", frames.data(), frames.count(), plotOffset, "frame ms",
+			0.0f, std::max(33.3f, frames.max()), ImVec2(-1, 60));
+
+		if (ImGui::BeginTable("Scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+		{
+			ImGui::TableSetupColumn("Scope");
+			ImGui::TableSetupColumn("last");
+			ImGui::TableSetupColumn("p50");
+			ImGui::TableSetupColumn("p95");
+			ImGui::TableSetupColumn("p99");
+			ImGui::TableHeadersRow();
+
+			for (auto const& scope : Profiler::getScopeHistories())
+			{
+				const RollingHistory& history = scope.second;
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(scope.first);
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", history.latest());
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", history.percentile(50));
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", history.percentile(95));
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", history.percentile(99));
+			}
+
+			ImGui::EndTable();
+		}
+
+		if (!Profiler::isCapturing())
+		{
+			if (ImGui::Button("Start trace capture"))
+			{
+				Profiler::startCapture();
+			}
+		}
+
+		else
+		{
+			if (ImGui::Button("Stop and export trace.json"))
+			{
+				Profiler::stopCapture();
+				Profiler::exportChromeTrace("trace.json");
+			}
+
+			ImGui::SameLine();
+			ImGui::Text("%zu events", Profiler::getCapturedEventCount());
+		}
+
+		ImGui::End();
+	}
+
+	void DebugOverlay::drawRendererStats()
+	{
+		if (Engine::isHeadless()) { return; }
+
+		std::shared_ptr<RenderSystem> renderSystem = Engine::getCoordinator()->GetSystem<RenderSystem>();
+		SpriteBatchStats batch = renderSystem->GetBatchStats();
+
+		ImGui::SetNextWindowPos(ImVec2(440, 10), ImGuiCond_FirstUseEver);
+		ImGui::Begin("Renderer");
+
+		ImGui::Text("Visible: %zu / %zu entities", renderSystem->GetVisibleCount(), renderSystem->GetManagedCount());
+		const DrawSortStats& sort = renderSystem->GetSortStats();
+		const char* sortModes[] = { "reused last order", "insertion", "radix" };
+		ImGui::Text("Sort: %s (%d out of order)", sortModes[(int)sort.mode], sort.descents);
+		ImGui::Text("Sprites: %d", batch.sprites);
+		ImGui::Text("Draw calls: %d", batch.drawCalls);
+		ImGui::Text("Texture switches: %d", batch.textureSwitches);
+		ImGui::Text("Render thread: %s", renderSystem->IsRenderThreaded() ? "on" : "off (lockstep)");
+		ImGui::Text("Text: %zu strings, %llu layouts built", TextRenderer::getTextCount(), (unsigned long long)TextRenderer::getLayoutsBuilt());
+
+		const LightMapStats& lights = renderSystem->GetLightStats();
+		ImGui::Text("Lights: %d / %d drawn, %d polygons built, %d cached", lights.drawnLights, lights.lights, lights.builtPolygons, lights.cachedPolygons);
+
+		bool partialRedraw = renderSystem->IsPartialRedraw();
+		if (ImGui::Checkbox("Partial redraw", &partialRedraw))
+		{
+			renderSystem->SetPartialRedraw(partialRedraw);
+		}
+
+		if (renderSystem->IsPartialRedraw())
+		{
+			const PartialRedrawStats& partial = renderSystem->GetPartialRedrawStats();
+			ImGui::Text("Redrawn %llu (%llu full), last %.0f%% of the viewport", (unsigned long long)partial.redrawnFrames, (unsigned long long)partial.fullFrames, partial.dirtyFraction * 100.0f);
+		}
+
+		TextureResidencyStats textures = ResourceManager::getResidencyStats();
+		ImGui::Separator();
+		ImGui::Text("Textures: %zu / %zu resident, %.1f MB", textures.resident, textures.textures, (double)textures.residentBytes / (1024.0 * 1024.0));
+		if (textures.loading > 0 || textures.uploadedLastFrame > 0)
+		{
+			ImGui::Text("Loading %zu, %d uploaded last frame", textures.loading, textures.uploadedLastFrame);
+		}
+		if (textures.budgetBytes > 0)
+		{
+			ImGui::Text("Budget %.1f MB, %llu evicted, %llu uploaded again", (double)textures.budgetBytes / (1024.0 * 1024.0),
+				(unsigned long long)textures.evictions, (unsigned long long)textures.reuploads);
+		}
+		if (ResourceManager::isDecodeCacheOpen())
+		{
+			DecodeCacheStats cache = ResourceManager::getDecodeCacheStats();
+			ImGui::Text("Decode cache: %llu hits, %llu misses (%llu stale), %.1f MB", (unsigned long long)cache.hits,
+				(unsigned long long)cache.misses, (unsigned long long)cache.stale, (double)cache.bytes / (1024.0 * 1024.0));
+		}
+
+		const LevelLoadStats& level = LevelLoader::getLastLoadStats();
+		if (!level.name.empty())
+		{
+			ImGui::Separator();
+			ImGui::Text("Level %s%s", level.name.c_str(), LevelLoader::isLoading() ? " (next level loading)" : "");
+			ImGui::Text("%d textures (%d shared), ready in %.1f ms, swapped in %.2f ms", level.textures, level.shared, level.readyMs, level.swapMs);
+		}
+
+		TilemapChunkStats chunks = renderSystem->GetChunkStats();
+		ImGui::Separator();
+		ImGui::Text("Tilemap chunks: %d visible, %d cached", chunks.visibleChunks, chunks.cachedChunks);
+		ImGui::Text("Rebuilt %d  Evicted %d  Fallback %d", chunks.rebuiltChunks, chunks.evictedChunks, chunks.fallbackChunks);
+
+		ImGui::Separator();
+		if (!renderSystem->IsCapturingFrames())
+		{
+			if (ImGui::Button("Start recording"))
+			{
+				renderSystem->StartFrameCapture(FrameCaptureSettings());
+			}
+		}
+
+		else
+		{
+			if (ImGui::Button("Stop recording"))
+			{
+				renderSystem->StopFrameCapture();
+			}
+
+			FrameCaptureStats capture = renderSystem->GetFrameCaptureStats();
+			ImGui::Text("Recorded %llu, dropped %llu, failed %llu", (unsigned long long)capture.written, (unsigned long long)capture.dropped, (unsigned long long)capture.failed);
+			ImGui::Text("Queued %d, read back %.2f ms", capture.queued, capture.readbackMs);
+		}
+
+		ImGui::End();
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include <SDL2/SDL.h>
+#include "Common.h"
+
+struct ImDrawList;
+
+namespace Funny
+{
+	/*
+	* A copy of everything ImGui wants drawn for
+	* a frame. ImGui reuses its own draw lists as
+	* soon as the next frame starts, so the render
+	* thread needs its own copy to draw from while
+	* the simulation moves on.
+	*/
+	class OverlayDrawData
+	{
+	public:
+		OverlayDrawData() = default;
+		~OverlayDrawData() { clear(); }
+
+		OverlayDrawData(const OverlayDrawData&) = delete;
+		OverlayDrawData& operator=(const OverlayDrawData&) = delete;
+
+		void clear();
+		bool isEmpty() const { return m_Lists.empty(); }
+
+	private:
+		friend class DebugOverlay;
+
+		std::vector<ImDrawList*> m_Lists;
+		float m_DisplayPos[2] = {};
+		float m_DisplaySize[2] = {};
+		float m_FramebufferScale[2] = { 1, 1 };
+	};
+
+	/*
+	* Owns our ImGui context and draws any
+	* debug windows on top of the frame. For
+	* now that's just the profiler, but other
+	* engine stats can be hooked in here too
+	* rather than having ImGui setup scattered
+	* around like it was in the old Terrain code.
+	*
+	* F3 toggles the overlay on and off.
+	*/
+	class DebugOverlay
+	{
+	public:
+		/*
+		* Anything the backends do with the renderer
+		* (making and destroying the font texture,
+		* drawing) happens on the render thread. The
+		* platform side is never given the renderer,
+		* so it can't go asking it for its size from
+		* ours, beginFrame takes that from the last
+		* frame the render thread drew instead.
+		*/
+		static bool init(SDL_Window* window);
+		static void shutdown();
+
+		static void processEvent(const SDL_Event& e);
+		static void beginFrame();
+
+		/*
+		* Finishes the ImGui frame and copies out what
+		* it wants drawn, which renderDrawData can then
+		* draw later from whichever thread owns the
+		* renderer.
+		*/
+		static void endFrame(OverlayDrawData& drawData);
+		static void renderDrawData(const OverlayDrawData& drawData);
+
+		static void setVisible(bool visible) { m_Visible = visible; }
+		static bool isVisible() { return m_Visible; }
+
+	private:
+		static bool m_Initialized;
+		static bool m_Visible;
+
+		static void drawProfiler();
+		static void drawRendererStats();
+	};
+}
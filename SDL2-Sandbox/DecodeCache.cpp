@@ -0,0 +1,282 @@
+#include "DecodeCache.h"
+#include "AssetArchive.h"
+#include "Common.h"
+#include "ImageHash.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace Funny
+{
+	static const char CACHE_MAGIC[4] = { 'F', 'D', 'C', 'E' };
+	static const char* ENTRY_EXTENSION = ".img";
+
+	static uint64_t HashBytes(const void* data, size_t size)
+	{
+		return ImageHash::hashPixels(data, (int)size, 1, (int)size, 1);
+	}
+
+	/*
+	* Leftover temporary files are from writes that
+	* never finished (the game was killed partway
+	* through one), so those just get deleted.
+	*/
+	bool DecodeCache::Open(const std::string& directory, size_t budgetBytes)
+	{
+		Close();
+
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error)
+		{
+			std::cout << "Unable to create decode cache directory " << directory << ": " << error.message() << std::endl;
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_Bytes = 0;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
+		{
+			if (!entry.is_regular_file()) { continue; }
+
+			if (entry.path().extension() == ENTRY_EXTENSION)
+			{
+				m_Bytes += (size_t)entry.file_size();
+			}
+			else if (entry.path().extension() == ".tmp")
+			{
+				std::filesystem::remove(entry.path(), error);
+			}
+		}
+
+		m_Directory = directory;
+		m_Budget = budgetBytes;
+		Trim();
+
+		std::cout << "Decode cache at [" << directory << "] holds " << m_Bytes / 1024 << " KB" << std::endl;
+		return true;
+	}
+
+	void DecodeCache::Close()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Directory.clear();
+		m_Bytes = 0;
+	}
+
+	DecodeCacheKey DecodeCache::MakeKey(const std::string& filepath, const std::vector<uint8_t>& encoded, uint32_t options) const
+	{
+		DecodeCacheKey key;
+		key.contentHash = HashBytes(encoded.data(), encoded.size());
+		key.sourceSize = encoded.size();
+		key.options = options;
+
+		std::error_code error;
+		std::filesystem::file_time_type modified = std::filesystem::last_write_time(filepath, error);
+		key.modifiedTime = error ? 0 : (int64_t)modified.time_since_epoch().count();
+
+		std::string slot = filepath + "|" + std::to_string(options);
+		key.entryPath = m_Directory + "/" + ImageHash::toString(HashBytes(slot.data(), slot.size())) + ENTRY_EXTENSION;
+		return key;
+	}
+
+	SDL_Surface* DecodeCache::Load(const DecodeCacheKey& key)
+	{
+		FUNNY_PROFILE_SCOPE("LoadCachedImage");
+
+		std::ifstream file(key.entryPath, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+		{
+			m_Misses.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Header header;
+		file.read((char*)&header, sizeof(header));
+
+		bool matches = file.good() && std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0 && header.version == VERSION
+			&& header.contentHash == key.contentHash && header.modifiedTime == key.modifiedTime
+			&& header.sourceSize == key.sourceSize && header.options == key.options
+			&& SDL_BYTESPERPIXEL(header.format) == 4;
+
+		SDL_Surface* surface = matches ? SDL_CreateRGBSurfaceWithFormat(0, (int)header.width, (int)header.height, 32, header.format) : nullptr;
+		if (surface != nullptr)
+		{
+			std::streamsize row = (std::streamsize)header.width * 4;
+			if (surface->pitch == row)
+			{
+				file.read((char*)surface->pixels, row * (std::streamsize)header.height);
+			}
+			else
+			{
+				for (int y = 0; y < surface->h && file.good(); y++)
+				{
+					file.read((char*)surface->pixels + y * surface->pitch, row);
+				}
+			}
+
+			// Cut short, most likely by running out of disk while it was written
+			if (!file.good())
+			{
+				SDL_FreeSurface(surface);
+				surface = nullptr;
+			}
+		}
+
+		file.close();
+
+		if (surface == nullptr)
+		{
+			m_Stale.fetch_add(1, std::memory_order_relaxed);
+			m_Misses.fetch_add(1, std::memory_order_relaxed);
+			Remove(key.entryPath);
+			return nullptr;
+		}
+
+		// Trimming goes by modified time, so this keeps entries we use from going first
+		std::error_code error;
+		std::filesystem::last_write_time(key.entryPath, std::filesystem::file_time_type::clock::now(), error);
+
+		m_Hits.fetch_add(1, std::memory_order_relaxed);
+		return surface;
+	}
+
+	/*
+	* Writes to a temporary file first and renames
+	* it into place, so another thread (or launch)
+	* never sees an entry half written.
+	*/
+	void DecodeCache::Store(const DecodeCacheKey& key, SDL_Surface* surface)
+	{
+		if (surface == nullptr || !IsOpen()) { return; }
+
+		FUNNY_PROFILE_SCOPE("StoreCachedImage");
+
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, AssetArchive::PIXEL_FORMAT, 0);
+		if (converted == nullptr) { return; }
+
+		Header header;
+		std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.version = VERSION;
+		header.contentHash = key.contentHash;
+		header.modifiedTime = key.modifiedTime;
+		header.sourceSize = key.sourceSize;
+		header.options = key.options;
+		header.format = AssetArchive::PIXEL_FORMAT;
+		header.width = (uint32_t)converted->w;
+		header.height = (uint32_t)converted->h;
+
+		std::string temporaryPath = key.entryPath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+		std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		bool written = file.is_open();
+		if (written)
+		{
+			file.write((const char*)&header, sizeof(header));
+
+			SDL_LockSurface(converted);
+			for (int y = 0; y < converted->h; y++)
+			{
+				file.write((const char*)converted->pixels + y * converted->pitch, (std::streamsize)converted->w * 4);
+			}
+			SDL_UnlockSurface(converted);
+
+			file.close();
+			written = !file.fail();
+		}
+
+		SDL_FreeSurface(converted);
+
+		std::error_code error;
+		if (!written)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		uintmax_t replaced = std::filesystem::exists(key.entryPath, error) ? std::filesystem::file_size(key.entryPath, error) : 0;
+		uintmax_t size = std::filesystem::file_size(temporaryPath, error);
+
+		// Can fail on Windows while another thread has the old entry open, we'll just write it next time
+		std::filesystem::rename(temporaryPath, key.entryPath, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+
+		m_Bytes = m_Bytes - std::min((size_t)replaced, m_Bytes) + (size_t)size;
+		m_Writes.fetch_add(1, std::memory_order_relaxed);
+		Trim();
+	}
+
+	DecodeCacheStats DecodeCache::GetStats() const
+	{
+		DecodeCacheStats stats;
+		stats.hits = m_Hits.load(std::memory_order_relaxed);
+		stats.misses = m_Misses.load(std::memory_order_relaxed);
+		stats.stale = m_Stale.load(std::memory_order_relaxed);
+		stats.writes = m_Writes.load(std::memory_order_relaxed);
+		stats.evictions = m_Evictions.load(std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		stats.bytes = m_Bytes;
+		stats.budgetBytes = m_Budget;
+		return stats;
+	}
+
+	void DecodeCache::Remove(const std::string& entryPath)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		std::error_code error;
+		uintmax_t size = std::filesystem::file_size(entryPath, error);
+		if (!error && std::filesystem::remove(entryPath, error))
+		{
+			m_Bytes -= std::min((size_t)size, m_Bytes);
+		}
+	}
+
+	// Expects the lock to be held, a budget of 0 leaves the cache unbounded
+	void DecodeCache::Trim()
+	{
+		if (m_Budget == 0 || m_Bytes <= m_Budget) { return; }
+
+		struct Entry
+		{
+			std::filesystem::file_time_type modified;
+			std::filesystem::path path;
+			uintmax_t size;
+		};
+
+		std::error_code error;
+		std::vector<Entry> entries;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_Directory, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ENTRY_EXTENSION)
+			{
+				entries.push_back({ entry.last_write_time(), entry.path(), entry.file_size() });
+			}
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.modified < b.modified; });
+
+		for (const Entry& entry : entries)
+		{
+			if (m_Bytes <= m_Budget) { break; }
+
+			if (std::filesystem::remove(entry.path, error))
+			{
+				m_Bytes -= std::min((size_t)entry.size, m_Bytes);
+				m_Evictions.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <SDL2/SDL.h>
+
+namespace Funny
+{
+	struct DecodeCacheStats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t stale = 0;		// Entries thrown out because their source changed
+		uint64_t writes = 0;
+		uint64_t evictions = 0;	// Entries deleted to stay under the size limit
+		size_t bytes = 0;
+		size_t budgetBytes = 0;
+	};
+
+	/*
+	* What a cache entry has to match to be used.
+	* The entry's file is named after the source's
+	* path and the load options, so each source has
+	* just the one slot and a changed file replaces
+	* its old entry rather than piling up next to it.
+	*/
+	struct DecodeCacheKey
+	{
+		std::string entryPath;
+		uint64_t contentHash = 0;
+		int64_t modifiedTime = 0;
+		uint64_t sourceSize = 0;
+		uint32_t options = 0;
+	};
+
+	/*
+	* A directory of images we've already decoded,
+	* so launching again doesn't mean decoding every
+	* PNG again. Entries hold the pixels exactly as
+	* they'd come out of a load (color key applied)
+	* in the asset archive's pixel format, behind a
+	* header holding the key they were made under.
+	* Loading one is a single read straight into a
+	* new surface.
+	*
+	* Anything that no longer matches its key is
+	* deleted as soon as it's looked at. Once the
+	* directory goes over its size limit, whichever
+	* entries were used longest ago (going by their
+	* modified time, which a hit bumps) get deleted
+	* until it fits again.
+	*
+	* Everything but Open and Close is safe to call
+	* from the decode threads.
+	*/
+	class DecodeCache
+	{
+	public:
+		static const uint32_t VERSION = 1;
+
+		bool Open(const std::string& directory, size_t budgetBytes);
+		void Close();
+		bool IsOpen() const { return !m_Directory.empty(); }
+
+		// Options cover anything else that changes the decoded pixels, like the color key
+		DecodeCacheKey MakeKey(const std::string& filepath, const std::vector<uint8_t>& encoded, uint32_t options) const;
+
+		// Null on a miss
+		SDL_Surface* Load(const DecodeCacheKey& key);
+
+		// Doesn't take ownership of the surface
+		void Store(const DecodeCacheKey& key, SDL_Surface* surface);
+
+		DecodeCacheStats GetStats() const;
+
+	private:
+		struct Header
+		{
+			char magic[4];
+			uint32_t version;
+			uint64_t contentHash;
+			int64_t modifiedTime;
+			uint64_t sourceSize;
+			uint32_t options;
+			uint32_t format;
+			uint32_t width;
+			uint32_t height;
+		};
+
+		std::string m_Directory;
+		size_t m_Budget = 0;
+
+		// Guards the directory's contents and the byte count
+		mutable std::mutex m_Mutex;
+		size_t m_Bytes = 0;
+
+		std::atomic<uint64_t> m_Hits { 0 };
+		std::atomic<uint64_t> m_Misses { 0 };
+		std::atomic<uint64_t> m_Stale { 0 };
+		std::atomic<uint64_t> m_Writes { 0 };
+		std::atomic<uint64_t> m_Evictions { 0 };
+
+		void Remove(const std::string& entryPath);
+		void Trim();
+	};
+}
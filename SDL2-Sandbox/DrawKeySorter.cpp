@@ -0,0 +1,121 @@
+#include "DrawKeySorter.h"
+#include "Profiler.h"
+
+namespace Funny
+{
+	void DrawKeySorter::Sort(std::vector<DrawKey>& keys)
+	{
+		FUNNY_PROFILE_SCOPE("SortDrawKeys");
+
+		m_Stats = DrawSortStats();
+		m_Stats.keys = (int)keys.size();
+
+		for (size_t i = 1; i < keys.size(); i++)
+		{
+			if (keys[i].key < keys[i - 1].key)
+			{
+				m_Stats.descents++;
+			}
+		}
+
+		if (m_Stats.descents == 0)
+		{
+			m_Stats.mode = DrawSortMode::ALREADY_SORTED;
+			return;
+		}
+
+		// Each descent can mean a key shifting a long way back,
+		// so insertion sort only wins while there are very few
+		if (m_Stats.descents <= MAX_INSERTION_DESCENTS)
+		{
+			m_Stats.mode = DrawSortMode::INSERTION;
+			InsertionSort(keys);
+			return;
+		}
+
+		m_Stats.mode = DrawSortMode::RADIX;
+		RadixSort(keys);
+	}
+
+	void DrawKeySorter::InsertionSort(std::vector<DrawKey>& keys)
+	{
+		for (size_t i = 1; i < keys.size(); i++)
+		{
+			DrawKey current = keys[i];
+
+			size_t j = i;
+			while (j > 0 && keys[j - 1].key > current.key)
+			{
+				keys[j] = keys[j - 1];
+				j--;
+			}
+			keys[j] = current;
+		}
+	}
+
+	/*
+	* Keys get sorted 12 bits at a time, which takes
+	* four passes to cover the 48 bits a key uses
+	* while keeping the histograms small enough to
+	* stay in cache. All four histograms get built in a single read
+	* over the keys up front. Each pass after that is
+	* one scatter into the scratch buffer, and since
+	* the scatter is stable, earlier passes' ordering
+	* survives the later ones.
+	*/
+	void DrawKeySorter::RadixSort(std::vector<DrawKey>& keys)
+	{
+		const int KEY_BITS = 48;
+		const int DIGIT_BITS = 12;
+		const int BUCKETS = 1 << DIGIT_BITS;
+		const int PASSES = KEY_BITS / DIGIT_BITS;
+		const uint64_t MASK = BUCKETS - 1;
+
+		const size_t count = keys.size();
+
+		m_Histograms.assign(PASSES * BUCKETS, 0);
+		for (const DrawKey& drawKey : keys)
+		{
+			uint64_t key = drawKey.key;
+			for (int pass = 0; pass < PASSES; pass++)
+			{
+				m_Histograms[pass * BUCKETS + ((key >> (pass * DIGIT_BITS)) & MASK)]++;
+			}
+		}
+
+		m_Scratch.resize(count);
+		DrawKey* source = keys.data();
+		DrawKey* destination = m_Scratch.data();
+
+		for (int pass = 0; pass < PASSES; pass++)
+		{
+			uint32_t* histogram = &m_Histograms[pass * BUCKETS];
+			const int shift = pass * DIGIT_BITS;
+
+			// Every key has the same digit here, so this pass wouldn't move anything
+			if (histogram[(source[0].key >> shift) & MASK] == count) { continue; }
+
+			uint32_t offset = 0;
+			for (int bucket = 0; bucket < BUCKETS; bucket++)
+			{
+				uint32_t bucketCount = histogram[bucket];
+				histogram[bucket] = offset;
+				offset += bucketCount;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				destination[histogram[(source[i].key >> shift) & MASK]++] = source[i];
+			}
+
+			std::swap(source, destination);
+			m_Stats.radixPasses++;
+		}
+
+		// Odd number of passes leaves the result in our scratch buffer
+		if (source != keys.data())
+		{
+			std::memcpy(keys.data(), source, count * sizeof(DrawKey));
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace Funny
+{
+	/*
+	* Draw keys pack everything that decides draw
+	* order into one number, most important first,
+	* so sorting the keys sorts the sprites:
+	* 
+	*   bits 40-47  layer
+	*   bits 16-39  depth (top 24 bits of the float)
+	*   bits  0-15  texture ID
+	* 
+	* Sprites on the same layer and depth end up
+	* grouped by texture, which is what lets the
+	* batcher merge them into one draw call. The
+	* top 16 bits are left empty so the sorter can
+	* skip them.
+	* 
+	* There's no tie breaker in the key. The sort is
+	* stable, so sprites with equal keys stay in
+	* whatever order they came in, and feeding them
+	* in last frame's order keeps them from swapping
+	* around between frames.
+	*/
+	inline uint64_t MakeDrawKey(uint8_t layer, float depth, uint16_t textureID)
+	{
+		// Flip floats so their bits compare the same way their values do
+		uint32_t depthBits;
+		std::memcpy(&depthBits, &depth, sizeof(depthBits));
+		depthBits = (depthBits & 0x80000000u) ? ~depthBits : (depthBits | 0x80000000u);
+
+		return ((uint64_t)layer << 40) | ((uint64_t)(depthBits >> 8) << 16) | textureID;
+	}
+
+	struct DrawKey
+	{
+		uint64_t key;
+		uint32_t index;		// Whatever the caller wants back, usually where the sprite lives
+	};
+
+	enum class DrawSortMode : uint8_t
+	{
+		ALREADY_SORTED,
+		INSERTION,
+		RADIX
+	};
+
+	struct DrawSortStats
+	{
+		DrawSortMode mode = DrawSortMode::ALREADY_SORTED;
+		int keys = 0;
+		int descents = 0;		// How many neighbouring keys were out of order going in
+		int radixPasses = 0;
+	};
+
+	/*
+	* Sorts draw keys with an LSD radix sort, 12 bits
+	* per pass. Any digit that's the same across every
+	* key (usually most of the layer and depth bits)
+	* gets its pass skipped entirely.
+	* 
+	* Before any of that, we count how many keys are
+	* out of order. Feed the keys in last frame's
+	* sorted order and most frames that's zero, so we
+	* don't sort at all, and when only a few sprites
+	* moved an insertion sort fixes them up cheaper
+	* than a full radix sort would.
+	*/
+	class DrawKeySorter
+	{
+	public:
+		void Sort(std::vector<DrawKey>& keys);
+
+		const DrawSortStats& GetStats() const { return m_Stats; }
+
+	private:
+		static const int MAX_INSERTION_DESCENTS = 16;
+
+		std::vector<DrawKey> m_Scratch;
+		std::vector<uint32_t> m_Histograms;
+		DrawSortStats m_Stats;
+
+		void InsertionSort(std::vector<DrawKey>& keys);
+		void RadixSort(std::vector<DrawKey>& keys);
+	};
+}
@@ -1,6 +1,12 @@
 #include "Engine.h"
 #include "RenderSystem.h"
 #include "ResourceManager.h"
+#include "DebugOverlay.h"
+#include "AnimationSystem.h"
+#include "AnimationClips.h"
+#include "TextRenderer.h"
+#include "LevelLoader.h"
+#include <cmath>
 
 namespace Funny
 {
@@ -8,78 +14,356 @@ namespace Funny
 	Coordinator* Engine::m_Coordinator = 0;
 	Tilemap* Engine::test = 0;
 
-	int Engine::frame = 0;
-	int Engine::frameStart = 0;
+	bool Engine::m_Headless = false;
+	bool Engine::m_FreeRunning = false;
+	bool Engine::m_RenderLockstep = false;
+	bool Engine::m_Offscreen = false;
+	bool Engine::m_CaptureFrames = false;
+	FrameCaptureSettings Engine::m_CaptureSettings;
+	bool Engine::m_PartialRedraw = false;
+	bool Engine::m_SoftwareRaster = true;
+	float Engine::m_StartupBudgetMs = 0;
+	std::string Engine::m_StartLevel = "assets/levels/sandbox.level";
+	bool Engine::m_StartupWithinBudget = true;
 
-	bool Engine::init(std::string name, int width, int height)
+	int Engine::m_TickRate = 60;
+	int Engine::m_MaxCatchUpSteps = 5;
+	int Engine::m_FrameRateLimit = 60;
+	double Engine::m_TickSeconds = 1.0 / 60.0;
+	double Engine::m_Accumulator = 0;
+	float Engine::m_Alpha = 0;
+	uint64_t Engine::m_LastCounter = 0;
+	uint64_t Engine::m_FrameDeadline = 0;
+	uint64_t Engine::m_TickCount = 0;
+	uint64_t Engine::m_FrameCount = 0;
+
+	void Engine::setTickRate(int ticksPerSecond)
 	{
-		if (SDL_Init(SDL_INIT_EVERYTHING) != 0)
+		assert(ticksPerSecond > 0 && "Tick rate has to be positive!");
+
+		m_TickRate = ticksPerSecond;
+		m_TickSeconds = 1.0 / (double)ticksPerSecond;
+	}
+
+	bool Engine::init(std::string name, int width, int height, bool headless)
+	{
+		m_Headless = headless;
+		ResourceManager::setHeadless(headless);
+
+		/*
+		* Only the timer and event subsystems are brought
+		* up front since everything needs them. Video gets
+		* initialized by the Window when it's created, and
+		* anything else (audio, controllers, haptics...)
+		* should call requireSubsystem when it's first used.
+		*/
+		if (SDL_Init(SDL_INIT_TIMER | SDL_INIT_EVENTS) != 0)
 		{
 			std::cout << "Could not initialize SDL." << std::endl;
 			return false;
 		}
+		Profiler::markStartup("SDL core init");
 
-		if (!(IMG_Init(IMG_INIT_FLAGS) && IMG_INIT_FLAGS))
+		if (!headless && !(IMG_Init(IMG_INIT_FLAGS) && IMG_INIT_FLAGS))
 		{
 			std::cout << "Could not initialize SDL_image." << std::endl;
 			return false;
 		}
 
+		if (!headless)
+		{
+			Funny::ResourceManager::openDecodeCache();
+		}
+
+		// Start decoding our startup textures now so it
+		// overlaps with creating the window and renderer
+		Funny::ResourceManager::queuePrimitives();
+		if (!m_StartLevel.empty() && !LevelLoader::queueStartupLevel(m_StartLevel))
+		{
+			std::cout << "Starting without a level" << std::endl;
+		}
+		Profiler::markStartup("Texture decodes queued");
+
 		m_Coordinator = new Coordinator();
 		m_Coordinator->Init();
 
 		m_Coordinator->RegisterComponent<Transform>();
 		m_Coordinator->RegisterComponent<Renderable>();
+		m_Coordinator->RegisterComponent<Animator>();
+		m_Coordinator->RegisterComponent<Text>();
+		m_Coordinator->RegisterComponent<Light>();
+
+		m_Coordinator->RegisterSystem<AnimationSystem>();
+		Signature animationSignature;
+		animationSignature.set(m_Coordinator->GetComponentType<Animator>());
+		animationSignature.set(m_Coordinator->GetComponentType<Renderable>());
+		m_Coordinator->SetSystemSignature<AnimationSystem>(animationSignature);
+
+		// Nothing gets drawn headless, so don't even make the system
+		if (!headless)
+		{
+			std::shared_ptr<RenderSystem> renderSystem = m_Coordinator->RegisterSystem<RenderSystem>();
+			Window& window = renderSystem->getWindow();
+			if (!(m_Offscreen ? window.setOffscreen(name, width, height) : window.setMode(name, width, height)))
+			{
+				return false;
+			}
+
+			// Everything from here on that needs the renderer gets run on whichever thread made it
+			if (!renderSystem->StartRenderer(!m_RenderLockstep))
+			{
+				return false;
+			}
+			Signature renderSignature;
+			renderSignature.set(m_Coordinator->GetComponentType<Transform>());
+			renderSignature.set(m_Coordinator->GetComponentType<Renderable>());
+			m_Coordinator->SetSystemSignature<RenderSystem>(renderSignature);
+			renderSystem->GetCamera().viewport = SDL_Rect { 0, 0, width, height };
+			renderSystem->SetPartialRedraw(m_PartialRedraw);
+			renderSystem->SetSoftwareRaster(m_SoftwareRaster);
+			Profiler::markStartup("Window and renderer created");
+
+			if (!m_Offscreen)
+			{
+				DebugOverlay::init(window.getSDLWindow());
+				Profiler::markStartup("Debug overlay init");
+			}
+		}
 
-		std::shared_ptr<RenderSystem> renderSystem = m_Coordinator->RegisterSystem<RenderSystem>();
-		renderSystem->getWindow().setMode(name, width, height);
-		Signature renderSignature;
-		renderSignature.set(m_Coordinator->GetComponentType<Transform>());
-		renderSignature.set(m_Coordinator->GetComponentType<Renderable>());
-		m_Coordinator->SetSystemSignature<RenderSystem>(renderSignature);
+		Funny::ResourceManager::finishQueuedTextures();
+		Profiler::markStartup("Textures uploaded");
 
-		Funny::ResourceManager::loadPrimitives();
-		Funny::ResourceManager::loadSDLTexture("assets/quote.png", "Quote");
-		Funny::ResourceManager::loadSDLTexture("assets/PrtCave.png", "CaveTileset");
+		LevelLoader::finishLoading();
+		Profiler::markStartup("Start level spawned");
+
+		if (!headless && m_CaptureFrames)
+		{
+			m_Coordinator->GetSystem<RenderSystem>()->StartFrameCapture(m_CaptureSettings);
+		}
 
 		return true;
 	}
 
+	bool Engine::requireSubsystem(Uint32 flags)
+	{
+		Uint32 missing = flags & ~SDL_WasInit(flags);
+		if (missing == 0)
+		{
+			return true;
+		}
+
+		FUNNY_PROFILE_SCOPE("InitSubsystem");
+
+		if (SDL_InitSubSystem(missing) != 0)
+		{
+			std::cout << "Could not initialize SDL subsystem: " << SDL_GetError() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	/*
+	* One pass through here is one rendered frame.
+	* We measure how much real time passed since the
+	* last frame with the performance counter, feed
+	* it into the accumulator, run however many fixed
+	* ticks that pays for, then draw with the leftover
+	* fraction of a tick as our interpolation alpha.
+	*/
 	bool Engine::gameLoop()
 	{
-		SDL_Event e;
-		while (SDL_PollEvent(&e) != 0)
+		const uint64_t counterFrequency = SDL_GetPerformanceFrequency();
+		uint64_t now = SDL_GetPerformanceCounter();
+		if (m_LastCounter == 0)
+		{
+			m_LastCounter = now;
+			m_FrameDeadline = now;
+		}
+
+		m_Accumulator += (double)(now - m_LastCounter) / (double)counterFrequency;
+		m_LastCounter = now;
+
+		// Free running ignores real time and always does exactly one tick
+		if (m_FreeRunning)
 		{
-			if (e.type == SDL_QUIT)
+			m_Accumulator = m_TickSeconds;
+		}
+
+		Profiler::beginFrame();
+		m_FrameCount++;
+
+		{
+			FUNNY_PROFILE_SCOPE("PollEvents");
+
+			SDL_Event e;
+			while (SDL_PollEvent(&e) != 0)
 			{
-				return false;
+				DebugOverlay::processEvent(e);
+
+				// Render target contents can be lost (on a device reset
+				// with Direct3D for example), so anything cached in one
+				// has to be drawn again
+				if (!m_Headless && (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET))
+				{
+					m_Coordinator->GetSystem<RenderSystem>()->InvalidateRenderTargets();
+				}
+
+				// Partial redraw skips frames where nothing changed, so the
+				// window needs a whole frame again when it gets uncovered
+				if (!m_Headless && e.type == SDL_WINDOWEVENT &&
+					(e.window.event == SDL_WINDOWEVENT_EXPOSED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED || e.window.event == SDL_WINDOWEVENT_RESTORED))
+				{
+					m_Coordinator->GetSystem<RenderSystem>()->RequestFullRedraw();
+				}
+
+				if (e.type == SDL_QUIT)
+				{
+					return false;
+				}
 			}
 		}
 
-		// Temp timestep stuff until a proper physics system is implemented
-		if (SDL_GetTicks64() - frameStart >= 16)
-		{
-			frame++;
-			frameStart = SDL_GetTicks64();
+		std::shared_ptr<RenderSystem> renderSystem = m_Headless ? nullptr : m_Coordinator->GetSystem<RenderSystem>();
 
-			m_Coordinator->GetSystem<RenderSystem>()->RenderClear();
+		int steps = 0;
+		while (m_Accumulator >= m_TickSeconds && steps < m_MaxCatchUpSteps)
+		{
+			FUNNY_PROFILE_SCOPE("Tick");
 
+			if (renderSystem != nullptr)
+			{
+				renderSystem->SnapshotTransforms();
+			}
 			m_Coordinator->UpdateSystems();
 
-			m_Coordinator->GetSystem<RenderSystem>()->RenderPresent();
+			m_Accumulator -= m_TickSeconds;
+			m_TickCount++;
+			steps++;
+		}
+
+		// Still behind after our catch up budget, so let the
+		// simulation fall behind real time instead of stalling
+		if (m_Accumulator >= m_TickSeconds)
+		{
+			m_Accumulator = fmod(m_Accumulator, m_TickSeconds);
+		}
+
+		m_Alpha = (float)(m_Accumulator / m_TickSeconds);
+
+		if (renderSystem != nullptr)
+		{
+			if (steps > 0)
+			{
+				renderSystem->RefreshSpatialIndex();
+			}
+
+			renderSystem->BeginFrame();
+			DebugOverlay::beginFrame();
+
+			renderSystem->RenderClear();
+
+			m_Coordinator->DrawSystems(m_Alpha);
+
+			renderSystem->RenderOverlay();
+			renderSystem->RenderPresent();
+
+			ResourceManager::endFrame();
+		}
+
+		// Level swaps only happen here, between frames
+		LevelLoader::update();
+
+		Profiler::endFrame();
+
+		if (m_FrameCount == 1)
+		{
+			Profiler::markStartup(m_Headless ? "First tick" : "First frame presented");
+			m_StartupWithinBudget = Profiler::reportStartup(m_StartupBudgetMs);
+		}
+
+		/*
+		* Sleep until the next frame is due. Deadlines
+		* advance by a fixed interval rather than from
+		* "now" so sleep overshoot doesn't accumulate,
+		* but we resync if we've fallen a whole frame
+		* behind. Headless there are no frames to pace,
+		* so we wait for the next tick instead.
+		*/
+		int frameRate = m_Headless ? (m_FreeRunning ? 0 : m_TickRate) : m_FrameRateLimit;
+		uint64_t frameInterval = (frameRate > 0) ? counterFrequency / (uint64_t)frameRate : 0;
+		if (frameInterval > 0)
+		{
+			m_FrameDeadline += frameInterval;
+
+			uint64_t current = SDL_GetPerformanceCounter();
+			if (m_FrameDeadline + frameInterval < current)
+			{
+				m_FrameDeadline = current;
+			}
+
+			FUNNY_PROFILE_SCOPE("Sleep");
+			waitUntil(m_FrameDeadline);
 		}
 		
 		return true;
 	}
 
+	/*
+	* SDL_Delay only promises millisecond-ish
+	* precision (and can oversleep by more on
+	* some platforms), so we sleep in coarse
+	* chunks while there's plenty of time left,
+	* then yield the last couple milliseconds
+	* away while polling the performance counter.
+	*/
+	void Engine::waitUntil(uint64_t targetCounter)
+	{
+		const uint64_t counterFrequency = SDL_GetPerformanceFrequency();
+		const uint64_t spinThreshold = counterFrequency / 500; // 2ms
+
+		uint64_t current = SDL_GetPerformanceCounter();
+		while (current < targetCounter)
+		{
+			uint64_t remaining = targetCounter - current;
+
+			if (remaining > spinThreshold)
+			{
+				uint32_t sleepMs = (uint32_t)(((remaining - spinThreshold) * 1000) / counterFrequency);
+				SDL_Delay(sleepMs > 0 ? sleepMs : 1);
+			}
+
+			else
+			{
+				SDL_Delay(0);
+			}
+
+			current = SDL_GetPerformanceCounter();
+		}
+	}
+
 	bool Engine::close()
 	{
+		// Fonts hand their pages back to the ResourceManager, so they go first
+		TextRenderer::unloadAllFonts();
+		LevelLoader::unloadAll();
 		ResourceManager::unloadAllTextures();
+		AnimationClips::clear();
+		DebugOverlay::shutdown();
+
+		// Textures get destroyed on the render thread, so it has to stay up until they're gone
+		if (!m_Headless)
+		{
+			m_Coordinator->GetSystem<RenderSystem>()->StopRenderer();
+		}
 
 		delete(test);
 		delete(m_Coordinator);
 
-		IMG_Quit();
+		if (!m_Headless)
+		{
+			IMG_Quit();
+		}
 		SDL_Quit();
 
 		return true;
@@ -4,6 +4,8 @@
 #include "Common.h"
 #include "Coordinator.hpp"
 #include "Tilemap.h"
+#include "Profiler.h"
+#include "FrameCapture.h"
 
 namespace Funny
 {
@@ -22,9 +24,112 @@ namespace Funny
 		}
 		static Engine* getInstance() { return m_Instance; }
 		static Coordinator* getCoordinator() { return m_Coordinator; }
-		static float getFPS() { return (float)frame / ((float)SDL_GetTicks64() / (float)1000); }
+		static float getFPS() { return Profiler::getAverageFPS(); }
 
-		bool init(std::string name, int width, int height);
+		/*
+		* Simulation runs in fixed steps of 1 / tickRate
+		* seconds no matter how fast we're rendering.
+		* If a frame takes too long we run up to
+		* maxCatchUpSteps ticks to catch back up, and
+		* drop whatever time is left past that so one
+		* bad hitch can't snowball into a death spiral.
+		* 
+		* A frame rate limit of 0 renders as often as
+		* the loop can (so vsync or nothing caps it),
+		* otherwise we sleep between frames.
+		*/
+		static void setTickRate(int ticksPerSecond);
+		static void setMaxCatchUpSteps(int steps) { m_MaxCatchUpSteps = steps > 0 ? steps : 1; }
+		static void setFrameRateLimit(int framesPerSecond) { m_FrameRateLimit = framesPerSecond > 0 ? framesPerSecond : 0; }
+		static int getTickRate() { return m_TickRate; }
+		static float getDeltaTime() { return (float)m_TickSeconds; }
+		static float getInterpolationAlpha() { return m_Alpha; }
+		static uint64_t getTickCount() { return m_TickCount; }
+		static uint64_t getFrameCount() { return m_FrameCount; }
+
+		/*
+		* Headless mode is for dedicated servers, batch
+		* simulation and soak tests. Only SDL's timer and
+		* event subsystems get initialized, no window or
+		* RenderSystem is created, and texture loads just
+		* record metadata. By default we still tick at the
+		* fixed tick rate, but free running steps exactly
+		* one tick per loop with no sleeping at all.
+		*/
+		static bool isHeadless() { return m_Headless; }
+		static void setFreeRunning(bool freeRunning) { m_FreeRunning = freeRunning; }
+
+		/*
+		* Normally frames are drawn on a render thread
+		* while the next one simulates. Lockstep draws
+		* each frame on the main thread right after it's
+		* simulated instead, which is handy for debugging.
+		* Has to be set before init.
+		*/
+		static void setRenderLockstep(bool lockstep) { m_RenderLockstep = lockstep; }
+		static bool isRenderLockstep() { return m_RenderLockstep; }
+
+		/*
+		* Offscreen runs the whole RenderSystem as usual
+		* but draws into a surface with SDL's software
+		* renderer rather than opening a window (see
+		* Window::setOffscreen). The debug overlay is
+		* left out so it can't end up in captured frames.
+		* Has to be set before init.
+		*/
+		static void setOffscreen(bool offscreen) { m_Offscreen = offscreen; }
+		static bool isOffscreen() { return m_Offscreen; }
+
+		/*
+		* Starts recording frames to disk as soon as
+		* the renderer is up (see FrameCapture), and
+		* keeps at it until we close. Has to be set
+		* before init. The debug overlay can start and
+		* stop recordings while running too.
+		*/
+		static void setFrameCapture(const FrameCaptureSettings& settings) { m_CaptureFrames = true; m_CaptureSettings = settings; }
+
+		/*
+		* Only redraws the parts of the screen that
+		* changed each frame, and skips frames where
+		* nothing did (see RenderSystem::SetPartialRedraw).
+		* Has to be set before init.
+		*/
+		static void setPartialRedraw(bool partialRedraw) { m_PartialRedraw = partialRedraw; }
+
+		/*
+		* Offscreen, sprites are drawn by our own tiled
+		* rasterizer rather than SDL's software renderer
+		* (see RenderSystem::SetSoftwareRaster). On by
+		* default, has to be set before init.
+		*/
+		static void setSoftwareRaster(bool softwareRaster) { m_SoftwareRaster = softwareRaster; }
+
+		/*
+		* Initializes the given SDL subsystems if they
+		* haven't been already. Anything beyond timers,
+		* events and video should go through here the
+		* first time it's needed rather than having init
+		* bring up every subsystem SDL has.
+		*/
+		static bool requireSubsystem(Uint32 flags);
+
+		/*
+		* Time to first frame budget in milliseconds,
+		* checked once the first frame is presented.
+		* 0 means we only report the startup timeline.
+		*/
+		static void setStartupBudget(float milliseconds) { m_StartupBudgetMs = milliseconds; }
+		static bool startupWithinBudget() { return m_StartupWithinBudget; }
+
+		/*
+		* The level loaded before the first frame (see
+		* LevelLoader), its textures decode while the
+		* window's being made. Empty starts without one.
+		*/
+		static void setStartLevel(std::string filepath) { m_StartLevel = filepath; }
+
+		bool init(std::string name, int width, int height, bool headless = false);
 		bool gameLoop();
 		bool close();
 
@@ -36,9 +141,30 @@ namespace Funny
 
 		const int IMG_INIT_FLAGS = IMG_INIT_PNG || IMG_INIT_JPG;
 
-		// Temp timestep stuff until a proper physics system is added
-		static int frame;
-		static int frameStart;
-		static float deltaTime;
+		static bool m_Headless;
+		static bool m_FreeRunning;
+		static bool m_RenderLockstep;
+		static bool m_Offscreen;
+		static bool m_CaptureFrames;
+		static FrameCaptureSettings m_CaptureSettings;
+		static bool m_PartialRedraw;
+		static bool m_SoftwareRaster;
+		static float m_StartupBudgetMs;
+		static std::string m_StartLevel;
+		static bool m_StartupWithinBudget;
+
+		// Fixed timestep state
+		static int m_TickRate;
+		static int m_MaxCatchUpSteps;
+		static int m_FrameRateLimit;
+		static double m_TickSeconds;
+		static double m_Accumulator;
+		static float m_Alpha;
+		static uint64_t m_LastCounter;
+		static uint64_t m_FrameDeadline;
+		static uint64_t m_TickCount;
+		static uint64_t m_FrameCount;
+
+		static void waitUntil(uint64_t targetCounter);
 	};
 }
\ No newline at end of file
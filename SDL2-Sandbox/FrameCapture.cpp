@@ -0,0 +1,228 @@
+#include "FrameCapture.h"
+#include "Common.h"
+#include "Profiler.h"
+
+#include <SDL2/SDL_image.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace Funny
+{
+	bool FrameCapture::Start(const FrameCaptureSettings& settings, int width, int height)
+	{
+		Stop();
+
+		if (width <= 0 || height <= 0)
+		{
+			std::cout << "Can't capture frames from a " << width << "x" << height << " renderer." << std::endl;
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(settings.directory, error);
+		if (error)
+		{
+			std::cout << "Unable to create capture directory " << settings.directory << ": " << error.message() << std::endl;
+			return false;
+		}
+
+		m_Settings = settings;
+		m_Settings.buffers = std::max(1, settings.buffers);
+		m_Settings.interval = std::max(1, settings.interval);
+		m_Width = width;
+		m_Height = height;
+
+		m_Buffers.assign(m_Settings.buffers, std::vector<uint32_t>((size_t)width * (size_t)height));
+		m_FreeBuffers.Reset(m_Settings.buffers);
+		m_Queued.Reset(m_Settings.buffers);
+		for (int buffer = 0; buffer < m_Settings.buffers; buffer++)
+		{
+			m_FreeBuffers.TryPush(buffer);
+		}
+
+		m_Presented = 0;
+		m_SpareBuffer = -1;
+		m_PresentedCount = 0;
+		m_Captured = 0;
+		m_Dropped = 0;
+		m_Written = 0;
+		m_Failed = 0;
+		m_ReadbackTotal = 0;
+		m_StartMicros = Profiler::nowMicros();
+
+		m_Stopping = false;
+		m_Encoder = std::thread(&FrameCapture::EncoderMain, this);
+		m_Capturing.store(true, std::memory_order_release);
+
+		std::cout << "Capturing " << width << "x" << height << " frames to [" << m_Settings.directory << "]" << std::endl;
+		return true;
+	}
+
+	/*
+	* Whoever calls this has to make sure the render
+	* thread isn't partway through CaptureFrame, the
+	* RenderSystem does it by holding the renderer
+	* lock.
+	*/
+	void FrameCapture::Stop()
+	{
+		if (!m_Encoder.joinable()) { return; }
+
+		m_Capturing.store(false, std::memory_order_release);
+		m_Stopping.store(true, std::memory_order_release);
+		m_Wake.notify_one();
+		m_Encoder.join();
+
+		FrameCaptureStats stats = GetStats();
+		std::cout << "Frame capture finished: " << stats.written << " written, " << stats.dropped << " dropped, "
+			<< stats.failed << " failed out of " << stats.presented << " frames (" << stats.readbackMs << " ms average read back)" << std::endl;
+
+		std::vector<std::vector<uint32_t>>().swap(m_Buffers);
+	}
+
+	void FrameCapture::CaptureFrame(SDL_Renderer* renderer)
+	{
+		if (!IsCapturing()) { return; }
+
+		uint64_t frame = m_Presented++;
+		m_PresentedCount.store(m_Presented, std::memory_order_relaxed);
+		if (frame % (uint64_t)m_Settings.interval != 0) { return; }
+
+		int buffer = m_SpareBuffer;
+		m_SpareBuffer = -1;
+		if (buffer < 0 && !m_FreeBuffers.TryPop(buffer))
+		{
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		int64_t start = Profiler::nowMicros();
+
+		int width = 0;
+		int height = 0;
+		SDL_GetRendererOutputSize(renderer, &width, &height);
+
+		// Anything resizing the window mid capture just fails frames until it's put back
+		if (width != m_Width || height != m_Height ||
+			SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888, m_Buffers[buffer].data(), m_Width * (int)sizeof(uint32_t)) != 0)
+		{
+			m_SpareBuffer = buffer;
+			m_Failed.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		m_ReadbackTotal.fetch_add(Profiler::nowMicros() - start, std::memory_order_relaxed);
+		m_Captured.fetch_add(1, std::memory_order_relaxed);
+
+		// Can't fail, the ring has room for every buffer
+		m_Queued.TryPush(QueuedFrame { buffer, frame, start - m_StartMicros });
+		m_Wake.notify_one();
+	}
+
+	FrameCaptureStats FrameCapture::GetStats() const
+	{
+		FrameCaptureStats stats;
+		stats.presented = m_PresentedCount.load(std::memory_order_relaxed);
+		stats.captured = m_Captured.load(std::memory_order_relaxed);
+		stats.dropped = m_Dropped.load(std::memory_order_relaxed);
+		stats.written = m_Written.load(std::memory_order_relaxed);
+		stats.failed = m_Failed.load(std::memory_order_relaxed);
+		stats.queued = (int)m_Queued.Size();
+		stats.readbackMs = (stats.captured > 0) ? (float)m_ReadbackTotal.load(std::memory_order_relaxed) / 1000.0f / (float)stats.captured : 0;
+		return stats;
+	}
+
+	/*
+	* We check whether we've been told to stop before
+	* looking for work, so by the time we see the ring
+	* empty and quit, every frame pushed before the
+	* stop has already been written.
+	*/
+	void FrameCapture::EncoderMain()
+	{
+		std::ofstream manifest(m_Settings.directory + "/capture.txt", std::ios::out | std::ios::trunc);
+		if (!manifest.is_open())
+		{
+			std::cout << "Unable to write capture manifest to " << m_Settings.directory << std::endl;
+		}
+
+		manifest << "format " << ((m_Settings.format == CaptureFormat::PNG) ? "png" : "raw") << " width " << m_Width << " height " << m_Height << " pixels ARGB8888\n";
+		manifest << "# frame presentMicros\n";
+
+		while (true)
+		{
+			bool stopping = m_Stopping.load(std::memory_order_acquire);
+
+			QueuedFrame frame;
+			if (!m_Queued.TryPop(frame))
+			{
+				if (stopping) { break; }
+
+				std::unique_lock<std::mutex> lock(m_WakeMutex);
+				m_Wake.wait_for(lock, std::chrono::milliseconds(5));
+				continue;
+			}
+
+			if (WriteFrame(frame))
+			{
+				m_Written.fetch_add(1, std::memory_order_relaxed);
+				manifest << frame.frame << " " << frame.presentMicros << "\n";
+			}
+			else
+			{
+				m_Failed.fetch_add(1, std::memory_order_relaxed);
+			}
+
+			m_FreeBuffers.TryPush(frame.buffer);
+		}
+	}
+
+	bool FrameCapture::WriteFrame(const QueuedFrame& frame)
+	{
+		std::vector<uint32_t>& pixels = m_Buffers[frame.buffer];
+
+		// Not every renderer fills in alpha when reading back, and footage has no use for it anyway
+		for (uint32_t& pixel : pixels)
+		{
+			pixel |= 0xFF000000u;
+		}
+
+		bool png = (m_Settings.format == CaptureFormat::PNG);
+		char name[64];
+		std::snprintf(name, sizeof(name), "frame_%06llu.%s", (unsigned long long)frame.frame, png ? "png" : "raw");
+		std::string path = m_Settings.directory + "/" + name;
+
+		if (png)
+		{
+			SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels.data(), m_Width, m_Height, 32, m_Width * (int)sizeof(uint32_t), SDL_PIXELFORMAT_ARGB8888);
+			if (surface == nullptr)
+			{
+				std::cout << "Unable to wrap captured frame in a surface: " << SDL_GetError() << std::endl;
+				return false;
+			}
+
+			int result = IMG_SavePNG(surface, path.c_str());
+			SDL_FreeSurface(surface);
+
+			if (result != 0)
+			{
+				std::cout << "Unable to save captured frame to " << path << ": " << IMG_GetError() << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+
+		std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Unable to save captured frame to " << path << std::endl;
+			return false;
+		}
+
+		file.write((const char*)pixels.data(), (std::streamsize)(pixels.size() * sizeof(uint32_t)));
+		return file.good();
+	}
+}
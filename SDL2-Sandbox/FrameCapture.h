@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "SpscRing.hpp"
+
+namespace Funny
+{
+	enum class CaptureFormat : uint8_t
+	{
+		PNG,
+		RAW		// Tightly packed ARGB8888 rows, exactly as they were read back
+	};
+
+	struct FrameCaptureSettings
+	{
+		std::string directory = "capture";
+		CaptureFormat format = CaptureFormat::PNG;
+		int buffers = 8;	// Frames that can be waiting on the encoder before we start dropping
+		int interval = 1;	// Capture every Nth presented frame
+	};
+
+	struct FrameCaptureStats
+	{
+		uint64_t presented = 0;	// Frames that came by while capturing, captured or not
+		uint64_t captured = 0;	// Read back and handed to the encoder
+		uint64_t dropped = 0;	// Due for capture, but every buffer was still waiting on the encoder
+		uint64_t written = 0;
+		uint64_t failed = 0;	// Read backs or writes that errored
+		int queued = 0;			// Waiting on the encoder right now
+		float readbackMs = 0;	// Average time the render thread spent reading a frame back
+	};
+
+	/*
+	* Records what the renderer draws as a sequence
+	* of numbered image files for looking over later,
+	* without ever holding up the game.
+	*
+	* The render thread reads each frame back into one
+	* of a fixed pool of buffers and pushes it down a
+	* lock free ring to an encoder thread, which writes
+	* it out and hands the buffer back through a second
+	* ring. If the encoder falls so far behind that no
+	* buffer is free, the frame is dropped and counted
+	* instead of waiting for one.
+	*
+	* Files are named after the frame's number since
+	* the capture started, so drops show up as gaps,
+	* and capture.txt lists every frame written along
+	* with when it was presented, for replaying the
+	* footage at the speed it was played.
+	*/
+	class FrameCapture
+	{
+	public:
+		~FrameCapture() { Stop(); }
+
+		// Width and height have to match the renderer's output
+		bool Start(const FrameCaptureSettings& settings, int width, int height);
+
+		// Writes out whatever's still queued before returning
+		void Stop();
+
+		bool IsCapturing() const { return m_Capturing.load(std::memory_order_acquire); }
+
+		// Render thread only, with the frame drawn but not yet presented
+		void CaptureFrame(SDL_Renderer* renderer);
+
+		FrameCaptureStats GetStats() const;
+
+	private:
+		struct QueuedFrame
+		{
+			int buffer = 0;
+			uint64_t frame = 0;
+			int64_t presentMicros = 0;
+		};
+
+		FrameCaptureSettings m_Settings;
+		int m_Width = 0;
+		int m_Height = 0;
+
+		std::vector<std::vector<uint32_t>> m_Buffers;
+		SpscRing<int> m_FreeBuffers;		// Encoder to render thread
+		SpscRing<QueuedFrame> m_Queued;		// Render thread to encoder
+
+		std::atomic<bool> m_Capturing { false };
+		std::atomic<bool> m_Stopping { false };
+		int64_t m_StartMicros = 0;
+
+		// Only ever touched by the render thread
+		uint64_t m_Presented = 0;
+		int m_SpareBuffer = -1; // A buffer we took but couldn't use, kept for the next frame rather than handed back
+
+		std::atomic<uint64_t> m_PresentedCount { 0 };
+		std::atomic<uint64_t> m_Captured { 0 };
+		std::atomic<uint64_t> m_Dropped { 0 };
+		std::atomic<uint64_t> m_Written { 0 };
+		std::atomic<uint64_t> m_Failed { 0 };
+		std::atomic<int64_t> m_ReadbackTotal { 0 };
+
+		/*
+		* The encoder sleeps on this when there's
+		* nothing queued. Pushing a frame only ever
+		* notifies it, never takes the lock, and the
+		* encoder wakes up on its own every so often
+		* in case a notify slipped past it.
+		*/
+		std::thread m_Encoder;
+		std::mutex m_WakeMutex;
+		std::condition_variable m_Wake;
+
+		void EncoderMain();
+		bool WriteFrame(const QueuedFrame& frame);
+	};
+}
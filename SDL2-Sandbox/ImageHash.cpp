@@ -0,0 +1,67 @@
+#include "ImageHash.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace Funny
+{
+	static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+	static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+	uint64_t ImageHash::hashPixels(const void* pixels, int width, int height, int pitch, int bytesPerPixel)
+	{
+		uint64_t hash = FNV_OFFSET_BASIS;
+		const size_t rowBytes = (size_t)width * (size_t)bytesPerPixel;
+
+		for (int y = 0; y < height; y++)
+		{
+			const uint8_t* row = (const uint8_t*)pixels + (size_t)y * (size_t)pitch;
+			for (size_t i = 0; i < rowBytes; i++)
+			{
+				hash ^= row[i];
+				hash *= FNV_PRIME;
+			}
+		}
+
+		return hash;
+	}
+
+	uint64_t ImageHash::hashSurface(SDL_Surface* surface)
+	{
+		if (surface == nullptr) { return 0; }
+
+		if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) != 0)
+		{
+			std::cout << "Could not lock surface for hashing: " << SDL_GetError() << std::endl;
+			return 0;
+		}
+
+		uint64_t hash = hashPixels(surface->pixels, surface->w, surface->h, surface->pitch, surface->format->BytesPerPixel);
+
+		if (SDL_MUSTLOCK(surface))
+		{
+			SDL_UnlockSurface(surface);
+		}
+
+		return hash;
+	}
+
+	std::string ImageHash::toString(uint64_t hash)
+	{
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+		return std::string(text);
+	}
+
+	bool ImageHash::fromString(const std::string& text, uint64_t& hash)
+	{
+		if (text.empty() || text.size() > 16) { return false; }
+
+		char* end = nullptr;
+		unsigned long long value = std::strtoull(text.c_str(), &end, 16);
+		if (end == nullptr || *end != '\0') { return false; }
+
+		hash = (uint64_t)value;
+		return true;
+	}
+}
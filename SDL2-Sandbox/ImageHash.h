@@ -0,0 +1,29 @@
+#pragma once
+#include <cstdint>
+#include <SDL2/SDL.h>
+#include "Common.h"
+
+namespace Funny
+{
+	/*
+	* Fingerprints for rendered frames, used by golden
+	* image tests to check a frame came out exactly
+	* the same as a known good one without having to
+	* keep the whole image around.
+	* 
+	* This is 64 bit FNV-1a over the pixels a row at a
+	* time, so the padding SDL puts on the end of each
+	* row doesn't count. Pixels are hashed as stored,
+	* so only compare hashes of the same pixel format.
+	*/
+	class ImageHash
+	{
+	public:
+		static uint64_t hashPixels(const void* pixels, int width, int height, int pitch, int bytesPerPixel);
+		static uint64_t hashSurface(SDL_Surface* surface);
+
+		// Hashes get stored and printed as 16 hex digits
+		static std::string toString(uint64_t hash);
+		static bool fromString(const std::string& text, uint64_t& hash);
+	};
+}
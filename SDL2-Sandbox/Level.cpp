@@ -0,0 +1,218 @@
+#include "Level.h"
+#include "Engine.h"
+#include "ResourceManager.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace Funny
+{
+	/*
+	* Reads one row of a tilemap, which needs a
+	* value between lowest and highest for each of
+	* the map's columns, and no more rows than the
+	* map has.
+	*/
+	static bool ReadTileRow(std::istringstream& entry, const TilemapLayout& layout, int lowest, int highest, std::vector<int>& values)
+	{
+		int columns = 0;
+		int value = 0;
+		while (entry >> value)
+		{
+			if (value < lowest || value > highest) { return false; }
+			values.push_back(value);
+			columns++;
+		}
+
+		return entry.eof() && columns == layout.columns && (int)values.size() <= layout.columns * layout.rows;
+	}
+
+	/*
+	* Stops at the first bad line, so a typo can't
+	* leave us with half a level that looks fine.
+	*/
+	bool Level::LoadManifest(const std::string& filepath)
+	{
+		std::ifstream file(filepath);
+		if (!file.is_open())
+		{
+			std::cout << "Unable to open level manifest at path " << filepath << std::endl;
+			return false;
+		}
+
+		LevelManifest manifest;
+		manifest.filepath = filepath;
+		manifest.name = std::filesystem::path(filepath).stem().string();
+
+		std::string line;
+		int lineNumber = 0;
+		while (std::getline(file, line))
+		{
+			lineNumber++;
+
+			size_t comment = line.find('#');
+			if (comment != std::string::npos)
+			{
+				line.erase(comment);
+			}
+
+			std::istringstream entry(line);
+			std::string kind;
+			if (!(entry >> kind)) { continue; }
+
+			bool valid = false;
+			if (kind == "texture")
+			{
+				LevelTexture texture;
+				valid = (bool)(entry >> texture.name >> texture.filepath);
+				if (valid)
+				{
+					manifest.textures.push_back(texture);
+				}
+			}
+
+			else if (kind == "tilemap")
+			{
+				TilemapLayout& layout = manifest.tilemap;
+				valid = (bool)(entry >> layout.sheet >> layout.sheetColumns >> layout.sheetRows >> layout.tileWidth >> layout.tileHeight
+					>> layout.columns >> layout.rows >> layout.tileSize);
+				valid = valid && layout.sheetColumns > 0 && layout.sheetRows > 0 && layout.columns > 0 && layout.rows > 0
+					&& layout.columns * layout.rows <= MAX_TILES;
+				manifest.hasTilemap = valid;
+			}
+
+			// Rows of the map, which have to come after the tilemap line so we know how wide a row is
+			else if (kind == "tiles")
+			{
+				TilemapLayout& layout = manifest.tilemap;
+				valid = manifest.hasTilemap && ReadTileRow(entry, layout, EMPTY_TILE, layout.sheetColumns * layout.sheetRows - 1, layout.tiles);
+			}
+
+			else if (kind == "collision")
+			{
+				TilemapLayout& layout = manifest.tilemap;
+				std::vector<int> row;
+				valid = manifest.hasTilemap && ReadTileRow(entry, layout, NONE, COLLISION_TYPES - 1, row);
+				for (int type : row)
+				{
+					layout.collision.push_back((TileCollisionType)type);
+				}
+			}
+
+			else if (kind == "prefab")
+			{
+				LevelPrefab prefab;
+				int layer = 0;
+				valid = (bool)(entry >> prefab.name >> prefab.texture >> prefab.size.x >> prefab.size.y >> layer);
+				prefab.layer = (uint8_t)layer;
+
+				SDL_Rect& rect = prefab.sourceRect;
+				if (valid && entry >> rect.x)
+				{
+					prefab.hasSourceRect = true;
+					valid = (bool)(entry >> rect.y >> rect.w >> rect.h);
+				}
+
+				if (valid)
+				{
+					manifest.prefabs.push_back(prefab);
+				}
+			}
+
+			else if (kind == "spawn")
+			{
+				LevelSpawn spawn;
+				valid = (bool)(entry >> spawn.prefab >> spawn.position.x >> spawn.position.y);
+				if (valid)
+				{
+					manifest.spawns.push_back(spawn);
+				}
+			}
+
+			if (!valid)
+			{
+				std::cout << "Bad entry in level manifest " << filepath << " on line " << lineNumber << ": " << line << std::endl;
+				return false;
+			}
+		}
+
+		// Collision's optional, everything's NONE without it
+		const TilemapLayout& layout = manifest.tilemap;
+		int tileCount = layout.columns * layout.rows;
+		if (manifest.hasTilemap && ((int)layout.tiles.size() != tileCount || (!layout.collision.empty() && (int)layout.collision.size() != tileCount)))
+		{
+			std::cout << "Level manifest " << filepath << " has " << layout.tiles.size() / layout.columns << " rows of tiles and "
+				<< layout.collision.size() / layout.columns << " of collision, its tilemap needs " << layout.rows << std::endl;
+			return false;
+		}
+
+		m_Manifest = manifest;
+		return true;
+	}
+
+	const LevelPrefab* Level::FindPrefab(const std::string& name) const
+	{
+		for (const LevelPrefab& prefab : m_Manifest.prefabs)
+		{
+			if (prefab.name == name)
+			{
+				return &prefab;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void Level::Spawn()
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+
+		for (const LevelSpawn& spawn : m_Manifest.spawns)
+		{
+			const LevelPrefab* prefab = FindPrefab(spawn.prefab);
+			if (prefab == nullptr)
+			{
+				std::cout << "Level " << m_Manifest.name << " has no prefab named " << spawn.prefab << std::endl;
+				continue;
+			}
+
+			SDL_Rect rect = prefab->sourceRect;
+			TextureInfo info;
+			if (!prefab->hasSourceRect && ResourceManager::getTextureInfo(prefab->texture, info))
+			{
+				rect = SDL_Rect { 0, 0, info.width, info.height };
+			}
+
+			// Headless loads are only stubs, which applyTexture can't find
+			Renderable renderable;
+			if (ResourceManager::isHeadless() || !ResourceManager::applyTexture(renderable, prefab->texture, rect))
+			{
+				renderable.texture = ResourceManager::getTextureHandle(prefab->texture);
+				renderable.sourceRect = rect;
+			}
+			renderable.drawToScreen = false;
+			renderable.layer = prefab->layer;
+
+			Transform transform;
+			transform.position = spawn.position;
+			transform.scale = prefab->size;
+
+			Entity entity = coordinator->CreateEntity();
+			coordinator->AddComponent<Transform>(entity, transform);
+			coordinator->AddComponent<Renderable>(entity, renderable);
+			m_Entities.push_back(entity);
+		}
+	}
+
+	void Level::Despawn()
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+
+		for (Entity entity : m_Entities)
+		{
+			coordinator->DestroyEntity(entity);
+		}
+		m_Entities.clear();
+	}
+}
@@ -1,12 +1,92 @@
 #pragma once
+#include "Common.h"
+#include "Types.h"
+#include "Tilemap.h"
 
 namespace Funny
 {
+	struct LevelTexture
+	{
+		std::string name;
+		std::string filepath;
+	};
+
+	/*
+	* Something a level places, drawn with (part
+	* of) one of its textures. Without a source
+	* rect it draws the whole image.
+	*/
+	struct LevelPrefab
+	{
+		std::string name;
+		std::string texture;
+		Vector2 size;
+		uint8_t layer = 0;
+		bool hasSourceRect = false;
+		SDL_Rect sourceRect { 0, 0, 0, 0 };
+	};
+
+	struct LevelSpawn
+	{
+		std::string prefab;
+		Vector2 position;
+	};
+
+	/*
+	* Everything a level needs, so all of it can be
+	* loaded before the level is. Manifests are
+	* text files with one entry per line (blank
+	* lines and anything after a # are ignored):
+	*
+	*   texture NAME PATH
+	*   tilemap SHEET SHEET_COLUMNS SHEET_ROWS TILE_WIDTH TILE_HEIGHT COLUMNS ROWS TILE_SIZE
+	*   tiles SPRITE_ID SPRITE_ID ...
+	*   collision TYPE TYPE ...
+	*   prefab NAME TEXTURE WIDTH HEIGHT LAYER [X Y W H]
+	*   spawn PREFAB X Y
+	*
+	* A tilemap needs a tiles line for each of its
+	* rows, top to bottom, each with a sprite ID
+	* (or -1 for no tile) for every column. It can
+	* also have a collision line for each row, the
+	* same way, with a TileCollisionType (0 for
+	* none, 1 to block) for every column.
+	*
+	* Textures are shared between levels by name,
+	* so two levels naming the same texture get the
+	* same one, whichever path they give for it.
+	*/
+	struct LevelManifest
+	{
+		std::string name;		// The file's name, without its directory or extension
+		std::string filepath;
+		std::vector<LevelTexture> textures;
+		bool hasTilemap = false;
+		TilemapLayout tilemap;
+		std::vector<LevelPrefab> prefabs;
+		std::vector<LevelSpawn> spawns;
+	};
+
+	/*
+	* A level's manifest and the entities it spawned.
+	* Loading its assets (and when) is LevelLoader's
+	* job, a Level only ever spawns from textures
+	* that are already there.
+	*/
 	class Level
 	{
 	public:
+		bool LoadManifest(const std::string& filepath);
+		const LevelManifest& GetManifest() const { return m_Manifest; }
+
+		void Spawn();
+		void Despawn();
+		const std::vector<Entity>& GetEntities() const { return m_Entities; }
 
 	private:
+		LevelManifest m_Manifest;
+		std::vector<Entity> m_Entities;
 
+		const LevelPrefab* FindPrefab(const std::string& name) const;
 	};
-}
\ No newline at end of file
+}
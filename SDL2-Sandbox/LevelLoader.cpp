@@ -0,0 +1,228 @@
+#include "LevelLoader.h"
+#include "Engine.h"
+#include "RenderSystem.h"
+#include "ResourceManager.h"
+
+namespace Funny
+{
+	std::unique_ptr<Level> LevelLoader::m_Current;
+	std::unique_ptr<Level> LevelLoader::m_Pending;
+	std::vector<TextureHandle> LevelLoader::m_PendingHandles;
+	LevelLoadStats LevelLoader::m_PendingStats;
+	int64_t LevelLoader::m_PendingStart = 0;
+	bool LevelLoader::m_PendingReady = false;
+	bool LevelLoader::m_SwitchWhenReady = false;
+	LevelLoadStats LevelLoader::m_LastLoad;
+	std::unordered_map<std::string, uint32_t> LevelLoader::m_TextureRefs;
+
+	bool LevelLoader::queueStartupLevel(std::string filepath)
+	{
+		return startLoading(filepath, true);
+	}
+
+	bool LevelLoader::preloadLevel(std::string filepath)
+	{
+		return startLoading(filepath, false);
+	}
+
+	bool LevelLoader::loadLevel(std::string filepath)
+	{
+		if (!preloadLevel(filepath)) { return false; }
+
+		switchWhenReady();
+		return true;
+	}
+
+	/*
+	* Takes a reference on every texture the level
+	* names, only loading the ones no other level
+	* has already. The level it replaces lets go of
+	* its textures after, so the two keep whatever
+	* they share loaded.
+	*/
+	bool LevelLoader::startLoading(std::string filepath, bool startup)
+	{
+		std::unique_ptr<Level> level = std::make_unique<Level>();
+		if (!level->LoadManifest(filepath))
+		{
+			return false;
+		}
+
+		// Whatever was loading before is dropped once the new level has its references
+		std::unique_ptr<Level> replaced = std::move(m_Pending);
+		m_Pending = std::move(level);
+		m_PendingHandles.clear();
+		m_PendingStats = LevelLoadStats();
+		m_PendingStart = Profiler::nowMicros();
+		m_PendingReady = false;
+		m_SwitchWhenReady = false;
+
+		const LevelManifest& manifest = m_Pending->GetManifest();
+		m_PendingStats.name = manifest.name;
+
+		for (const LevelTexture& texture : manifest.textures)
+		{
+			m_PendingStats.textures++;
+
+			uint32_t& refs = m_TextureRefs[texture.name];
+			bool shared = refs++ > 0 || ResourceManager::isAtlased(texture.name);
+			m_PendingStats.shared += shared ? 1 : 0;
+
+			if (startup)
+			{
+				if (!shared)
+				{
+					ResourceManager::queueTextureDecode(texture.filepath, texture.name);
+				}
+				continue;
+			}
+
+			// Shared textures hand back their handle without loading again
+			m_PendingHandles.push_back(ResourceManager::loadTextureAsync(texture.filepath, texture.name));
+		}
+
+		// So only the textures nothing else wants get unloaded
+		if (replaced != nullptr)
+		{
+			releaseTextures(replaced->GetManifest());
+		}
+
+		return true;
+	}
+
+	bool LevelLoader::isPendingReady()
+	{
+		for (TextureHandle handle : m_PendingHandles)
+		{
+			if (ResourceManager::isTextureLoading(handle))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void LevelLoader::finishLoading()
+	{
+		if (m_Pending == nullptr) { return; }
+
+		if (!m_PendingReady)
+		{
+			m_PendingStats.readyMs = (double)(Profiler::nowMicros() - m_PendingStart) / 1000.0;
+		}
+		swapLevels();
+	}
+
+	void LevelLoader::update()
+	{
+		if (m_Pending == nullptr) { return; }
+
+		if (!m_PendingReady)
+		{
+			if (!isPendingReady())
+			{
+				m_PendingStats.frames++;
+				return;
+			}
+
+			m_PendingReady = true;
+			m_PendingStats.readyMs = (double)(Profiler::nowMicros() - m_PendingStart) / 1000.0;
+		}
+
+		if (m_SwitchWhenReady)
+		{
+			swapLevels();
+		}
+	}
+
+	/*
+	* Only happens between frames, once the render
+	* thread's drawn everything it was handed, since
+	* its frames can still point at the old level's
+	* entities, tilemap and textures. The old level's
+	* textures go last, after the new level's taken
+	* its references on whatever the two share.
+	*/
+	void LevelLoader::swapLevels()
+	{
+		FUNNY_PROFILE_SCOPE("SwapLevels");
+
+		int64_t start = Profiler::nowMicros();
+
+		if (!Engine::isHeadless())
+		{
+			Engine::getCoordinator()->GetSystem<RenderSystem>()->WaitForRenderThread();
+		}
+
+		std::unique_ptr<Level> previous = std::move(m_Current);
+		m_Current = std::move(m_Pending);
+		m_PendingHandles.clear();
+		m_SwitchWhenReady = false;
+
+		if (previous != nullptr)
+		{
+			previous->Despawn();
+		}
+
+		// There's only the one tilemap, which each level loads its own map into
+		const LevelManifest& manifest = m_Current->GetManifest();
+		if (manifest.hasTilemap)
+		{
+			if (Engine::test == nullptr)
+			{
+				Engine::test = new Tilemap();
+			}
+			Engine::test->loadMap(manifest.tilemap);
+		}
+
+		else if (previous != nullptr && previous->GetManifest().hasTilemap && Engine::test != nullptr)
+		{
+			Engine::test->unloadMap();
+		}
+
+		m_Current->Spawn();
+
+		if (previous != nullptr)
+		{
+			releaseTextures(previous->GetManifest());
+		}
+
+		m_PendingStats.swapMs = (double)(Profiler::nowMicros() - start) / 1000.0;
+		m_LastLoad = m_PendingStats;
+
+		std::cout << "Loaded level " << m_LastLoad.name << ": " << m_LastLoad.textures << " textures (" << m_LastLoad.shared << " shared), ready in "
+			<< m_LastLoad.readyMs << "ms over " << m_LastLoad.frames << " frames, swapped in " << m_LastLoad.swapMs << "ms" << std::endl;
+	}
+
+	// Atlased textures are never unloaded, their pages are shared with textures levels don't know about
+	void LevelLoader::releaseTextures(const LevelManifest& manifest)
+	{
+		for (const LevelTexture& texture : manifest.textures)
+		{
+			auto found = m_TextureRefs.find(texture.name);
+			if (found == m_TextureRefs.end() || --found->second > 0) { continue; }
+
+			m_TextureRefs.erase(found);
+			if (!ResourceManager::isAtlased(texture.name))
+			{
+				ResourceManager::unloadTexture(texture.name);
+			}
+		}
+	}
+
+	// The textures themselves go with everything else in unloadAllTextures
+	void LevelLoader::unloadAll()
+	{
+		if (m_Current != nullptr)
+		{
+			m_Current->Despawn();
+		}
+
+		m_Current.reset();
+		m_Pending.reset();
+		m_PendingHandles.clear();
+		m_SwitchWhenReady = false;
+		m_TextureRefs.clear();
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "Common.h"
+#include "Types.h"
+#include "Level.h"
+#include <memory>
+
+namespace Funny
+{
+	/*
+	* How a level's load went. Ready is counted from
+	* asking for the level to every texture it needs
+	* being on the renderer, swap is the pause while
+	* the old level goes and the new one comes in.
+	*/
+	struct LevelLoadStats
+	{
+		std::string name;
+		int textures = 0;
+		int shared = 0;			// Already loaded for the level before, so not loaded again
+		int frames = 0;			// Frames played while it loaded in the background
+		double readyMs = 0;
+		double swapMs = 0;
+	};
+
+	/*
+	* Loads levels from their manifests. The next
+	* level's textures load in the background (see
+	* loadTextureAsync) while the current one keeps
+	* playing, and once all of them are on the
+	* renderer, update swaps the levels over between
+	* two frames, so nothing ever draws half of one
+	* level or the placeholder for one of its
+	* textures.
+	*
+	* Textures are counted by how many loaded levels
+	* (the current one and the one loading) name
+	* them. Anything both name stays right where it
+	* is through the swap, and a texture's only
+	* unloaded once no level names it any more.
+	* Atlased textures are the exception, those are
+	* on pages shared with others and stay for good.
+	*/
+	class LevelLoader
+	{
+	public:
+		/*
+		* For the level we start in. Its textures get
+		* queued with queueTextureDecode instead, so
+		* they decode while the window's being made
+		* and get packed into the startup atlas, and
+		* finishLoading puts it in once they're done.
+		*/
+		static bool queueStartupLevel(std::string filepath);
+		static void finishLoading();
+
+		// Starts loading a level without switching to it, replacing any other level loading
+		static bool preloadLevel(std::string filepath);
+		static void switchWhenReady() { m_SwitchWhenReady = true; }
+		static bool loadLevel(std::string filepath);
+		static bool isLoading() { return m_Pending != nullptr; }
+
+		// Called once a frame, after the frame's been submitted
+		static void update();
+
+		static Level* getCurrentLevel() { return m_Current.get(); }
+		static const LevelLoadStats& getLastLoadStats() { return m_LastLoad; }
+
+		static void unloadAll();
+
+	private:
+		static std::unique_ptr<Level> m_Current;
+		static std::unique_ptr<Level> m_Pending;
+		static std::vector<TextureHandle> m_PendingHandles;
+		static LevelLoadStats m_PendingStats;
+		static int64_t m_PendingStart;
+		static bool m_PendingReady;
+		static bool m_SwitchWhenReady;
+		static LevelLoadStats m_LastLoad;
+
+		static std::unordered_map<std::string, uint32_t> m_TextureRefs;
+
+		static bool startLoading(std::string filepath, bool startup);
+		static bool isPendingReady();
+		static void swapLevels();
+		static void releaseTextures(const LevelManifest& manifest);
+	};
+}
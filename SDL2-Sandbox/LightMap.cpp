@@ -0,0 +1,399 @@
+#include "LightMap.h"
+#include "Tilemap.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Funny
+{
+	namespace
+	{
+		// Rays either side of a corner are this far off of it, in radians
+		const float CORNER_NUDGE = 0.0001f;
+
+		// How far past its ends a segment still counts as hit, so
+		// rays aimed right at a corner don't sneak through the gap
+		const float HIT_SLACK = 0.001f;
+
+		/*
+		* Tile edges are always axis aligned, which
+		* makes a ray hitting one a single divide.
+		*/
+		struct Segment
+		{
+			float fixed;	// Y of a horizontal segment, X of a vertical one
+			float min;
+			float max;
+			bool horizontal;
+		};
+
+		struct Occupancy
+		{
+			const LightOccluders& occluders;
+
+			bool Blocked(int x, int y) const
+			{
+				if (x < 0 || y < 0 || x >= occluders.columns || y >= occluders.rows) { return false; }
+				return occluders.collision[y * occluders.columns + x] == BLOCK;
+			}
+		};
+
+		/*
+		* Walks one row (or column) of tiles and adds a
+		* segment for every run of them that has an
+		* exposed edge on the side we're looking at.
+		*/
+		template <typename HasEdge>
+		void AddRuns(std::vector<Segment>& segments, int first, int last, float fixed, float start, float size, bool horizontal, HasEdge hasEdge)
+		{
+			int runStart = -1;
+			for (int i = first; i <= last + 1; i++)
+			{
+				bool edge = (i <= last) && hasEdge(i);
+				if (edge && runStart < 0)
+				{
+					runStart = i;
+				}
+
+				else if (!edge && runStart >= 0)
+				{
+					segments.push_back({ fixed, start + (float)runStart * size, start + (float)i * size, horizontal });
+					runStart = -1;
+				}
+			}
+		}
+
+		inline uint32_t ToChannel(float value)
+		{
+			return (uint32_t)(std::max(0.0f, std::min(value, 1.0f)) * 255.0f + 0.5f);
+		}
+	}
+
+	void LightMap::SetAmbient(float r, float g, float b)
+	{
+		m_Ambient[0] = r;
+		m_Ambient[1] = g;
+		m_Ambient[2] = b;
+	}
+
+	/*
+	* Only edges facing the light can be the first
+	* thing a ray hits, so back faces never become
+	* segments. The square around the light's radius
+	* goes in too so every ray hits something.
+	*/
+	void LightMap::BuildVisibility(const LightSource& light, const LightOccluders& occluders, std::vector<Vector2>& points)
+	{
+		thread_local std::vector<Segment> segments;
+		thread_local std::vector<float> angles;
+
+		points.clear();
+		if (light.radius <= 0) { return; }
+
+		const float lx = light.position.x;
+		const float ly = light.position.y;
+		const float left = lx - light.radius;
+		const float right = lx + light.radius;
+		const float top = ly - light.radius;
+		const float bottom = ly + light.radius;
+
+		segments.clear();
+		segments.push_back({ top, left, right, true });
+		segments.push_back({ bottom, left, right, true });
+		segments.push_back({ left, top, bottom, false });
+		segments.push_back({ right, top, bottom, false });
+
+		if (occluders.collision != nullptr && occluders.tileWidth > 0 && occluders.tileHeight > 0)
+		{
+			const Occupancy grid { occluders };
+			const float ox = occluders.originX;
+			const float oy = occluders.originY;
+			const float tw = occluders.tileWidth;
+			const float th = occluders.tileHeight;
+
+			if (grid.Blocked((int)std::floor((lx - ox) / tw), (int)std::floor((ly - oy) / th))) { return; }
+
+			const int tx0 = std::max(0, (int)std::floor((left - ox) / tw));
+			const int ty0 = std::max(0, (int)std::floor((top - oy) / th));
+			const int tx1 = std::min(occluders.columns - 1, (int)std::floor((right - ox) / tw));
+			const int ty1 = std::min(occluders.rows - 1, (int)std::floor((bottom - oy) / th));
+
+			for (int y = ty0; y <= ty1; y++)
+			{
+				const float tileTop = oy + (float)y * th;
+				if (ly < tileTop)
+				{
+					AddRuns(segments, tx0, tx1, tileTop, ox, tw, true, [&](int x) { return grid.Blocked(x, y) && !grid.Blocked(x, y - 1); });
+				}
+
+				if (ly > tileTop + th)
+				{
+					AddRuns(segments, tx0, tx1, tileTop + th, ox, tw, true, [&](int x) { return grid.Blocked(x, y) && !grid.Blocked(x, y + 1); });
+				}
+			}
+
+			for (int x = tx0; x <= tx1; x++)
+			{
+				const float tileLeft = ox + (float)x * tw;
+				if (lx < tileLeft)
+				{
+					AddRuns(segments, ty0, ty1, tileLeft, oy, th, false, [&](int y) { return grid.Blocked(x, y) && !grid.Blocked(x - 1, y); });
+				}
+
+				if (lx > tileLeft + tw)
+				{
+					AddRuns(segments, ty0, ty1, tileLeft + tw, oy, th, false, [&](int y) { return grid.Blocked(x, y) && !grid.Blocked(x + 1, y); });
+				}
+			}
+		}
+
+		angles.clear();
+		for (const Segment& segment : segments)
+		{
+			for (float end : { segment.min, segment.max })
+			{
+				float px = segment.horizontal ? end : segment.fixed;
+				float py = segment.horizontal ? segment.fixed : end;
+				float angle = std::atan2(py - ly, px - lx);
+
+				angles.push_back(angle - CORNER_NUDGE);
+				angles.push_back(angle);
+				angles.push_back(angle + CORNER_NUDGE);
+			}
+		}
+		std::sort(angles.begin(), angles.end());
+
+		for (float angle : angles)
+		{
+			const float dx = std::cos(angle);
+			const float dy = std::sin(angle);
+
+			float closest = std::numeric_limits<float>::max();
+			for (const Segment& segment : segments)
+			{
+				float along = segment.horizontal ? dy : dx;
+				if (along == 0) { continue; }
+
+				float distance = (segment.fixed - (segment.horizontal ? ly : lx)) / along;
+				if (distance <= 0 || distance >= closest) { continue; }
+
+				float across = segment.horizontal ? (lx + dx * distance) : (ly + dy * distance);
+				if (across >= segment.min - HIT_SLACK && across <= segment.max + HIT_SLACK)
+				{
+					closest = distance;
+				}
+			}
+
+			if (closest == std::numeric_limits<float>::max()) { continue; }
+			points.push_back(Vector2(lx + dx * closest, ly + dy * closest));
+		}
+	}
+
+	/*
+	* Cache lookups and bookkeeping happen up front
+	* on the calling thread, so the parallel parts
+	* only ever write to their own job or band.
+	*/
+	void LightMap::Build(const Camera& camera, const LightOccluders& occluders, const std::vector<LightSource>& lights, LightMapImage& image)
+	{
+		FUNNY_PROFILE_SCOPE("LightMap");
+
+		m_Frame++;
+		m_Stats = LightMapStats();
+		m_Stats.lights = (int)lights.size();
+		m_Stats.threads = GetThreadCount();
+
+		image.cellSize = m_CellSize;
+		image.width = std::max(0, (camera.viewport.w + m_CellSize - 1) / m_CellSize);
+		image.height = std::max(0, (camera.viewport.h + m_CellSize - 1) / m_CellSize);
+		image.pixels.resize((size_t)image.width * (size_t)image.height);
+		m_Stats.width = image.width;
+		m_Stats.height = image.height;
+
+		if (image.width == 0 || image.height == 0) { return; }
+
+		const SDL_FRect world = camera.GetWorldBounds();
+		const float cellsPerUnit = camera.zoom / (float)m_CellSize;
+
+		if (m_Jobs.size() < lights.size())
+		{
+			m_Jobs.resize(lights.size());
+		}
+		m_JobCount = 0;
+		m_Rebuilds.clear();
+
+		for (const LightSource& light : lights)
+		{
+			Visibility* cached = nullptr;
+			if (light.isStatic)
+			{
+				cached = &m_StaticPolygons[light.id];
+				cached->lastUsed = m_Frame;
+			}
+
+			if (light.radius <= 0 ||
+				light.position.x + light.radius < world.x || light.position.x - light.radius > world.x + world.w ||
+				light.position.y + light.radius < world.y || light.position.y - light.radius > world.y + world.h)
+			{
+				continue;
+			}
+
+			LightJob& job = m_Jobs[m_JobCount++];
+			job.light = &light;
+			job.visibility = (cached != nullptr) ? cached : &job.local;
+			job.rebuild = (cached == nullptr) ||
+				cached->position.x != light.position.x || cached->position.y != light.position.y ||
+				cached->radius != light.radius || cached->collision != occluders.collision ||
+				cached->version != occluders.version;
+
+			if (job.rebuild)
+			{
+				m_Rebuilds.push_back(&job);
+			}
+		}
+
+		// Statics that didn't show up this frame are gone
+		for (auto entry = m_StaticPolygons.begin(); entry != m_StaticPolygons.end();)
+		{
+			entry = (entry->second.lastUsed != m_Frame) ? m_StaticPolygons.erase(entry) : std::next(entry);
+		}
+
+		m_Stats.drawnLights = m_JobCount;
+		m_Stats.builtPolygons = (int)m_Rebuilds.size();
+		m_Stats.cachedPolygons = m_JobCount - (int)m_Rebuilds.size();
+
+		{
+			FUNNY_PROFILE_SCOPE("LightVisibility");
+			m_Pool.ParallelFor((int)m_Rebuilds.size(), [&](int index)
+			{
+				LightJob& job = *m_Rebuilds[index];
+				Visibility& visibility = *job.visibility;
+
+				BuildVisibility(*job.light, occluders, visibility.points);
+				visibility.position = job.light->position;
+				visibility.radius = job.light->radius;
+				visibility.collision = occluders.collision;
+				visibility.version = occluders.version;
+			});
+		}
+
+		for (int i = 0; i < m_JobCount; i++)
+		{
+			LightJob& job = m_Jobs[i];
+			const std::vector<Vector2>& points = job.visibility->points;
+			m_Stats.polygonPoints += (int)points.size();
+
+			job.cells.resize(points.size());
+			float minY = std::numeric_limits<float>::max();
+			float maxY = std::numeric_limits<float>::lowest();
+			for (size_t point = 0; point < points.size(); point++)
+			{
+				job.cells[point] = Vector2((points[point].x - camera.position.x) * cellsPerUnit, (points[point].y - camera.position.y) * cellsPerUnit);
+				minY = std::min(minY, job.cells[point].y);
+				maxY = std::max(maxY, job.cells[point].y);
+			}
+
+			job.centerX = (job.light->position.x - camera.position.x) * cellsPerUnit;
+			job.centerY = (job.light->position.y - camera.position.y) * cellsPerUnit;
+			job.inverseRadius = 1.0f / (job.light->radius * cellsPerUnit);
+
+			// Rows whose centers fall inside the polygon's extent
+			job.row0 = points.empty() ? 0 : std::max(0, (int)std::ceil(minY - 0.5f));
+			job.row1 = points.empty() ? 0 : std::min(image.height, (int)std::ceil(maxY - 0.5f));
+		}
+
+		m_Accumulated.resize((size_t)image.width * (size_t)image.height * 3);
+		m_Image = &image;
+
+		{
+			FUNNY_PROFILE_SCOPE("LightRaster");
+			m_Pool.ParallelFor((image.height + BAND_ROWS - 1) / BAND_ROWS, [this](int band) { DrawBand(band); });
+		}
+
+		m_Image = nullptr;
+	}
+
+	/*
+	* Polygons get filled a row at a time by finding
+	* where the row's center line crosses the outline
+	* and filling between every other pair of crossings,
+	* which works for any shape a polygon can have.
+	*/
+	void LightMap::DrawBand(int band)
+	{
+		thread_local std::vector<float> crossings;
+
+		const int width = m_Image->width;
+		const int y0 = band * BAND_ROWS;
+		const int y1 = std::min(y0 + BAND_ROWS, m_Image->height);
+
+		float* accumulated = m_Accumulated.data() + (size_t)y0 * (size_t)width * 3;
+		std::fill(accumulated, accumulated + (size_t)(y1 - y0) * (size_t)width * 3, 0.0f);
+
+		for (int i = 0; i < m_JobCount; i++)
+		{
+			const LightJob& job = m_Jobs[i];
+			const int rowStart = std::max(y0, job.row0);
+			const int rowEnd = std::min(y1, job.row1);
+			if (rowStart >= rowEnd) { continue; }
+
+			const std::vector<Vector2>& cells = job.cells;
+			const LightSource& light = *job.light;
+
+			for (int y = rowStart; y < rowEnd; y++)
+			{
+				const float centerY = (float)y + 0.5f;
+				const float dy = (centerY - job.centerY) * job.inverseRadius;
+				if (dy * dy >= 1.0f) { continue; }
+
+				crossings.clear();
+				for (size_t point = 0, previous = cells.size() - 1; point < cells.size(); previous = point++)
+				{
+					const Vector2& a = cells[previous];
+					const Vector2& b = cells[point];
+					if ((a.y <= centerY) == (b.y <= centerY)) { continue; }
+
+					crossings.push_back(a.x + (centerY - a.y) * (b.x - a.x) / (b.y - a.y));
+				}
+				std::sort(crossings.begin(), crossings.end());
+
+				// Polygons reach the corners of the light's square, but nothing past its circle gets lit
+				const float halfWidth = std::sqrt(1.0f - dy * dy) / job.inverseRadius;
+				const int circleX0 = std::max(0, (int)std::ceil(job.centerX - halfWidth - 0.5f));
+				const int circleX1 = std::min(width, (int)std::ceil(job.centerX + halfWidth - 0.5f));
+
+				float* row = m_Accumulated.data() + (size_t)y * (size_t)width * 3;
+
+				for (size_t crossing = 0; crossing + 1 < crossings.size(); crossing += 2)
+				{
+					const int x0 = std::max(circleX0, (int)std::ceil(crossings[crossing] - 0.5f));
+					const int x1 = std::min(circleX1, (int)std::ceil(crossings[crossing + 1] - 0.5f));
+
+					for (int x = x0; x < x1; x++)
+					{
+						const float dx = ((float)x + 0.5f - job.centerX) * job.inverseRadius;
+						// Fades out as smoothly as (1 - d)^2 without needing a square root
+						const float falloff = 1.0f - (dx * dx + dy * dy);
+						if (falloff <= 0) { continue; }
+
+						const float strength = falloff * falloff;
+						row[x * 3 + 0] += light.r * strength;
+						row[x * 3 + 1] += light.g * strength;
+						row[x * 3 + 2] += light.b * strength;
+					}
+				}
+			}
+		}
+
+		uint32_t* pixels = m_Image->pixels.data() + (size_t)y0 * (size_t)width;
+		for (int cell = 0; cell < (y1 - y0) * width; cell++)
+		{
+			pixels[cell] = 0xFF000000u |
+				(ToChannel(m_Ambient[0] + accumulated[cell * 3 + 0]) << 16) |
+				(ToChannel(m_Ambient[1] + accumulated[cell * 3 + 1]) << 8) |
+				ToChannel(m_Ambient[2] + accumulated[cell * 3 + 2]);
+		}
+	}
+}
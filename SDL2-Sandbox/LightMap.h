@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "Camera.h"
+#include "Vector.h"
+#include "WorkerPool.h"
+
+namespace Funny
+{
+	/*
+	* A point light as the light map sees it. Color
+	* is already multiplied by the light's intensity,
+	* so 1 means the channel is fully lit. Static
+	* lights are told apart between frames by their
+	* ID, which only has to be unique among them.
+	*/
+	struct LightSource
+	{
+		Vector2 position;
+		float radius = 0;
+		float r = 1, g = 1, b = 1;
+		bool isStatic = false;
+		uint32_t id = 0;
+	};
+
+	/*
+	* The tiles that light can't get through, read
+	* straight out of a tilemap's dense collision
+	* rows. Only BLOCK tiles cast shadows. Anything
+	* outside the grid lets light through.
+	*/
+	struct LightOccluders
+	{
+		const uint8_t* collision = nullptr;	// TileCollisionType per tile, row by row
+		int columns = 0;
+		int rows = 0;
+		float originX = 0;
+		float originY = 0;
+		float tileWidth = 0;
+		float tileHeight = 0;
+		uint32_t version = 0;				// Has to change whenever the collision does
+	};
+
+	/*
+	* One ARGB8888 pixel per light map cell, covering
+	* the camera's viewport from its top left corner.
+	* Cells are cellSize screen pixels on each side,
+	* so the last row and column can hang off the
+	* edge of the viewport a bit.
+	*/
+	struct LightMapImage
+	{
+		std::vector<uint32_t> pixels;
+		int width = 0;
+		int height = 0;
+		int cellSize = 0;
+	};
+
+	struct LightMapStats
+	{
+		int lights = 0;			// Everything we were handed
+		int drawnLights = 0;	// Lights that reach the camera
+		int builtPolygons = 0;	// Visibility polygons worked out this frame
+		int cachedPolygons = 0;	// Static lights that reused last frame's polygon
+		int polygonPoints = 0;
+		int width = 0;
+		int height = 0;
+		int threads = 0;
+	};
+
+	/*
+	* Works out how much light reaches each part of
+	* the screen, at a fraction of the resolution, to
+	* be multiplied over the finished frame.
+	*
+	* Every light first gets a visibility polygon: rays
+	* are cast from the light towards each corner of
+	* the BLOCK tile edges that face it (plus a hair to
+	* either side, to slip past the corner) and the
+	* closest hits, sorted by angle, outline everything
+	* the light can see. Runs of tile edges are merged
+	* first, so a wall costs one segment rather than
+	* one per tile. Static lights keep their polygon
+	* in world space until they move or the collision
+	* changes, everything else is rebuilt every frame.
+	* Polygons for different lights get built on the
+	* worker threads at the same time.
+	*
+	* Then the light map is split into bands of rows,
+	* and each band fills in every polygon that crosses
+	* it, adding up each light's color with a falloff
+	* that reaches zero at its radius. Bands never share
+	* a cell, so they get drawn in parallel too.
+	*/
+	class LightMap
+	{
+	public:
+		static const int BAND_ROWS = 8;
+
+		// 0 threads uses one per hardware thread, counting the caller
+		LightMap(int threads = 0) : m_Pool(threads) {}
+
+		void SetCellSize(int pixels) { m_CellSize = (pixels > 0) ? pixels : 1; }
+		int GetCellSize() const { return m_CellSize; }
+
+		// The light everything gets even with no lights nearby
+		void SetAmbient(float r, float g, float b);
+
+		void Build(const Camera& camera, const LightOccluders& occluders, const std::vector<LightSource>& lights, LightMapImage& image);
+		void ClearCache() { m_StaticPolygons.clear(); }
+
+		int GetThreadCount() const { return m_Pool.GetThreadCount(); }
+		const LightMapStats& GetStats() const { return m_Stats; }
+
+		/*
+		* The world space outline of what a light can
+		* see, or nothing when the light is stuck inside
+		* a BLOCK tile. Exposed for debug drawing.
+		*/
+		static void BuildVisibility(const LightSource& light, const LightOccluders& occluders, std::vector<Vector2>& points);
+
+	private:
+		struct Visibility
+		{
+			std::vector<Vector2> points;
+			Vector2 position;
+			float radius = 0;
+			const uint8_t* collision = nullptr;
+			uint32_t version = 0;
+			uint64_t lastUsed = 0;
+		};
+
+		/*
+		* A light that made it past culling, with its
+		* polygon moved into light map cells. Jobs are
+		* kept between frames so their vectors don't get
+		* reallocated every time.
+		*/
+		struct LightJob
+		{
+			const LightSource* light;
+			Visibility* visibility;	// Either the static cache entry or local below
+			Visibility local;
+			bool rebuild;
+
+			std::vector<Vector2> cells;
+			float centerX, centerY;
+			float inverseRadius;	// In cells
+			int row0, row1;			// Rows the polygon covers, row1 exclusive
+		};
+
+		void DrawBand(int band);
+
+		std::unordered_map<uint32_t, Visibility> m_StaticPolygons;
+		uint64_t m_Frame = 0;
+
+		std::vector<LightJob> m_Jobs;
+		std::vector<LightJob*> m_Rebuilds;
+		int m_JobCount = 0;
+
+		std::vector<float> m_Accumulated; // RGB per cell
+		LightMapImage* m_Image = nullptr;
+
+		int m_CellSize = 4;
+		float m_Ambient[3] = { 0.2f, 0.2f, 0.25f };
+
+		WorkerPool m_Pool;
+		LightMapStats m_Stats;
+	};
+}
@@ -0,0 +1,268 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+namespace Funny
+{
+	void RollingHistory::push(float value)
+	{
+		m_Samples[m_Next] = value;
+		m_Next = (m_Next + 1) % CAPACITY;
+		m_Count = std::min(m_Count + 1, CAPACITY);
+	}
+
+	/*
+	* Sorting a copy of a couple hundred floats
+	* is cheap enough to do whenever the overlay
+	* asks for it, and keeps push() trivial.
+	*/
+	float RollingHistory::percentile(float percent) const
+	{
+		if (m_Count == 0) { return 0; }
+
+		float sorted[CAPACITY];
+		std::copy(m_Samples, m_Samples + m_Count, sorted);
+
+		int index = (int)((percent / 100.0f) * (float)(m_Count - 1) + 0.5f);
+		std::nth_element(sorted, sorted + index, sorted + m_Count);
+		return sorted[index];
+	}
+
+	float RollingHistory::average() const
+	{
+		if (m_Count == 0) { return 0; }
+
+		float sum = 0;
+		for (int i = 0; i < m_Count; i++)
+		{
+			sum += m_Samples[i];
+		}
+
+		return sum / (float)m_Count;
+	}
+
+	float RollingHistory::latest() const
+	{
+		if (m_Count == 0) { return 0; }
+		return m_Samples[(m_Next + CAPACITY - 1) % CAPACITY];
+	}
+
+	float RollingHistory::max() const
+	{
+		if (m_Count == 0) { return 0; }
+		return *std::max_element(m_Samples, m_Samples + m_Count);
+	}
+
+	std::mutex Profiler::m_Mutex;
+	RollingHistory Profiler::m_FrameHistory;
+	std::vector<std::pair<const char*, RollingHistory>> Profiler::m_ScopeHistories;
+	std::vector<TraceEvent> Profiler::m_TraceEvents;
+	bool Profiler::m_Capturing = false;
+	int64_t Profiler::m_FrameStart = 0;
+	std::vector<std::pair<const char*, int64_t>> Profiler::m_StartupMarks;
+
+	int64_t Profiler::nowMicros()
+	{
+		static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+
+	/*
+	* Frame times are measured start to start so
+	* they include any time spent waiting between
+	* frames, matching what the FPS counter shows.
+	* The "Frame" scope recorded in endFrame is
+	* only the time spent actually working.
+	*/
+	void Profiler::beginFrame()
+	{
+		int64_t now = nowMicros();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_FrameStart != 0)
+		{
+			m_FrameHistory.push((float)(now - m_FrameStart) / 1000.0f);
+		}
+		m_FrameStart = now;
+	}
+
+	void Profiler::endFrame()
+	{
+		recordScope("Frame", m_FrameStart, nowMicros());
+	}
+
+	void Profiler::recordScope(const char* name, int64_t startMicros, int64_t endMicros)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		float durationMs = (float)(endMicros - startMicros) / 1000.0f;
+
+		auto history = std::find_if(m_ScopeHistories.begin(), m_ScopeHistories.end(),
+			[name](const std::pair<const char*, RollingHistory>& entry) { return entry.first == name; });
+
+		if (history == m_ScopeHistories.end())
+		{
+			m_ScopeHistories.push_back({ name, RollingHistory() });
+			history = m_ScopeHistories.end() - 1;
+		}
+
+		history->second.push(durationMs);
+
+		if (m_Capturing && m_TraceEvents.size() < MAX_TRACE_EVENTS)
+		{
+			m_TraceEvents.push_back({ name, getThreadID(), startMicros, endMicros - startMicros });
+		}
+	}
+
+	RollingHistory Profiler::getFrameHistory()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_FrameHistory;
+	}
+
+	std::vector<std::pair<const char*, RollingHistory>> Profiler::getScopeHistories()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_ScopeHistories;
+	}
+
+	float Profiler::getAverageFPS()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		float averageMs = m_FrameHistory.average();
+		if (averageMs <= 0) { return 0; }
+
+		return 1000.0f / averageMs;
+	}
+
+	void Profiler::startCapture()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_TraceEvents.clear();
+		m_Capturing = true;
+	}
+
+	void Profiler::stopCapture()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Capturing = false;
+	}
+
+	size_t Profiler::getCapturedEventCount()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_TraceEvents.size();
+	}
+
+	/*
+	* Writes our captured events as "complete"
+	* events (ph X) which carry both a start
+	* and a duration, so we don't have to pair
+	* up begin and end events ourselves.
+	*/
+	bool Profiler::exportChromeTrace(std::string filepath)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		std::ofstream file(filepath, std::ios::out | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "Unable to open trace file at path " << filepath << std::endl;
+			return false;
+		}
+
+		file << "{\"traceEvents\":[\n";
+		for (size_t i = 0; i < m_TraceEvents.size(); i++)
+		{
+			const TraceEvent& traceEvent = m_TraceEvents[i];
+
+			file << "{\"name\":\"";
+			for (const char* c = traceEvent.name; *c != '\0'; c++)
+			{
+				if (*c == '"' || *c == '\\') { file << '\\'; }
+				file << *c;
+			}
+			file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << traceEvent.threadID
+				<< ",\"ts\":" << traceEvent.startMicros
+				<< ",\"dur\":" << traceEvent.durationMicros << "}";
+
+			file << ((i + 1 < m_TraceEvents.size()) ? ",\n" : "\n");
+		}
+		file << "],\"displayTimeUnit\":\"ms\"}\n";
+
+		std::cout << "Exported " << m_TraceEvents.size() << " trace events to [" << filepath << "]" << std::endl;
+		return true;
+	}
+
+	void Profiler::markStartup(const char* phase)
+	{
+		int64_t now = nowMicros();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_StartupMarks.push_back({ phase, now });
+	}
+
+	float Profiler::getStartupMs()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (m_StartupMarks.empty()) { return 0; }
+		return (float)m_StartupMarks.back().second / 1000.0f;
+	}
+
+	/*
+	* Our clock starts the first time anything asks
+	* for the time, so main should put down a mark
+	* as early as it can for this to be accurate.
+	*/
+	bool Profiler::reportStartup(float budgetMs)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		std::cout << "Startup timeline:" << std::endl;
+
+		int64_t previous = 0;
+		for (auto const& mark : m_StartupMarks)
+		{
+			std::cout << "  " << (float)mark.second / 1000.0f << " ms  (+" << (float)(mark.second - previous) / 1000.0f << " ms)  " << mark.first << std::endl;
+			previous = mark.second;
+		}
+
+		float totalMs = m_StartupMarks.empty() ? 0 : (float)m_StartupMarks.back().second / 1000.0f;
+		bool withinBudget = (budgetMs <= 0) || (totalMs <= budgetMs);
+
+		std::cout << "Time to first frame: " << totalMs << " ms";
+		if (budgetMs > 0)
+		{
+			std::cout << " (budget " << budgetMs << " ms" << (withinBudget ? ")" : ", OVER BUDGET)");
+		}
+		std::cout << std::endl;
+
+		return withinBudget;
+	}
+
+	/*
+	* std::thread::id isn't something we can
+	* print as a number portably, so hand out
+	* small sequential IDs per thread instead.
+	*/
+	uint32_t Profiler::getThreadID()
+	{
+		static std::vector<std::thread::id> threads;
+
+		std::thread::id current = std::this_thread::get_id();
+		auto found = std::find(threads.begin(), threads.end(), current);
+		if (found != threads.end())
+		{
+			return (uint32_t)(found - threads.begin());
+		}
+
+		threads.push_back(current);
+		return (uint32_t)(threads.size() - 1);
+	}
+}
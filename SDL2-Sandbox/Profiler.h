@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "Common.h"
+
+namespace Funny
+{
+	/*
+	* A fixed size ring of timing samples in
+	* milliseconds. Old samples get overwritten
+	* once the ring is full, so percentiles
+	* always describe the last few seconds
+	* instead of the whole session like our
+	* old FPS counter did.
+	*/
+	class RollingHistory
+	{
+	public:
+		static const int CAPACITY = 240;
+
+		void push(float value);
+
+		float percentile(float percent) const;
+		float average() const;
+		float latest() const;
+		float max() const;
+
+		int count() const { return m_Count; }
+		int offset() const { return m_Next; } // Index of the oldest sample once the ring is full, used for plotting
+		const float* data() const { return m_Samples; }
+
+	private:
+		float m_Samples[CAPACITY] = {};
+		int m_Next = 0;
+		int m_Count = 0;
+	};
+
+	/*
+	* A single completed timing scope, kept
+	* around while a trace capture is running
+	* so it can be written out as a Chrome
+	* trace event later on.
+	*/
+	struct TraceEvent
+	{
+		const char* name;
+		uint32_t threadID;
+		int64_t startMicros;
+		int64_t durationMicros;
+	};
+
+	/*
+	* Collects CPU timings for whatever we
+	* wrap in a ProfileScope, alongside full
+	* frame times fed in by the Engine.
+	*
+	* Scope names are expected to be string
+	* literals (or something else that lives
+	* for the whole program, like our system
+	* type names) since we key our histories
+	* by the pointer rather than hashing the
+	* string every time a scope closes.
+	*
+	* Everything here is static like our
+	* ResourceManager, and recording is
+	* guarded by a mutex so timers can be
+	* dropped into worker threads too.
+	*/
+	class Profiler
+	{
+	public:
+		static void beginFrame();
+		static void endFrame();
+
+		static void recordScope(const char* name, int64_t startMicros, int64_t endMicros);
+		static int64_t nowMicros();
+
+		// These hand back copies so the overlay never reads
+		// a history while another thread is pushing into it
+		static RollingHistory getFrameHistory();
+		static std::vector<std::pair<const char*, RollingHistory>> getScopeHistories();
+		static float getAverageFPS();
+
+		/*
+		* Trace captures record every scope between
+		* a start and a stop, which can then be saved
+		* in the Chrome trace event format and opened
+		* in chrome://tracing or Perfetto.
+		*/
+		static void startCapture();
+		static void stopCapture();
+		static bool isCapturing() { return m_Capturing; }
+		static size_t getCapturedEventCount();
+		static bool exportChromeTrace(std::string filepath);
+
+		/*
+		* A coarse timeline of engine startup. Each
+		* mark records how long after launch a phase
+		* finished, and the report prints them all out
+		* alongside the time it took to get our first
+		* frame on screen, warning if that went over
+		* the given budget.
+		*/
+		static void markStartup(const char* phase);
+		static bool reportStartup(float budgetMs);
+		static float getStartupMs();
+
+	private:
+		static const size_t MAX_TRACE_EVENTS = 1000000;
+
+		static std::vector<std::pair<const char*, int64_t>> m_StartupMarks;
+
+		static std::mutex m_Mutex;
+		static RollingHistory m_FrameHistory;
+		static std::vector<std::pair<const char*, RollingHistory>> m_ScopeHistories; // Few enough scopes that a linear search beats a hash map
+		static std::vector<TraceEvent> m_TraceEvents;
+		static bool m_Capturing;
+		static int64_t m_FrameStart;
+
+		static uint32_t getThreadID();
+	};
+
+	/*
+	* Times whatever happens between its
+	* construction and destruction, handing
+	* the result over to the Profiler.
+	*/
+	class ProfileScope
+	{
+	public:
+		ProfileScope(const char* name) : m_Name(name), m_Start(Profiler::nowMicros()) {}
+		~ProfileScope() { Profiler::recordScope(m_Name, m_Start, Profiler::nowMicros()); }
+
+	private:
+		const char* m_Name;
+		int64_t m_Start;
+	};
+}
+
+#define FUNNY_PROFILE_CONCAT_INNER(a, b) a##b
+#define FUNNY_PROFILE_CONCAT(a, b) FUNNY_PROFILE_CONCAT_INNER(a, b)
+#define FUNNY_PROFILE_SCOPE(name) Funny::ProfileScope FUNNY_PROFILE_CONCAT(profileScope, __LINE__)(name)
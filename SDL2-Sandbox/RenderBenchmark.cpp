@@ -0,0 +1,368 @@
+#include "RenderBenchmark.h"
+#include "Engine.h"
+#include "RenderSystem.h"
+#include "ResourceManager.h"
+#include "ImageHash.h"
+#include "TextRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace Funny
+{
+	std::vector<RenderBenchmark::ScriptedSprite> RenderBenchmark::m_Sprites;
+	std::vector<uint32_t> RenderBenchmark::m_TextIDs;
+	bool RenderBenchmark::m_PanCamera = false;
+
+	bool RenderBenchmark::isScene(const std::string& name)
+	{
+		return name == "sprites" || name == "tilemap" || name == "mixed" || name == "text" || name == "lights";
+	}
+
+	/*
+	* Sprites get placed with a tiny LCG rather than
+	* rand() so every platform scatters them the same
+	* way, otherwise golden hashes wouldn't carry over.
+	*/
+	bool RenderBenchmark::setupScene(const RenderBenchmarkSettings& settings)
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+		std::shared_ptr<RenderSystem> renderSystem = coordinator->GetSystem<RenderSystem>();
+
+		m_Sprites.clear();
+		m_TextIDs.clear();
+		m_PanCamera = false;
+
+		if (settings.scene == "tilemap" || settings.scene == "mixed" || settings.scene == "lights")
+		{
+			// Every tile filled, cycling through the whole sheet
+			TilemapLayout layout;
+			int sheetTiles = layout.sheetColumns * layout.sheetRows;
+			for (int i = 0; i < layout.columns * layout.rows; i++)
+			{
+				layout.tiles.push_back(i % sheetTiles);
+			}
+
+			Engine::test = new Tilemap();
+			Engine::test->loadMap(layout);
+			m_PanCamera = true;
+		}
+
+		if (settings.scene == "lights")
+		{
+			setupLights();
+		}
+
+		bool text = (settings.scene == "text");
+		if (text && !TextRenderer::loadFont("Bench", settings.fontPath, 16.0f))
+		{
+			std::cout << "The text scene needs a font, pass one with --bench-font." << std::endl;
+			return false;
+		}
+
+		if (settings.scene == "sprites" || settings.scene == "mixed" || text)
+		{
+			const char* textures[] = { "Square", "Circle", "Triangle" };
+			const Camera& camera = renderSystem->GetCamera();
+
+			// Leave a slot free for anything else that wants an entity
+			int count = std::min(settings.sprites, (int)MAX_ENTITIES - 1);
+			if (count < settings.sprites)
+			{
+				std::cout << "Only " << count << " sprites fit in MAX_ENTITIES." << std::endl;
+			}
+
+			uint32_t seed = 12345;
+			auto next = [&seed](float range)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				return (float)(seed >> 8) / (float)(1u << 24) * range;
+			};
+
+			for (int i = 0; i < count; i++)
+			{
+				Entity entity = coordinator->CreateEntity();
+
+				Transform transform;
+				float size = 16.0f + next(32.0f);
+				transform.position = Vector2(0, 0);
+				transform.scale = Vector2(size, size);
+
+				Renderable renderable;
+				ResourceManager::applyTexture(renderable, textures[i % 3]);
+				// One draw per line, argument evaluation order isn't fixed
+				uint32 red = 128 + (uint32)next(127.0f);
+				uint32 green = 128 + (uint32)next(127.0f);
+				uint32 blue = 128 + (uint32)next(127.0f);
+				renderable.color = ColorRGBA(red, green, blue, 255);
+				renderable.drawToScreen = false;
+				renderable.layer = (uint8_t)(i % 4);
+				renderable.depth = (float)i;
+
+				coordinator->AddComponent<Transform>(entity, transform);
+				if (text)
+				{
+					Text label;
+					label.textID = TextRenderer::createText("Bench", "Entity " + std::to_string(i));
+					label.color = renderable.color;
+					coordinator->AddComponent<Text>(entity, label);
+					m_TextIDs.push_back(label.textID);
+				}
+				else
+				{
+					coordinator->AddComponent<Renderable>(entity, renderable);
+				}
+
+				ScriptedSprite sprite;
+				sprite.entity = entity;
+				sprite.center.x = next((float)camera.viewport.w);
+				sprite.center.y = next((float)camera.viewport.h);
+				sprite.radius = 8.0f + next(64.0f);
+				sprite.phase = next(6.2831853f);
+				sprite.speed = 0.01f + next(0.05f);
+				m_Sprites.push_back(sprite);
+			}
+		}
+
+		animateScene(0);
+		return true;
+	}
+
+	/*
+	* Turns every third column of the test tilemap
+	* into pillars (with a gap through the middle
+	* row) and scatters LIGHT_COUNT lights over the
+	* screen, half static and half orbiting like the
+	* sprites do.
+	*/
+	void RenderBenchmark::setupLights()
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+		const Camera& camera = coordinator->GetSystem<RenderSystem>()->GetCamera();
+
+		Tilemap* tilemap = Engine::test;
+		TilemapGridData grid = tilemap->GetGridData();
+		for (int y = 0; y < grid.yBounds; y++)
+		{
+			for (int x = 1; x < grid.xBounds; x += 3)
+			{
+				if (y == grid.yBounds / 2) { continue; }
+				tilemap->AddTile(Vector2((float)x, (float)y), tilemap->GetDenseRow(y)[x], BLOCK);
+			}
+		}
+
+		uint32_t seed = 54321;
+		auto next = [&seed](float range)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (float)(seed >> 8) / (float)(1u << 24) * range;
+		};
+
+		for (int i = 0; i < LIGHT_COUNT; i++)
+		{
+			Entity entity = coordinator->CreateEntity();
+
+			Transform transform;
+			float x = next((float)camera.viewport.w);
+			float y = next((float)camera.viewport.h);
+			transform.position = Vector2(x, y);
+
+			Light light;
+			uint32 red = 128 + (uint32)next(127.0f);
+			uint32 green = 128 + (uint32)next(127.0f);
+			uint32 blue = 128 + (uint32)next(127.0f);
+			light.color = ColorRGBA(red, green, blue, 255);
+			light.radius = 100.0f + next(200.0f);
+			light.intensity = 0.6f;
+			light.isStatic = (i % 2 == 0);
+
+			coordinator->AddComponent<Transform>(entity, transform);
+			coordinator->AddComponent<Light>(entity, light);
+
+			if (!light.isStatic)
+			{
+				ScriptedSprite sprite;
+				sprite.entity = entity;
+				sprite.center = transform.position;
+				sprite.radius = 16.0f + next(64.0f);
+				sprite.phase = next(6.2831853f);
+				sprite.speed = 0.01f + next(0.05f);
+				m_Sprites.push_back(sprite);
+			}
+		}
+	}
+
+	void RenderBenchmark::animateScene(int frame)
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+
+		for (const ScriptedSprite& sprite : m_Sprites)
+		{
+			float angle = sprite.phase + sprite.speed * (float)frame;
+
+			Transform& transform = coordinator->GetComponent<Transform>(sprite.entity);
+			transform.position = Vector2(sprite.center.x + std::cos(angle) * sprite.radius, sprite.center.y + std::sin(angle) * sprite.radius);
+		}
+
+		// Like damage numbers ticking, a handful of labels change every frame
+		for (size_t i = (size_t)frame % 50; i < m_TextIDs.size(); i += 50)
+		{
+			TextRenderer::setText(m_TextIDs[i], std::to_string(frame * 7 + (int)i));
+		}
+
+		if (m_PanCamera)
+		{
+			Camera& camera = coordinator->GetSystem<RenderSystem>()->GetCamera();
+			camera.position = Vector2(std::sin((float)frame * 0.02f) * 100.0f, std::cos((float)frame * 0.015f) * 50.0f);
+		}
+	}
+
+	/*
+	* Compares against the hash stored in the given
+	* file, or records this one if there isn't a file
+	* there yet so the first run becomes the golden.
+	*/
+	bool RenderBenchmark::checkGolden(const std::string& filepath, uint64_t hash)
+	{
+		std::ifstream golden(filepath);
+		if (!golden.is_open())
+		{
+			std::ofstream record(filepath, std::ios::out | std::ios::trunc);
+			if (!record.is_open())
+			{
+				std::cout << "Unable to write golden hash to path " << filepath << std::endl;
+				return false;
+			}
+
+			record << ImageHash::toString(hash) << std::endl;
+			std::cout << "Recorded golden frame hash " << ImageHash::toString(hash) << " to [" << filepath << "]" << std::endl;
+			return true;
+		}
+
+		std::string text;
+		golden >> text;
+
+		uint64_t expected = 0;
+		if (!ImageHash::fromString(text, expected))
+		{
+			std::cout << "Golden hash file " << filepath << " doesn't hold a valid hash." << std::endl;
+			return false;
+		}
+
+		if (expected != hash)
+		{
+			std::cout << "Golden frame mismatch: expected " << ImageHash::toString(expected) << ", got " << ImageHash::toString(hash) << std::endl;
+			return false;
+		}
+
+		std::cout << "Golden frame matches " << ImageHash::toString(hash) << std::endl;
+		return true;
+	}
+
+	int RenderBenchmark::run(Engine* engine, const RenderBenchmarkSettings& settings)
+	{
+		if (Engine::isHeadless())
+		{
+			std::cout << "Render benchmarks need a renderer, they can't run headless." << std::endl;
+			return 1;
+		}
+
+		if (!isScene(settings.scene))
+		{
+			std::cout << "Unknown render benchmark scene " << settings.scene << std::endl;
+			return 1;
+		}
+
+		if (!setupScene(settings))
+		{
+			return 1;
+		}
+
+		std::shared_ptr<RenderSystem> renderSystem = Engine::getCoordinator()->GetSystem<RenderSystem>();
+
+		std::vector<float> frameTimes;
+		frameTimes.reserve(settings.frames > 0 ? settings.frames : 0);
+
+		int totalFrames = settings.warmupFrames + settings.frames;
+		for (int frame = 0; frame < totalFrames; frame++)
+		{
+			animateScene(frame);
+
+			int64_t start = Profiler::nowMicros();
+			if (!engine->gameLoop())
+			{
+				break;
+			}
+			int64_t end = Profiler::nowMicros();
+
+			if (frame >= settings.warmupFrames)
+			{
+				frameTimes.push_back((float)(end - start) / 1000.0f);
+			}
+		}
+
+		// Frames can still be in flight on the render thread, reading
+		// the frame back waits for them so the hash is of the last one
+		uint64_t hash = 0;
+		bool hashed = renderSystem->HashFrame(hash);
+
+		if (frameTimes.empty())
+		{
+			std::cout << "No frames were timed." << std::endl;
+			return 1;
+		}
+
+		float total = 0;
+		for (float frameTime : frameTimes)
+		{
+			total += frameTime;
+		}
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+		auto percentile = [&frameTimes](float percent)
+		{
+			size_t index = (size_t)((percent / 100.0f) * (float)(frameTimes.size() - 1) + 0.5f);
+			return frameTimes[index];
+		};
+
+		std::cout << "{\"scene\":\"" << settings.scene << "\""
+			<< ",\"frames\":" << frameTimes.size()
+			<< ",\"sprites\":" << m_Sprites.size()
+			<< ",\"threaded\":" << (renderSystem->IsRenderThreaded() ? "true" : "false")
+			<< ",\"rasterizer\":\"" << (renderSystem->IsSoftwareRaster() ? "tiled" : "sdl") << "\""
+			<< ",\"mean_ms\":" << total / (float)frameTimes.size()
+			<< ",\"p50_ms\":" << percentile(50)
+			<< ",\"p95_ms\":" << percentile(95)
+			<< ",\"p99_ms\":" << percentile(99)
+			<< ",\"max_ms\":" << frameTimes.back()
+			<< ",\"hash\":\"" << (hashed ? ImageHash::toString(hash) : "") << "\"}" << std::endl;
+
+		// Redraws the final frame, so this goes after it's been hashed and before it's saved
+		RasterComparison comparison;
+		if (settings.compareRaster && renderSystem->CompareRaster(comparison))
+		{
+			std::cout << "{\"scene\":\"" << settings.scene << "\""
+				<< ",\"raster\":\"" << ImageHash::toString(comparison.rasterHash) << "\""
+				<< ",\"sdl\":\"" << ImageHash::toString(comparison.sdlHash) << "\""
+				<< ",\"match\":" << (comparison.rasterHash == comparison.sdlHash ? "true" : "false")
+				<< ",\"different_pixels\":" << comparison.differentPixels
+				<< ",\"max_difference\":" << comparison.maxDifference << "}" << std::endl;
+		}
+
+		if (!settings.capturePath.empty())
+		{
+			renderSystem->SaveFrame(settings.capturePath);
+		}
+
+		if (!settings.goldenPath.empty())
+		{
+			if (!hashed || !checkGolden(settings.goldenPath, hash))
+			{
+				return 3;
+			}
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Common.h"
+#include "Types.h"
+
+namespace Funny
+{
+	class Engine;
+
+	struct RenderBenchmarkSettings
+	{
+		std::string scene = "sprites";
+		int frames = 300;
+		int warmupFrames = 10;		// Left out of the timings, the first few frames fill caches and upload things
+		int sprites = 900;
+		std::string fontPath;		// TTF for the text scene
+		std::string goldenPath;		// Final frame's hash gets checked against this file, or written to it if it doesn't exist yet
+		std::string capturePath;	// Final frame gets saved here as a BMP
+		bool compareRaster = false;	// Final frame gets drawn again by SDL's software renderer and compared
+	};
+
+	/*
+	* Plays a scripted scene for a fixed number of
+	* frames and reports how long they took, then
+	* hashes the last one so it can be compared
+	* against a golden hash from a known good run.
+	* 
+	* Everything in a scene moves as a function of
+	* the frame number alone, so as long as the
+	* engine renders offscreen (where SDL's software
+	* renderer draws the same pixels every time) the
+	* final frame is reproducible run to run. Sprites
+	* are drawn by our own rasterizer there unless
+	* told otherwise, which compareRaster checks
+	* against SDL's software renderer.
+	* 
+	* Scenes:
+	*   sprites  Lots of primitives orbiting around, spread over a few layers
+	*   tilemap  The test tilemap with the camera panning across it
+	*   mixed    Both at once
+	*   text     Floating labels, a few of which change every frame (needs a font)
+	*   lights   The tilemap with pillars casting shadows from 64 lights, half of them moving
+	*/
+	class RenderBenchmark
+	{
+	public:
+		static bool isScene(const std::string& name);
+
+		// Expects the engine to already be initialized, hands back an exit code for main
+		static int run(Engine* engine, const RenderBenchmarkSettings& settings);
+
+	private:
+		struct ScriptedSprite
+		{
+			Entity entity;
+			Vector2 center;
+			float radius;
+			float phase;
+			float speed;
+		};
+
+		static std::vector<ScriptedSprite> m_Sprites;
+		static std::vector<uint32_t> m_TextIDs;
+		static bool m_PanCamera;
+
+		static const int LIGHT_COUNT = 64;
+
+		static bool setupScene(const RenderBenchmarkSettings& settings);
+		static void setupLights();
+		static void animateScene(int frame);
+		static bool checkGolden(const std::string& filepath, uint64_t hash);
+	};
+}
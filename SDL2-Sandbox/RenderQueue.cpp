@@ -0,0 +1,99 @@
+#include "RenderQueue.h"
+#include "Profiler.h"
+
+namespace Funny
+{
+	void RenderQueue::Submit()
+	{
+		FUNNY_PROFILE_SCOPE("WaitForRenderThread");
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		m_SubmittedFrame = m_NextFrame;
+		m_Condition.notify_all();
+
+		m_Condition.wait(lock, [this] { return m_Stopping || m_CompletedFrame + 1 >= m_NextFrame; });
+		m_NextFrame++;
+	}
+
+	/*
+	* Blocks until there's a frame to draw, running
+	* any tasks posted in the meantime. Returns
+	* nullptr once we've been told to stop and every
+	* submitted frame and task is done.
+	*/
+	RenderFrame* RenderQueue::WaitForFrame()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (true)
+		{
+			m_Condition.wait(lock, [this] { return m_Stopping || m_SubmittedFrame > m_CompletedFrame || !m_Tasks.empty(); });
+			if (m_Tasks.empty()) { break; }
+
+			// Tasks can take a while, so they run without holding up anyone posting more
+			std::vector<std::function<void()>> tasks;
+			tasks.swap(m_Tasks);
+			lock.unlock();
+
+			for (std::function<void()>& task : tasks)
+			{
+				task();
+			}
+
+			lock.lock();
+			m_FinishedTasks += tasks.size();
+			m_Condition.notify_all();
+		}
+
+		if (m_SubmittedFrame == m_CompletedFrame)
+		{
+			return nullptr;
+		}
+
+		return &m_Frames[(m_CompletedFrame + 1) % 2];
+	}
+
+	void RenderQueue::FinishFrame()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_CompletedFrame++;
+		m_Condition.notify_all();
+	}
+
+	uint64_t RenderQueue::Post(std::function<void()> task)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_Tasks.push_back(std::move(task));
+		m_Condition.notify_all();
+		return ++m_PostedTasks;
+	}
+
+	void RenderQueue::WaitForTask(uint64_t ticket)
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Condition.wait(lock, [this, ticket] { return m_FinishedTasks >= ticket; });
+	}
+
+	void RenderQueue::WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Condition.wait(lock, [this] { return m_CompletedFrame == m_SubmittedFrame && m_FinishedTasks == m_PostedTasks; });
+	}
+
+	void RenderQueue::Stop()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_Stopping = true;
+		m_Condition.notify_all();
+	}
+
+	void RenderQueue::Restart()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = false;
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "Camera.h"
+#include "DebugOverlay.h"
+#include "LightMap.h"
+
+namespace Funny
+{
+	class Tilemap;
+
+	enum class RenderCommandType : uint8_t
+	{
+		CLEAR,
+		SPRITE,
+		TILEMAP_CHUNK,
+		SET_CLIP_RECT,
+		LIGHT_MAP,
+		PARTIAL_BEGIN,	// Start drawing into the persistent target, only inside clipRect
+		PARTIAL_END,	// Back to the window, with the whole target copied onto it
+		OVERLAY,
+		PRESENT
+	};
+
+	struct SpriteCommand
+	{
+		SDL_Texture* texture;
+		SDL_Rect src;
+		SDL_FRect dst;
+		SDL_Color color;
+	};
+
+	/*
+	* A chunk of a tilemap to draw from the chunk
+	* cache. Tiles is the range of tiles in the
+	* chunk that are actually on screen (x and y
+	* being the first, w and h the last), which
+	* only gets used if the cache has no room and
+	* we end up drawing them one by one.
+	*/
+	struct TilemapChunkCommand
+	{
+		const Tilemap* tilemap;
+		int chunkX;
+		int chunkY;
+		SDL_Rect src;
+		SDL_FRect dst;
+		SDL_Rect tiles;
+	};
+
+	/*
+	* Everything the render thread needs to know
+	* to draw something, copied by value so it
+	* never has to reach back into the ECS while
+	* the simulation is busy changing it.
+	*/
+	struct RenderCommand
+	{
+		RenderCommandType type;
+		union
+		{
+			SpriteCommand sprite;
+			TilemapChunkCommand chunk;
+			SDL_Rect clipRect;		// Empty rect turns clipping off, PARTIAL_BEGIN's dirty rect otherwise
+		};
+	};
+
+	static_assert(std::is_trivially_copyable<RenderCommand>::value, "Render commands have to stay plain data!");
+
+	/*
+	* One frame's worth of commands, along with the
+	* camera they were made with, the frame's light
+	* map (drawn by a LIGHT_MAP command) and a copy
+	* of the debug overlay's draw data.
+	*/
+	struct RenderFrame
+	{
+		std::vector<RenderCommand> commands;
+		Camera camera;
+		LightMapImage lightMap;
+		OverlayDrawData overlay;
+	};
+
+	/*
+	* Hands frames from the simulation thread over
+	* to the render thread using two buffers, one
+	* being filled while the other is drawn, so the
+	* simulation can get a frame ahead but no more.
+	* 
+	* Frames are numbered from 1. Submitting frame
+	* N waits for frame N - 1 to finish drawing,
+	* since that's the buffer we're about to start
+	* writing frame N + 1 into.
+	* 
+	* Anything else that has to happen on the render
+	* thread (making and destroying textures, mostly)
+	* gets posted as a task. Tasks run in the order
+	* they were posted, all of them before the render
+	* thread starts on its next frame.
+	*/
+	class RenderQueue
+	{
+	public:
+		// Producer side, only touched by the simulation thread
+		RenderFrame& GetWriteFrame() { return m_Frames[m_NextFrame % 2]; }
+		void Submit();
+
+		// Consumer side, only touched by the render thread
+		RenderFrame* WaitForFrame();
+		void FinishFrame();
+
+		// Either side, Post hands back a ticket to wait on
+		uint64_t Post(std::function<void()> task);
+		void WaitForTask(uint64_t ticket);
+
+		void WaitIdle();
+		void Stop();
+		void Restart();
+
+	private:
+		RenderFrame m_Frames[2];
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+
+		uint64_t m_NextFrame = 1;
+		uint64_t m_SubmittedFrame = 0;
+		uint64_t m_CompletedFrame = 0;
+		bool m_Stopping = false;
+
+		std::vector<std::function<void()>> m_Tasks;
+		uint64_t m_PostedTasks = 0;
+		uint64_t m_FinishedTasks = 0;
+	};
+}
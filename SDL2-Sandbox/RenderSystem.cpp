@@ -2,9 +2,28 @@
 
 #include "Engine.h"
 #include "Types.h"
+#include "Profiler.h"
+#include "ImageHash.h"
+#include "TextRenderer.h"
+#include "ResourceManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 namespace Funny
 {
+	static SDL_Color ToSDLColor(const ColorRGBA& color)
+	{
+		return SDL_Color
+		{
+			(Uint8)std::min<uint32>(color.r, 255),
+			(Uint8)std::min<uint32>(color.g, 255),
+			(Uint8)std::min<uint32>(color.b, 255),
+			(Uint8)std::min<uint32>(color.a, 255)
+		};
+	}
+
 	RenderSystem::RenderSystem()
 	{
 		
@@ -12,10 +31,102 @@ namespace Funny
 
 	RenderSystem::~RenderSystem()
 	{
+		StopRenderer();
+		m_FrameCapture.Stop();
+
+		if (m_PartialRedraw)
+		{
+			std::cout << "Partial redraw: " << m_PartialStats.redrawnFrames << " frames redrawn (" << m_PartialStats.fullFrames << " in full), "
+				<< m_PartialStats.skippedFrames << " skipped" << std::endl;
+		}
+
+		// Only still around in lockstep, where it's ours to take down
+		ReleaseRenderer();
 		m_Window.close();
 	}
 
+	/*
+	* Nothing to simulate here, we only draw
+	* once per frame from Draw below.
+	*/
 	void RenderSystem::Update()
+	{
+
+	}
+
+	/*
+	* Called by the Engine right before each
+	* simulation tick to remember where our
+	* entities started that tick.
+	*/
+	void RenderSystem::SnapshotTransforms()
+	{
+		m_HasPreviousPosition.reset();
+
+		for (auto const& entity : m_ManagedEntities)
+		{
+			m_PreviousPositions[entity] = Engine::getCoordinator()->GetComponent<Transform>(entity).position;
+			m_HasPreviousPosition.set(entity);
+		}
+	}
+
+	/*
+	* Entity IDs get reused, so a new entity starts
+	* the tick where it is rather than wherever the
+	* last one with its ID was.
+	*/
+	void RenderSystem::EntityAdded(Entity entity)
+	{
+		m_PreviousPositions[entity] = Engine::getCoordinator()->GetComponent<Transform>(entity).position;
+		m_HasPreviousPosition.set(entity);
+		m_Grid.Insert(entity, GetEntityBounds(entity));
+	}
+
+	void RenderSystem::EntityRemoved(Entity entity)
+	{
+		m_HasPreviousPosition.reset(entity);
+		m_Grid.Remove(entity);
+	}
+
+	/*
+	* Called by the Engine once the frame's ticks are
+	* done. Bounds cover both where the entity started
+	* the last tick and where it ended up so anything
+	* we'd draw partway between the two still gets
+	* picked up by the camera query.
+	*/
+	void RenderSystem::RefreshSpatialIndex()
+	{
+		FUNNY_PROFILE_SCOPE("RefreshSpatialIndex");
+
+		for (auto const& entity : m_ManagedEntities)
+		{
+			m_Grid.Update(entity, GetEntityBounds(entity));
+		}
+	}
+
+	SDL_FRect RenderSystem::GetEntityBounds(Entity entity)
+	{
+		const Transform& transform = Engine::getCoordinator()->GetComponent<Transform>(entity);
+
+		float minX = transform.position.x;
+		float minY = transform.position.y;
+		float maxX = transform.position.x;
+		float maxY = transform.position.y;
+
+		if (m_HasPreviousPosition.test(entity))
+		{
+			const Vector2& previous = m_PreviousPositions[entity];
+			minX = std::min(minX, previous.x);
+			minY = std::min(minY, previous.y);
+			maxX = std::max(maxX, previous.x);
+			maxY = std::max(maxY, previous.y);
+		}
+
+		return SDL_FRect { minX, minY, (maxX - minX) + transform.scale.x, (maxY - minY) + transform.scale.y };
+	}
+
+	void RenderSystem::Draw(float alpha)
 	{
 		/*
 		* Loop through each of our entities and get their
@@ -24,116 +135,1391 @@ namespace Funny
 		* will have a signature that contains boths IDs.
 		* 
 		* Then create source and destination rects from this
-		* data and pass it to the DrawSDLTexture function.
+		* data and turn them into sprite commands, which get
+		* batched and drawn whenever the frame is executed.
 		* 
-		* Later on, have positioning be done relative to
-		* the camera's position rather than the screen.
+		* Only entities the spatial grid says overlap
+		* the camera get drawn at all, sorted by layer,
+		* depth and texture. Tilemaps go underneath
+		* everything, then lighting gets multiplied over
+		* the lot. Text goes on top so it stays readable.
+		* 
+		* With partial redraw on, everything goes into
+		* the persistent target instead, and only what
+		* overlaps the dirty bounds gets drawn at all.
 		*/
-		for (auto const& entity : m_ManagedEntities)
+		m_Frame->camera = m_Camera;
+
+		m_Visible.clear();
+		{
+			FUNNY_PROFILE_SCOPE("CullEntities");
+			m_Grid.Query(m_Camera.GetWorldBounds(), m_Visible);
+		}
+
+		if (m_PartialRedraw)
 		{
-			DrawEntity(entity);
+			FindDirtyRegion(alpha);
+
+			RenderCommand command;
+			if (!m_HasDirty)
+			{
+				// Last frame's picture is still good, it only needs to go back on the window
+				command.type = RenderCommandType::PARTIAL_END;
+				m_Frame->commands.push_back(command);
+				return;
+			}
+
+			command.type = RenderCommandType::PARTIAL_BEGIN;
+			command.clipRect = m_DirtyRect;
+			m_Frame->commands.push_back(command);
 		}
 
+		// Anything hanging off the edge of the viewport gets
+		// cut off instead of spilling onto the rest of the window
+		PushClipRect(&m_Camera.viewport);
+
 		// Have this draw all existing tilemaps rather
-		// than just one.
-		//DrawTilemap(Engine::test);
+		// than just one. Tiles go in first so they end
+		// up underneath everything else.
+		if (Engine::test != nullptr && Engine::test->GetRenderData().texture != nullptr)
+		{
+			DrawTilemap(Engine::test);
+		}
+
+		SortVisible();
+
+		for (Entity entity : m_DrawOrder)
+		{
+			if (!m_PartialRedraw)
+			{
+				DrawEntity(entity, alpha);
+				continue;
+			}
+
+			// Already worked out when looking for what changed
+			const DrawnSprite& sprite = m_DrawnSprites[entity];
+			if (IsDirty(sprite.dst))
+			{
+				PushSprite(sprite.texture, sprite.src, sprite.dst, sprite.color);
+			}
+		}
+
+		DrawLights(alpha);
+		DrawTexts(alpha);
+
+		PushClipRect(nullptr);
+
+		if (m_PartialRedraw)
+		{
+			RenderCommand command;
+			command.type = RenderCommandType::PARTIAL_END;
+			m_Frame->commands.push_back(command);
+		}
+	}
+
+	void RenderSystem::SetPartialRedraw(bool enabled)
+	{
+		if (enabled)
+		{
+			bool supported = false;
+			RunOnRenderThread([&supported](SDL_Renderer* renderer) { supported = SDL_RenderTargetSupported(renderer); });
+			if (!supported)
+			{
+				std::cout << "Partial redraw needs render target support, which this renderer doesn't have." << std::endl;
+				return;
+			}
+		}
+
+		m_PartialRedraw = enabled;
+		m_RedrawAll = true;
 	}
 
-	void RenderSystem::DrawEntity(Entity entity)
+	/*
+	* Works out what changed since the last frame
+	* we drew. Sprites and text get compared with
+	* what we remembered drawing for them, exactly,
+	* since anything that hasn't moved works out to
+	* the very same numbers every frame.
+	* 
+	* Lights are redrawn in full whenever there are
+	* any, the light map covers the whole viewport
+	* and anything moving changes shadows far away
+	* from it.
+	*/
+	void RenderSystem::FindDirtyRegion(float alpha)
 	{
-		Transform entTrans = Engine::getCoordinator()->GetComponent<Transform>(entity);
-		Renderable entRend = Engine::getCoordinator()->GetComponent<Renderable>(entity);
+		FUNNY_PROFILE_SCOPE("FindDirtyRegion");
 
-		SDL_Rect src = entRend.sourceRect;
-		SDL_Rect dst
+		Coordinator* coordinator = Engine::getCoordinator();
+
+		bool redrawAll = m_RedrawAll || m_PartialTargetLost.exchange(false)
+			|| m_Camera.position.x != m_DrawnCamera.position.x
+			|| m_Camera.position.y != m_DrawnCamera.position.y
+			|| m_Camera.zoom != m_DrawnCamera.zoom
+			|| !SDL_RectEquals(&m_Camera.viewport, &m_DrawnCamera.viewport)
+			|| coordinator->GetComponentArray<Light>()->Size() > 0;
+
+		m_RedrawAll = false;
+		m_DrawnCamera = m_Camera;
+		m_HasDirty = false;
+
+		Tilemap* tilemap = (Engine::test != nullptr && Engine::test->GetRenderData().texture != nullptr) ? Engine::test : nullptr;
+		if (tilemap != m_DrawnTilemap)
 		{
-			dst.x = entTrans.position.x,
-			dst.y = entTrans.position.y,
-			dst.w = entTrans.scale.x,
-			dst.h = entTrans.scale.y
-		};
+			redrawAll = true;
+			m_DrawnTilemap = tilemap;
+		}
+
+		if (tilemap != nullptr)
+		{
+			FindDirtyChunks(tilemap, redrawAll);
+		}
+
+		// Sprites that dropped out of view leave a hole behind
+		for (Entity entity : m_Visible)
+		{
+			m_IsVisible.set(entity);
+		}
+
+		for (Entity entity : m_DrawnSpriteEntities)
+		{
+			if (!m_IsVisible.test(entity))
+			{
+				AddDirty(m_DrawnSprites[entity].dst);
+				m_SpriteWasDrawn.reset(entity);
+			}
+		}
+
+		m_DrawnSpriteEntities.clear();
+		for (Entity entity : m_Visible)
+		{
+			m_IsVisible.reset(entity);
+
+			DrawnSprite sprite = GetEntitySprite(entity, alpha);
+			DrawnSprite& drawn = m_DrawnSprites[entity];
+
+			if (!m_SpriteWasDrawn.test(entity))
+			{
+				AddDirty(sprite.dst);
+			}
+
+			else if (drawn.texture != sprite.texture || drawn.key != sprite.key || !SDL_RectEquals(&drawn.src, &sprite.src) ||
+				drawn.dst.x != sprite.dst.x || drawn.dst.y != sprite.dst.y || drawn.dst.w != sprite.dst.w || drawn.dst.h != sprite.dst.h ||
+				drawn.color.r != sprite.color.r || drawn.color.g != sprite.color.g || drawn.color.b != sprite.color.b || drawn.color.a != sprite.color.a)
+			{
+				AddDirty(drawn.dst);
+				AddDirty(sprite.dst);
+			}
+
+			drawn = sprite;
+			m_SpriteWasDrawn.set(entity);
+			m_DrawnSpriteEntities.push_back(entity);
+		}
+
+		// Same again for text, which isn't in the spatial grid
+		ComponentArray<Text>& texts = *coordinator->GetComponentArray<Text>();
+
+		m_DrawnTextScratch.clear();
+		for (int i = 0; i < texts.Size(); i++)
+		{
+			SDL_FRect bounds;
+			DrawnText text;
+			if (!GetTextPlacement(i, alpha, bounds, text)) { continue; }
+
+			Entity entity = texts.GetEntity(i);
+			DrawnText& drawn = m_DrawnTexts[entity];
+
+			if (!m_TextWasDrawn.test(entity))
+			{
+				AddDirty(text.dst);
+			}
+
+			else if (drawn.texture != text.texture || drawn.textID != text.textID || drawn.version != text.version ||
+				drawn.dst.x != text.dst.x || drawn.dst.y != text.dst.y || drawn.dst.w != text.dst.w || drawn.dst.h != text.dst.h ||
+				drawn.color.r != text.color.r || drawn.color.g != text.color.g || drawn.color.b != text.color.b || drawn.color.a != text.color.a)
+			{
+				AddDirty(drawn.dst);
+				AddDirty(text.dst);
+			}
+
+			drawn = text;
+			m_IsVisible.set(entity);
+			m_DrawnTextScratch.push_back(entity);
+		}
+
+		for (Entity entity : m_DrawnTextEntities)
+		{
+			if (!m_IsVisible.test(entity))
+			{
+				AddDirty(m_DrawnTexts[entity].dst);
+			}
+		}
+
+		m_TextWasDrawn.reset();
+		for (Entity entity : m_DrawnTextScratch)
+		{
+			m_IsVisible.reset(entity);
+			m_TextWasDrawn.set(entity);
+		}
+		m_DrawnTextEntities.swap(m_DrawnTextScratch);
+
+		// Round out to whole pixels, plus one for anything filtered or rounded across the edge
+		const SDL_Rect& viewport = m_Camera.viewport;
+		if (redrawAll)
+		{
+			m_DirtyRect = viewport;
+			m_HasDirty = !SDL_RectEmpty(&viewport);
+		}
 
-		SDL_SetTextureColorMod(entRend.texture, entRend.color.r, entRend.color.g, entRend.color.b);
-		SDL_SetTextureAlphaMod(entRend.texture, entRend.color.a);
+		else if (m_HasDirty)
+		{
+			int minX = (int)std::floor(m_DirtyBounds.x) - 1;
+			int minY = (int)std::floor(m_DirtyBounds.y) - 1;
+			int maxX = (int)std::ceil(m_DirtyBounds.x + m_DirtyBounds.w) + 1;
+			int maxY = (int)std::ceil(m_DirtyBounds.y + m_DirtyBounds.h) + 1;
+
+			SDL_Rect dirty { minX, minY, maxX - minX, maxY - minY };
+			m_HasDirty = SDL_IntersectRect(&dirty, &viewport, &m_DirtyRect) == SDL_TRUE;
+		}
+
+		if (m_HasDirty)
+		{
+			m_PartialStats.redrawnFrames++;
+			m_PartialStats.fullFrames += redrawAll ? 1 : 0;
 
-		DrawSDLTexture(entRend.texture, src, dst);
+			float viewportArea = (float)viewport.w * (float)viewport.h;
+			m_PartialStats.dirtyFraction = (viewportArea > 0) ? ((float)m_DirtyRect.w * (float)m_DirtyRect.h) / viewportArea : 0;
+		}
 
-		SDL_SetTextureColorMod(entRend.texture, 255, 255, 255);
-		SDL_SetTextureAlphaMod(entRend.texture, 255);
+		m_FrameIdle = !m_HasDirty;
 	}
 
 	/*
-	* Only thing left to do now is get this to only
-	* draw tiles that are in range of the camera.
-	* We can probably do that by getting the closest
-	* grid tile to the position of the camera's upper
-	* and lower bounds horizontally and vertically and
-	* only iterating across those tiles when drawing.
-	* 
-	* I can't think of a way to do this without a nested
-	* for loop, one for the rows and one for the columns,
-	* but it should be a net gain on performance when
-	* dealing with larger maps.
-	* 
-	* Another issue is making sure we don't accidentally
-	* step out of bounds of the tilegrid when attempting
-	* to access a position that isn't actually occupied
-	* by a valid space in the grid, instead having it
-	* jump to the nearest tile actually in the grid thats
-	* also in accordance with the XY position we're attempting
-	* to access a tile at (so if we attempt to access a
-	* tile with an Y world pos of 15, we should always get
-	* a tile back that shares a world pos within that 15
-	* Y pos range, no jumping to tiles lower/higher than
-	* that by accident of using the tile's index rather
-	* than nearest XY position).
+	* Chunk versions change whenever a tile in them
+	* does, whether or not chunks are being cached.
+	* Only chunks in view are compared, anything
+	* that brings others into view moves the camera
+	* and redraws everything anyway.
 	*/
-	void RenderSystem::DrawTilemap(Tilemap* tilemap)
+	void RenderSystem::FindDirtyChunks(const Tilemap* tilemap, bool redrawAll)
 	{
-		TilemapRenderData renderData = tilemap->GetRenderData();
-		TilemapGridData gridData = tilemap->GetGridData();
-		int tiles = tilemap->GetActiveTileCount();
+		const TilemapGridData gridData = tilemap->GetGridData();
+		const int chunkColumns = tilemap->GetChunkColumns();
+		const int chunkRows = tilemap->GetChunkRows();
+
+		const Vector2 origin = gridData.transform.position;
+		const float tileWidth = gridData.transform.scale.x;
+		const float tileHeight = gridData.transform.scale.y;
+		if (tileWidth <= 0 || tileHeight <= 0 || chunkColumns <= 0 || chunkRows <= 0) { return; }
+
+		if (m_DrawnChunkVersions.size() != (size_t)(chunkColumns * chunkRows))
+		{
+			m_DrawnChunkVersions.assign(chunkColumns * chunkRows, 0);
+			redrawAll = true;
+		}
+
+		SDL_FRect view = m_Camera.GetWorldBounds();
+		int minX = std::max(0, (int)std::floor((view.x - origin.x) / tileWidth) / CHUNK_TILES);
+		int minY = std::max(0, (int)std::floor((view.y - origin.y) / tileHeight) / CHUNK_TILES);
+		int maxX = std::min(chunkColumns - 1, (int)std::floor((view.x + view.w - origin.x) / tileWidth) / CHUNK_TILES);
+		int maxY = std::min(chunkRows - 1, (int)std::floor((view.y + view.h - origin.y) / tileHeight) / CHUNK_TILES);
 
-		for (int i = 0; i < tiles; i++)
+		for (int chunkY = minY; chunkY <= maxY; chunkY++)
 		{
-			int spriteID = tilemap->GetTileSprite(i).spriteID;
-			SDL_Rect src
+			for (int chunkX = minX; chunkX <= maxX; chunkX++)
 			{
-				src.x = (spriteID % renderData.xBounds),
-				src.y = ((spriteID - src.x) / renderData.xBounds),
-				src.w = renderData.tileWidth,
-				src.h = renderData.tileHeight
-			};
-			src.x *= renderData.tileWidth;
-			src.y *= renderData.tileHeight;
+				uint32_t version = tilemap->GetChunkVersion(chunkX, chunkY);
+				uint32_t& drawn = m_DrawnChunkVersions[chunkY * chunkColumns + chunkX];
+				if (drawn == version) { continue; }
+
+				drawn = version;
+				if (!redrawAll)
+				{
+					SDL_FRect world
+					{
+						origin.x + (chunkX * CHUNK_TILES * tileWidth),
+						origin.y + (chunkY * CHUNK_TILES * tileHeight),
+						CHUNK_TILES * tileWidth,
+						CHUNK_TILES * tileHeight
+					};
+					AddDirty(m_Camera.WorldToScreen(world));
+				}
+			}
+		}
+	}
+
+	void RenderSystem::AddDirty(const SDL_FRect& rect)
+	{
+		if (rect.w <= 0 || rect.h <= 0) { return; }
+
+		if (!m_HasDirty)
+		{
+			m_DirtyBounds = rect;
+			m_HasDirty = true;
+			return;
+		}
+
+		float minX = std::min(m_DirtyBounds.x, rect.x);
+		float minY = std::min(m_DirtyBounds.y, rect.y);
+		float maxX = std::max(m_DirtyBounds.x + m_DirtyBounds.w, rect.x + rect.w);
+		float maxY = std::max(m_DirtyBounds.y + m_DirtyBounds.h, rect.y + rect.h);
+		m_DirtyBounds = SDL_FRect { minX, minY, maxX - minX, maxY - minY };
+	}
+
+	bool RenderSystem::IsDirty(const SDL_FRect& rect) const
+	{
+		return rect.x < (float)(m_DirtyRect.x + m_DirtyRect.w) && rect.x + rect.w > (float)m_DirtyRect.x &&
+			rect.y < (float)(m_DirtyRect.y + m_DirtyRect.h) && rect.y + rect.h > (float)m_DirtyRect.y;
+	}
+
+	/*
+	* Lights come straight out of the compact Light
+	* array like text does. Nothing gets darkened
+	* until there's at least one light around, and
+	* only BLOCK tiles in the tilemap cast shadows.
+	*/
+	void RenderSystem::DrawLights(float alpha)
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+		ComponentArray<Light>& lights = *coordinator->GetComponentArray<Light>();
+		ComponentArray<Transform>& transforms = *coordinator->GetComponentArray<Transform>();
+
+		m_LightSources.clear();
+		for (int i = 0; i < lights.Size(); i++)
+		{
+			const Light& light = lights.Data()[i];
+			Entity entity = lights.GetEntity(i);
+
+			int transformIndex = transforms.GetIndex(entity);
+			if (transformIndex == ComponentArray<Transform>::INVALID_INDEX) { continue; }
 
-			Vector2 gridPos = tilemap->IndexToGrid(i);
-			SDL_Rect dst
+			Vector2 position = transforms.Data()[transformIndex].position;
+			if (!light.isStatic && m_HasPreviousPosition.test(entity))
 			{
-				dst.x = gridData.transform.position.x + (gridPos.x * gridData.transform.scale.x),
-				dst.y = gridData.transform.position.y + (gridPos.y * gridData.transform.scale.y),
-				dst.w = gridData.transform.scale.x,
-				dst.h = gridData.transform.scale.y
-			};
+				Vector2 previous = m_PreviousPositions[entity];
+				position.x = previous.x + (position.x - previous.x) * alpha;
+				position.y = previous.y + (position.y - previous.y) * alpha;
+			}
+
+			LightSource source;
+			source.position = Vector2(position.x + light.offset.x, position.y + light.offset.y);
+			source.radius = light.radius;
+			source.r = (float)light.color.r / 255.0f * light.intensity;
+			source.g = (float)light.color.g / 255.0f * light.intensity;
+			source.b = (float)light.color.b / 255.0f * light.intensity;
+			source.isStatic = light.isStatic;
+			source.id = (uint32_t)entity;
+			m_LightSources.push_back(source);
+		}
 
-			DrawSDLTexture(renderData.texture, src, dst);
+		if (m_LightSources.empty()) { return; }
+
+		LightOccluders occluders;
+		Tilemap* tilemap = Engine::test;
+		if (tilemap != nullptr && tilemap->GetRenderData().texture != nullptr)
+		{
+			TilemapGridData grid = tilemap->GetGridData();
+			occluders.collision = tilemap->GetCollisionRow(0);
+			occluders.columns = grid.xBounds;
+			occluders.rows = grid.yBounds;
+			occluders.originX = grid.transform.position.x;
+			occluders.originY = grid.transform.position.y;
+			occluders.tileWidth = grid.transform.scale.x;
+			occluders.tileHeight = grid.transform.scale.y;
+			occluders.version = tilemap->GetCollisionVersion();
 		}
+
+		m_LightMap.Build(m_Camera, occluders, m_LightSources, m_Frame->lightMap);
+
+		RenderCommand command;
+		command.type = RenderCommandType::LIGHT_MAP;
+		m_Frame->commands.push_back(command);
 	}
 
-	void RenderSystem::DrawSDLTexture(SDL_Texture* texture, SDL_Rect srcRect, SDL_Rect dstRect, bool drawToWorld)
+	/*
+	* Text isn't in the spatial grid, so we go
+	* straight through the compact Text array
+	* and cull each string against the camera
+	* using its cached size. Glyphs go out as
+	* ordinary sprites from the string's cached
+	* quads, only the position changes per frame.
+	*/
+	void RenderSystem::DrawTexts(float alpha)
 	{
-		if (texture == nullptr) { return; }
-		SDL_Renderer* renderTarget = m_Window.getSDLRenderer();
-		SDL_RenderCopy(renderTarget, texture, &srcRect, &dstRect);
+		FUNNY_PROFILE_SCOPE("DrawTexts");
+
+		ComponentArray<Text>& texts = *Engine::getCoordinator()->GetComponentArray<Text>();
+
+		for (int i = 0; i < texts.Size(); i++)
+		{
+			SDL_FRect bounds;
+			DrawnText drawn;
+			if (!GetTextPlacement(i, alpha, bounds, drawn)) { continue; }
+			if (m_PartialRedraw && !IsDirty(drawn.dst)) { continue; }
+
+			const Text& text = texts.Data()[i];
+			const TextLayout* layout = TextRenderer::getLayout(text.textID);
+
+			for (const GlyphQuad& glyph : layout->glyphs)
+			{
+				SDL_FRect dst { bounds.x + glyph.dst.x, bounds.y + glyph.dst.y, glyph.dst.w, glyph.dst.h };
+				PushSprite(layout->texture, glyph.src, text.drawToScreen ? dst : m_Camera.WorldToScreen(dst), drawn.color);
+			}
+		}
 	}
 
-	void RenderSystem::RenderClear()
+	/*
+	* Where the text at the given index in the Text
+	* array goes this frame, or false if it isn't
+	* drawn at all. Bounds are in whatever space the
+	* text is positioned in, the drawn copy's dst is
+	* always in screen space.
+	*/
+	bool RenderSystem::GetTextPlacement(int index, float alpha, SDL_FRect& bounds, DrawnText& drawn)
+	{
+		Coordinator* coordinator = Engine::getCoordinator();
+		ComponentArray<Text>& texts = *coordinator->GetComponentArray<Text>();
+		ComponentArray<Transform>& transforms = *coordinator->GetComponentArray<Transform>();
+
+		const Text& text = texts.Data()[index];
+		Entity entity = texts.GetEntity(index);
+
+		int transformIndex = transforms.GetIndex(entity);
+		if (transformIndex == ComponentArray<Transform>::INVALID_INDEX) { return false; }
+
+		const TextLayout* layout = TextRenderer::getLayout(text.textID);
+		if (layout == nullptr || layout->texture == nullptr || layout->glyphs.empty()) { return false; }
+
+		Vector2 position = transforms.Data()[transformIndex].position;
+		if (!text.drawToScreen && m_HasPreviousPosition.test(entity))
+		{
+			Vector2 previous = m_PreviousPositions[entity];
+			position.x = previous.x + (position.x - previous.x) * alpha;
+			position.y = previous.y + (position.y - previous.y) * alpha;
+		}
+
+		bounds = SDL_FRect { position.x + text.offset.x, position.y + text.offset.y, layout->width, layout->height };
+
+		if (text.drawToScreen)
+		{
+			const SDL_FRect screenBounds { (float)m_Camera.viewport.x, (float)m_Camera.viewport.y, (float)m_Camera.viewport.w, (float)m_Camera.viewport.h };
+			if (!SDL_HasIntersectionF(&bounds, &screenBounds)) { return false; }
+		}
+
+		else
+		{
+			const SDL_FRect worldBounds = m_Camera.GetWorldBounds();
+			if (!SDL_HasIntersectionF(&bounds, &worldBounds)) { return false; }
+		}
+
+		drawn.texture = layout->texture;
+		drawn.textID = text.textID;
+		drawn.version = layout->version;
+		drawn.dst = text.drawToScreen ? bounds : m_Camera.WorldToScreen(bounds);
+		drawn.color = ToSDLColor(text.color);
+		return true;
+	}
+
+	void RenderSystem::SortVisible()
+	{
+		for (Entity entity : m_Visible)
+		{
+			m_IsVisible.set(entity);
+		}
+
+		// Last frame's order first, skipping anything no longer visible
+		m_DrawKeys.clear();
+		auto addKey = [this](Entity entity)
+		{
+			if (!m_IsVisible.test(entity)) { return; }
+			m_IsVisible.reset(entity);
+
+			const Renderable& renderable = Engine::getCoordinator()->GetComponent<Renderable>(entity);
+			m_DrawKeys.push_back({ MakeDrawKey(renderable.layer, renderable.depth, GetTextureID(renderable.texture)), entity });
+		};
+
+		for (Entity entity : m_DrawOrder)
+		{
+			addKey(entity);
+		}
+		for (Entity entity : m_Visible)
+		{
+			addKey(entity);
+		}
+
+		m_Sorter.Sort(m_DrawKeys);
+
+		m_DrawOrder.clear();
+		for (const DrawKey& drawKey : m_DrawKeys)
+		{
+			m_DrawOrder.push_back((Entity)drawKey.index);
+		}
+	}
+
+	uint16_t RenderSystem::GetTextureID(TextureHandle texture) const
 	{
-		SDL_RenderClear(m_Window.getSDLRenderer());
+		// Past 65535 textures they just stop batching as nicely
+		return (uint16_t)std::min<TextureHandle>(texture, 0xFFFF);
 	}
 
-	void RenderSystem::RenderPresent()
+	void RenderSystem::DrawEntity(Entity entity, float alpha)
+	{
+		// The tint goes into the sprite's vertex colors, so
+		// there's no texture color/alpha mod to set and reset
+		DrawnSprite sprite = GetEntitySprite(entity, alpha);
+		PushSprite(sprite.texture, sprite.src, sprite.dst, sprite.color);
+	}
+
+	RenderSystem::DrawnSprite RenderSystem::GetEntitySprite(Entity entity, float alpha)
+	{
+		const Transform& entTrans = Engine::getCoordinator()->GetComponent<Transform>(entity);
+		const Renderable& entRend = Engine::getCoordinator()->GetComponent<Renderable>(entity);
+
+		// Blend between where the entity started the tick and where it is now
+		Vector2 position = entTrans.position;
+		if (m_HasPreviousPosition.test(entity))
+		{
+			Vector2 previous = m_PreviousPositions[entity];
+			position.x = previous.x + (entTrans.position.x - previous.x) * alpha;
+			position.y = previous.y + (entTrans.position.y - previous.y) * alpha;
+		}
+
+		DrawnSprite sprite;
+		sprite.texture = ResourceManager::useTexture(entRend.texture);
+		sprite.src = ResourceManager::isPlaceholder(sprite.texture) ? SDL_Rect { 0, 0, ResourceManager::PLACEHOLDER_SIZE, ResourceManager::PLACEHOLDER_SIZE } : entRend.sourceRect;
+		sprite.dst = m_Camera.WorldToScreen(SDL_FRect { position.x, position.y, entTrans.scale.x, entTrans.scale.y });
+		sprite.color = ToSDLColor(entRend.color);
+		sprite.key = m_PartialRedraw ? MakeDrawKey(entRend.layer, entRend.depth, GetTextureID(entRend.texture)) : 0; // Only compared by partial redraw
+		return sprite;
+	}
+
+	/*
+	* Calls emit with the source and screen rect of
+	* every tile in the given range. Shared between
+	* drawing tiles straight from the simulation and
+	* the render thread falling back to drawing them
+	* when a chunk couldn't be cached.
+	*/
+	template <typename Emit>
+	static void ForEachTile(const Tilemap* tilemap, int minX, int minY, int maxX, int maxY, const Camera& camera, Emit emit)
+	{
+		const TilemapGridData gridData = tilemap->GetGridData();
+
+		const Vector2 origin = gridData.transform.position;
+		const float tileWidth = gridData.transform.scale.x;
+		const float tileHeight = gridData.transform.scale.y;
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			const int16_t* row = tilemap->GetDenseRow(y);
+
+			for (int x = minX; x <= maxX; x++)
+			{
+				int spriteID = row[x];
+				if (spriteID == EMPTY_TILE) { continue; }
+
+				SDL_FRect world { origin.x + (x * tileWidth), origin.y + (y * tileHeight), tileWidth, tileHeight };
+				emit(tilemap->GetSourceRect(spriteID), camera.WorldToScreen(world));
+			}
+		}
+	}
+
+	/*
+	* Only draws the tiles in range of the camera.
+	* We turn the camera's world bounds into a range
+	* of rows and columns, clamped to the grid so we
+	* never step outside of it.
+	* 
+	* With chunk caching on, that range gets rounded
+	* out to whole chunks and each one becomes a chunk
+	* command, drawn from a pre-rendered texture by
+	* the render thread. Without it we walk the
+	* tilemap's dense sprite grid tile by tile.
+	*/
+	void RenderSystem::DrawTilemap(Tilemap* tilemap)
+	{
+		FUNNY_PROFILE_SCOPE("DrawTilemap");
+
+		const TilemapRenderData renderData = tilemap->GetRenderData();
+		const TilemapGridData gridData = tilemap->GetGridData();
+
+		const Vector2 origin = gridData.transform.position;
+		const float tileWidth = gridData.transform.scale.x;
+		const float tileHeight = gridData.transform.scale.y;
+		if (tileWidth <= 0 || tileHeight <= 0) { return; }
+
+		SDL_FRect view = m_Camera.GetWorldBounds();
+		int minX = std::max(0, (int)std::floor((view.x - origin.x) / tileWidth));
+		int minY = std::max(0, (int)std::floor((view.y - origin.y) / tileHeight));
+		int maxX = std::min(gridData.xBounds - 1, (int)std::floor((view.x + view.w - origin.x) / tileWidth));
+		int maxY = std::min(gridData.yBounds - 1, (int)std::floor((view.y + view.h - origin.y) / tileHeight));
+
+		if (!m_CacheTilemapChunks)
+		{
+			ForEachTile(tilemap, minX, minY, maxX, maxY, m_Camera, [&](const SDL_Rect& src, const SDL_FRect& dst)
+			{
+				if (m_PartialRedraw && !IsDirty(dst)) { return; }
+				PushSprite(renderData.texture, src, dst, ColorRGBA(255, 255, 255, 255));
+			});
+			return;
+		}
+
+		for (int chunkY = minY / CHUNK_TILES; chunkY <= maxY / CHUNK_TILES; chunkY++)
+		{
+			for (int chunkX = minX / CHUNK_TILES; chunkX <= maxX / CHUNK_TILES; chunkX++)
+			{
+				int startX = chunkX * CHUNK_TILES;
+				int startY = chunkY * CHUNK_TILES;
+				int tilesWide = std::min(CHUNK_TILES, gridData.xBounds - startX);
+				int tilesHigh = std::min(CHUNK_TILES, gridData.yBounds - startY);
+
+				SDL_FRect world { origin.x + (startX * tileWidth), origin.y + (startY * tileHeight), tilesWide * tileWidth, tilesHigh * tileHeight };
+				SDL_FRect screen = m_Camera.WorldToScreen(world);
+				if (m_PartialRedraw && !IsDirty(screen)) { continue; }
+
+				RenderCommand command;
+				command.type = RenderCommandType::TILEMAP_CHUNK;
+				command.chunk.tilemap = tilemap;
+				command.chunk.chunkX = chunkX;
+				command.chunk.chunkY = chunkY;
+				command.chunk.src = SDL_Rect { 0, 0, tilesWide * renderData.tileWidth, tilesHigh * renderData.tileHeight };
+				command.chunk.dst = screen;
+				command.chunk.tiles = SDL_Rect
+				{
+					std::max(minX, startX),
+					std::max(minY, startY),
+					std::min(maxX, startX + CHUNK_TILES - 1),
+					std::min(maxY, startY + CHUNK_TILES - 1)
+				};
+				m_Frame->commands.push_back(command);
+			}
+		}
+	}
+
+	void RenderSystem::DrawSDLTexture(SDL_Texture* texture, SDL_Rect srcRect, SDL_Rect dstRect, bool drawToWorld)
+	{
+		if (texture == nullptr) { return; }
+
+		SDL_FRect dst { (float)dstRect.x, (float)dstRect.y, (float)dstRect.w, (float)dstRect.h };
+		if (drawToWorld)
+		{
+			dst = m_Camera.WorldToScreen(dst);
+		}
+		PushSprite(texture, srcRect, dst, ColorRGBA(255, 255, 255, 255));
+	}
+
+	void RenderSystem::PushSprite(SDL_Texture* texture, const SDL_Rect& src, const SDL_FRect& dst, const ColorRGBA& color)
+	{
+		PushSprite(texture, src, dst, ToSDLColor(color));
+	}
+
+	void RenderSystem::PushSprite(SDL_Texture* texture, const SDL_Rect& src, const SDL_FRect& dst, const SDL_Color& color)
+	{
+		if (texture == nullptr) { return; }
+
+		RenderCommand command;
+		command.type = RenderCommandType::SPRITE;
+		command.sprite.texture = texture;
+		command.sprite.src = src;
+		command.sprite.dst = dst;
+		command.sprite.color = color;
+		m_Frame->commands.push_back(command);
+	}
+
+	void RenderSystem::PushClipRect(const SDL_Rect* clipRect)
+	{
+		RenderCommand command;
+		command.type = RenderCommandType::SET_CLIP_RECT;
+		command.clipRect = (clipRect != nullptr) ? *clipRect : SDL_Rect { 0, 0, 0, 0 };
+		m_Frame->commands.push_back(command);
+	}
+
+	/*
+	* Starts filling in the next frame's commands.
+	* Has to come before anything else gets drawn.
+	*/
+	void RenderSystem::BeginFrame()
+	{
+		m_Frame = &m_Queue.GetWriteFrame();
+		m_Frame->commands.clear();
+		m_Frame->camera = m_Camera;
+		m_FrameIdle = false;
+	}
+
+	void RenderSystem::RenderClear()
+	{
+		RenderCommand command;
+		command.type = RenderCommandType::CLEAR;
+		m_Frame->commands.push_back(command);
+	}
+
+	void RenderSystem::RenderOverlay()
+	{
+		DebugOverlay::endFrame(m_Frame->overlay);
+
+		RenderCommand command;
+		command.type = RenderCommandType::OVERLAY;
+		m_Frame->commands.push_back(command);
+	}
+
+	/*
+	* Finishes off the frame. With a render thread
+	* this hands it over and returns once the thread
+	* is free to take the next one, otherwise the
+	* frame gets drawn right here.
+	* 
+	* A partial redraw frame where nothing changed
+	* and there's no overlay to draw is dropped on
+	* the spot, the window still shows it already.
+	*/
+	void RenderSystem::RenderPresent()
+	{
+		if (m_PartialRedraw && m_FrameIdle && m_Frame->overlay.isEmpty())
+		{
+			m_PartialStats.skippedFrames++;
+			m_Frame = nullptr;
+			return;
+		}
+
+		RenderCommand command;
+		command.type = RenderCommandType::PRESENT;
+		m_Frame->commands.push_back(command);
+
+		if (IsRenderThreaded())
+		{
+			m_Queue.Submit();
+		}
+		else
+		{
+			ExecuteFrame(*m_Frame);
+		}
+
+		m_Frame = nullptr;
+	}
+
+	/*
+	* With a render thread, making the renderer is
+	* the first task it runs.
+	*/
+	bool RenderSystem::StartRenderer(bool threaded)
+	{
+		if (IsRenderThreaded() || m_Window.getSDLRenderer() != nullptr) { return true; }
+
+		if (threaded)
+		{
+			m_Queue.Restart();
+			m_RenderThread = std::thread(&RenderSystem::RenderThreadMain, this);
+		}
+
+		bool created = false;
+		RunOnRenderThread([this, &created](SDL_Renderer*)
+		{
+			created = m_Window.createRenderer();
+			if (created)
+			{
+				int width = 0;
+				int height = 0;
+				SDL_GetRendererOutputSize(m_Window.getSDLRenderer(), &width, &height);
+				m_OutputWidth = width;
+				m_OutputHeight = height;
+			}
+		});
+
+		if (!created)
+		{
+			StopRenderer();
+		}
+
+		return created;
+	}
+
+	void RenderSystem::StopRenderer()
+	{
+		if (!IsRenderThreaded()) { return; }
+
+		m_Queue.Stop();
+		m_RenderThread.join();
+	}
+
+	void RenderSystem::RunOnRenderThread(const std::function<void(SDL_Renderer*)>& task)
+	{
+		if (!IsRenderThreaded() || std::this_thread::get_id() == m_RenderThread.get_id())
+		{
+			task(m_Window.getSDLRenderer());
+			return;
+		}
+
+		// Whatever the task needs from us stays put, since we're waiting on it
+		m_Queue.WaitForTask(m_Queue.Post([this, &task] { task(m_Window.getSDLRenderer()); }));
+	}
+
+	void RenderSystem::PostToRenderThread(std::function<void(SDL_Renderer*)> task)
+	{
+		if (!IsRenderThreaded() || std::this_thread::get_id() == m_RenderThread.get_id())
+		{
+			task(m_Window.getSDLRenderer());
+			return;
+		}
+
+		m_Queue.Post([this, task = std::move(task)] { task(m_Window.getSDLRenderer()); });
+	}
+
+	void RenderSystem::RenderThreadMain()
+	{
+		while (RenderFrame* frame = m_Queue.WaitForFrame())
+		{
+			ExecuteFrame(*frame);
+			m_Queue.FinishFrame();
+		}
+
+		ReleaseRenderer();
+	}
+
+	/*
+	* Everything we made on the renderer goes first,
+	* then the renderer itself. Only ever called by
+	* whichever thread owns it.
+	*/
+	void RenderSystem::ReleaseRenderer()
+	{
+		if (m_Window.getSDLRenderer() == nullptr) { return; }
+
+		m_ChunkCache.Clear();
+		if (m_LightTexture != nullptr)
+		{
+			SDL_DestroyTexture(m_LightTexture);
+			m_LightTexture = nullptr;
+		}
+		DestroyPartialTarget();
+		m_RasterTextures.clear();
+		m_LastFrame = nullptr;
+
+		m_Window.destroyRenderer();
+	}
+
+	/*
+	* Plays back a frame's commands. Sprites pile up
+	* in the batcher and only get drawn once some other
+	* command needs the renderer's state to change, so
+	* each stretch of sprites still batches together.
+	* Sprites for the rasterizer pile up the same way,
+	* and whichever of the two has sprites waiting
+	* draws them before the other takes any, so
+	* everything still lands in command order.
+	*/
+	void RenderSystem::ExecuteFrame(RenderFrame& frame)
+	{
+		FUNNY_PROFILE_SCOPE("ExecuteRenderFrame");
+
+		SDL_Renderer* renderer = m_Window.getSDLRenderer();
+
+		int outputWidth = 0;
+		int outputHeight = 0;
+		SDL_GetRendererOutputSize(renderer, &outputWidth, &outputHeight);
+		m_OutputWidth = outputWidth;
+		m_OutputHeight = outputHeight;
+
+		if (m_RenderTargetsLost.exchange(false))
+		{
+			m_ChunkCache.Clear();
+			DestroyPartialTarget();
+		}
+
+		m_ChunkCache.BeginFrame();
+		m_Batcher.Begin();
+		m_RasterSprites.clear();
+		m_LastFrame = &frame;
+		m_ExecutedFrames++;
+
+		// Copies of textures that haven't been drawn in a while have most likely been destroyed
+		for (auto raster = m_RasterTextures.begin(); raster != m_RasterTextures.end();)
+		{
+			raster = (raster->second.lastUsed + 600 < m_ExecutedFrames) ? m_RasterTextures.erase(raster) : std::next(raster);
+		}
+
+		bool captured = false;
+
+		// While drawing into the partial redraw target, every clip rect is cut down to the dirty rect
+		bool partial = false;
+		SDL_Rect dirtyRect { 0, 0, 0, 0 };
+
+		// The rasterizer draws straight into the offscreen surface, so it has to keep its own clip rect
+		const bool raster = IsSoftwareRaster();
+		SDL_Rect rasterClip { 0, 0, 0, 0 };
+		auto flushRaster = [&] { FlushRaster(renderer, SDL_RectEmpty(&rasterClip) ? nullptr : &rasterClip); };
+
+		for (const RenderCommand& command : frame.commands)
+		{
+			if (command.type != RenderCommandType::SPRITE)
+			{
+				flushRaster();
+			}
+
+			switch (command.type)
+			{
+			case RenderCommandType::SPRITE:
+			{
+				const SpriteCommand& sprite = command.sprite;
+
+				const RasterImage* image = (raster && !partial) ? GetRasterTexture(renderer, sprite.texture) : nullptr;
+				if (image != nullptr)
+				{
+					m_Batcher.Flush(renderer);
+					m_RasterSprites.push_back({ image, sprite.src, sprite.dst, sprite.color });
+					break;
+				}
+
+				flushRaster();
+				m_Batcher.Submit(sprite.texture, sprite.src, sprite.dst, ColorRGBA(sprite.color.r, sprite.color.g, sprite.color.b, sprite.color.a));
+				break;
+			}
+
+			case RenderCommandType::TILEMAP_CHUNK:
+			{
+				const TilemapChunkCommand& chunk = command.chunk;
+
+				SDL_Texture* texture = m_ChunkCache.GetChunk(renderer, chunk.tilemap, chunk.chunkX, chunk.chunkY);
+				if (texture != nullptr)
+				{
+					m_Batcher.Submit(texture, chunk.src, chunk.dst, ColorRGBA(255, 255, 255, 255));
+					break;
+				}
+
+				std::unique_lock<std::mutex> tilemapLock = chunk.tilemap->Lock();
+				SDL_Texture* sheet = chunk.tilemap->GetRenderData().texture;
+				ForEachTile(chunk.tilemap, chunk.tiles.x, chunk.tiles.y, chunk.tiles.w, chunk.tiles.h, frame.camera, [&](const SDL_Rect& src, const SDL_FRect& dst)
+				{
+					m_Batcher.Submit(sheet, src, dst, ColorRGBA(255, 255, 255, 255));
+				});
+				break;
+			}
+
+			case RenderCommandType::CLEAR:
+				m_Batcher.Flush(renderer);
+				SDL_RenderClear(renderer);
+				break;
+
+			case RenderCommandType::SET_CLIP_RECT:
+			{
+				m_Batcher.Flush(renderer);
+				if (!partial)
+				{
+					SDL_RenderSetClipRect(renderer, SDL_RectEmpty(&command.clipRect) ? nullptr : &command.clipRect);
+					rasterClip = command.clipRect;
+					break;
+				}
+
+				// The simulation keeps the dirty rect inside the viewport, so this can't come out empty
+				SDL_Rect clip = dirtyRect;
+				if (!SDL_RectEmpty(&command.clipRect))
+				{
+					SDL_IntersectRect(&command.clipRect, &dirtyRect, &clip);
+				}
+				SDL_RenderSetClipRect(renderer, &clip);
+				break;
+			}
+
+			case RenderCommandType::PARTIAL_BEGIN:
+				m_Batcher.Flush(renderer);
+				partial = BeginPartialTarget(renderer, command.clipRect);
+				dirtyRect = command.clipRect;
+				break;
+
+			case RenderCommandType::PARTIAL_END:
+			{
+				m_Batcher.Flush(renderer);
+				partial = false;
+
+				SDL_SetRenderTarget(renderer, nullptr);
+				SDL_RenderSetClipRect(renderer, nullptr);
+				rasterClip = SDL_Rect { 0, 0, 0, 0 };
+				if (m_PartialTarget == nullptr)
+				{
+					m_PartialTargetLost = true;
+					break;
+				}
+
+				// A resize since the last redraw gets stretched for a frame, until everything's redrawn at the new size
+				int width = 0;
+				int height = 0;
+				SDL_GetRendererOutputSize(renderer, &width, &height);
+				if (width != m_PartialTargetWidth || height != m_PartialTargetHeight)
+				{
+					m_PartialTargetLost = true;
+				}
+
+				SDL_RenderCopy(renderer, m_PartialTarget, nullptr, nullptr);
+				break;
+			}
+
+			case RenderCommandType::LIGHT_MAP:
+				m_Batcher.Flush(renderer);
+				DrawLightMap(renderer, frame);
+				break;
+
+			case RenderCommandType::OVERLAY:
+				m_Batcher.Flush(renderer);
+				if (!captured)
+				{
+					m_FrameCapture.CaptureFrame(renderer);
+					captured = true;
+				}
+				DebugOverlay::renderDrawData(frame.overlay);
+				break;
+
+			case RenderCommandType::PRESENT:
+			{
+				m_Batcher.Flush(renderer);
+				if (!captured)
+				{
+					m_FrameCapture.CaptureFrame(renderer);
+					captured = true;
+				}
+
+				FUNNY_PROFILE_SCOPE("RenderPresent");
+				SDL_RenderPresent(renderer);
+				break;
+			}
+			}
+		}
+
+		std::lock_guard<std::mutex> statsLock(m_StatsMutex);
+		m_BatchStats = m_Batcher.GetStats();
+		m_ChunkStats = m_ChunkCache.GetStats();
+	}
+
+	/*
+	* The light map gets stretched over the viewport
+	* with linear filtering, which smooths out its
+	* cells, and multiplied into whatever's been
+	* drawn so far.
+	*/
+	void RenderSystem::DrawLightMap(SDL_Renderer* renderer, const RenderFrame& frame)
+	{
+		const LightMapImage& image = frame.lightMap;
+		if (image.width == 0 || image.height == 0) { return; }
+
+		if (m_LightTexture == nullptr || m_LightTextureWidth != image.width || m_LightTextureHeight != image.height)
+		{
+			if (m_LightTexture != nullptr)
+			{
+				SDL_DestroyTexture(m_LightTexture);
+			}
+
+			m_LightTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, image.width, image.height);
+			if (m_LightTexture == nullptr)
+			{
+				std::cout << "Unable to create light map texture: " << SDL_GetError() << std::endl;
+				return;
+			}
+
+			SDL_SetTextureBlendMode(m_LightTexture, SDL_BLENDMODE_MOD);
+			SDL_SetTextureScaleMode(m_LightTexture, SDL_ScaleModeLinear);
+			m_LightTextureWidth = image.width;
+			m_LightTextureHeight = image.height;
+		}
+
+		SDL_UpdateTexture(m_LightTexture, nullptr, image.pixels.data(), image.width * (int)sizeof(uint32_t));
+
+		SDL_Rect dst { frame.camera.viewport.x, frame.camera.viewport.y, image.width * image.cellSize, image.height * image.cellSize };
+		SDL_RenderCopy(renderer, m_LightTexture, nullptr, &dst);
+	}
+
+	/*
+	* Points the renderer at the partial redraw
+	* target, (re)creating it to match the output
+	* first if need be, and fills in the dirty rect
+	* with the clear color so it's drawn over fresh.
+	* A new target starts out cleared everywhere
+	* and tells the simulation to redraw it all.
+	* 
+	* When there's no target, we're left drawing
+	* straight onto the window, and the simulation
+	* keeps redrawing everything until there is.
+	*/
+	bool RenderSystem::BeginPartialTarget(SDL_Renderer* renderer, const SDL_Rect& dirtyRect)
+	{
+		int width = 0;
+		int height = 0;
+		SDL_GetRendererOutputSize(renderer, &width, &height);
+
+		bool created = false;
+		if (m_PartialTarget == nullptr || m_PartialTargetWidth != width || m_PartialTargetHeight != height)
+		{
+			DestroyPartialTarget();
+			m_PartialTargetLost = true;
+
+			m_PartialTarget = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+			if (m_PartialTarget == nullptr)
+			{
+				std::cout << "Unable to create partial redraw target: " << SDL_GetError() << std::endl;
+				return false;
+			}
+
+			SDL_SetTextureBlendMode(m_PartialTarget, SDL_BLENDMODE_NONE);
+			m_PartialTargetWidth = width;
+			m_PartialTargetHeight = height;
+			created = true;
+		}
+
+		if (SDL_SetRenderTarget(renderer, m_PartialTarget) != 0)
+		{
+			std::cout << "Unable to draw into partial redraw target: " << SDL_GetError() << std::endl;
+			DestroyPartialTarget();
+			m_PartialTargetLost = true;
+			return false;
+		}
+
+		if (created)
+		{
+			SDL_RenderSetClipRect(renderer, nullptr);
+			SDL_RenderClear(renderer);
+		}
+
+		SDL_RenderSetClipRect(renderer, &dirtyRect);
+		SDL_RenderFillRect(renderer, &dirtyRect);
+		return true;
+	}
+
+	void RenderSystem::DestroyPartialTarget()
+	{
+		if (m_PartialTarget == nullptr) { return; }
+
+		SDL_DestroyTexture(m_PartialTarget);
+		m_PartialTarget = nullptr;
+		m_PartialTargetWidth = 0;
+		m_PartialTargetHeight = 0;
+	}
+
+	SpriteBatchStats RenderSystem::GetBatchStats()
+	{
+		std::lock_guard<std::mutex> lock(m_StatsMutex);
+		return m_BatchStats;
+	}
+
+	TilemapChunkStats RenderSystem::GetChunkStats()
+	{
+		std::lock_guard<std::mutex> lock(m_StatsMutex);
+		return m_ChunkStats;
+	}
+
+	bool RenderSystem::HashFrame(uint64_t& hash)
+	{
+		if (!m_Window.isOffscreen())
+		{
+			std::cout << "Frames can only be read back when rendering offscreen." << std::endl;
+			return false;
+		}
+
+		// Nothing touches the surface while the render thread's idle
+		m_Queue.WaitIdle();
+
+		hash = ImageHash::hashSurface(m_Window.getSurface());
+		return true;
+	}
+
+	/*
+	* Reads a texture back by copying it, blending
+	* off, onto a render target of its own size. Only
+	* ever called while the renderer's drawing to the
+	* offscreen surface, where SDL keeps the surface's
+	* clip rect aside until the target's reset.
+	*/
+	const RasterImage* RenderSystem::GetRasterTexture(SDL_Renderer* renderer, SDL_Texture* texture)
+	{
+		if (texture == nullptr) { return nullptr; }
+
+		auto found = m_RasterTextures.find(texture);
+		if (found != m_RasterTextures.end() && SDL_GetTextureUserData(texture) == (void*)found->second.id)
+		{
+			found->second.lastUsed = m_ExecutedFrames;
+			return &found->second.image;
+		}
+
+		FUNNY_PROFILE_SCOPE("ReadBackRasterTexture");
+
+		int width = 0;
+		int height = 0;
+		SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
+
+		SDL_Texture* copy = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+		if (copy == nullptr)
+		{
+			std::cout << "Unable to read texture back for the sprite rasterizer: " << SDL_GetError() << std::endl;
+			return nullptr;
+		}
+
+		RasterTexture& raster = m_RasterTextures[texture];
+		raster = RasterTexture();
+		raster.id = m_NextRasterTextureID++;
+		raster.lastUsed = m_ExecutedFrames;
+		raster.pixels.resize((size_t)width * (size_t)height);
+		raster.image = RasterImage { raster.pixels.data(), width, height, width };
+
+		SDL_BlendMode blendMode;
+		Uint8 red, green, blue, alpha;
+		SDL_GetTextureBlendMode(texture, &blendMode);
+		SDL_GetTextureColorMod(texture, &red, &green, &blue);
+		SDL_GetTextureAlphaMod(texture, &alpha);
+
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+		SDL_SetTextureColorMod(texture, 255, 255, 255);
+		SDL_SetTextureAlphaMod(texture, 255);
+
+		SDL_SetRenderTarget(renderer, copy);
+		SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+		SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888, raster.pixels.data(), width * (int)sizeof(uint32_t));
+		SDL_SetRenderTarget(renderer, nullptr);
+
+		SDL_SetTextureBlendMode(texture, blendMode);
+		SDL_SetTextureColorMod(texture, red, green, blue);
+		SDL_SetTextureAlphaMod(texture, alpha);
+		SDL_DestroyTexture(copy);
+
+		SDL_SetTextureUserData(texture, (void*)raster.id);
+		return &raster.image;
+	}
+
+	void RenderSystem::FlushRaster(SDL_Renderer* renderer, const SDL_Rect* clipRect)
+	{
+		if (m_RasterSprites.empty()) { return; }
+
+		// SDL queues up its own drawing, which has to land first
+		SDL_RenderFlush(renderer);
+
+		SDL_Surface* surface = m_Window.getSurface();
+		if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) != 0)
+		{
+			m_RasterSprites.clear();
+			return;
+		}
+
+		if (m_Rasterizer == nullptr)
+		{
+			m_Rasterizer = std::make_unique<SpriteRasterizer>();
+		}
+
+		RasterImage target { (uint32_t*)surface->pixels, surface->w, surface->h, surface->pitch / (int)sizeof(uint32_t) };
+		m_Rasterizer->Draw(target, m_RasterSprites, clipRect);
+
+		if (SDL_MUSTLOCK(surface))
+		{
+			SDL_UnlockSurface(surface);
+		}
+
+		m_RasterSprites.clear();
+	}
+
+	/*
+	* Plays the last frame back twice more, with
+	* whichever setting isn't current going first.
+	* Frame capture would record both, and partial
+	* redraw frames only cover what changed, so
+	* neither can be on.
+	*/
+	bool RenderSystem::CompareRaster(RasterComparison& comparison)
+	{
+		if (!m_Window.isOffscreen() || m_PartialRedraw || IsCapturingFrames())
+		{
+			std::cout << "Comparing rasterizers needs offscreen rendering, without partial redraw or frame capture." << std::endl;
+			return false;
+		}
+
+		m_Queue.WaitIdle();
+
+		if (m_LastFrame == nullptr) { return false; }
+
+		SDL_Surface* surface = m_Window.getSurface();
+		auto drawWith = [&](bool raster, std::vector<uint32_t>& pixels)
+		{
+			m_SoftwareRaster = raster;
+			RunOnRenderThread([this](SDL_Renderer*) { ExecuteFrame(*m_LastFrame); });
+
+			pixels.resize((size_t)surface->w * (size_t)surface->h);
+			for (int y = 0; y < surface->h; y++)
+			{
+				std::memcpy(&pixels[(size_t)y * surface->w], (const uint8_t*)surface->pixels + (size_t)y * surface->pitch, (size_t)surface->w * sizeof(uint32_t));
+			}
+
+			uint64_t hash = ImageHash::hashSurface(surface);
+			(raster ? comparison.rasterHash : comparison.sdlHash) = hash;
+		};
+
+		const bool current = m_SoftwareRaster;
+		std::vector<uint32_t> other;
+		std::vector<uint32_t> shown;
+		drawWith(!current, other);
+		drawWith(current, shown);
+
+		comparison.differentPixels = 0;
+		comparison.maxDifference = 0;
+		for (size_t i = 0; i < shown.size(); i++)
+		{
+			if (shown[i] == other[i]) { continue; }
+
+			comparison.differentPixels++;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				int difference = std::abs((int)((shown[i] >> shift) & 0xFF) - (int)((other[i] >> shift) & 0xFF));
+				comparison.maxDifference = std::max(comparison.maxDifference, difference);
+			}
+		}
+
+		return true;
+	}
+
+	bool RenderSystem::SaveFrame(std::string filepath)
+	{
+		if (!m_Window.isOffscreen())
+		{
+			std::cout << "Frames can only be read back when rendering offscreen." << std::endl;
+			return false;
+		}
+
+		m_Queue.WaitIdle();
+
+		if (SDL_SaveBMP(m_Window.getSurface(), filepath.c_str()) != 0)
+		{
+			std::cout << "Unable to save frame to path " << filepath << ": " << SDL_GetError() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	/*
+	* Both of these run on the render thread, so it
+	* can never be partway through reading a frame
+	* back while we start or stop. Stopping waits for
+	* the encoder to finish what's queued, which holds
+	* up drawing for a moment.
+	*/
+	bool RenderSystem::StartFrameCapture(const FrameCaptureSettings& settings)
+	{
+		bool started = false;
+		RunOnRenderThread([this, &settings, &started](SDL_Renderer* renderer)
+		{
+			int width = 0;
+			int height = 0;
+			if (SDL_GetRendererOutputSize(renderer, &width, &height) != 0)
+			{
+				std::cout << "Unable to get the renderer's size for frame capture: " << SDL_GetError() << std::endl;
+				return;
+			}
+
+			started = m_FrameCapture.Start(settings, width, height);
+		});
+
+		return started;
+	}
+
+	void RenderSystem::StopFrameCapture()
+	{
+		RunOnRenderThread([this](SDL_Renderer*) { m_FrameCapture.Stop(); });
+	}
+
+	void RenderSystem::SetTilemapChunkBudget(size_t chunks)
 	{
-		SDL_RenderPresent(m_Window.getSDLRenderer());
+		RunOnRenderThread([this, chunks](SDL_Renderer*) { m_ChunkCache.SetBudget(chunks); });
 	}
 }
\ No newline at end of file
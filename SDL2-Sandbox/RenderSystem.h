@@ -1,8 +1,25 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <SDL2/SDL.h>
 #include "System.hpp"
 #include "Window.h"
 #include "Tilemap.h"
+#include "SpriteBatcher.h"
+#include "SpriteRasterizer.h"
+#include "SpatialGrid.h"
+#include "TilemapChunkCache.h"
+#include "Camera.h"
+#include "RenderQueue.h"
+#include "DrawKeySorter.h"
+#include "LightMap.h"
+#include "FrameCapture.h"
 
 namespace Funny
 {
@@ -42,6 +59,8 @@ namespace Funny
 
 	// We also need to make sure that only objects within the camera's
 	// field of view are rendered. No need to draw things we cant see.
+	// (Done now, entities get tracked in a SpatialGrid and each frame
+	// we only ask it for whatever overlaps the camera.)
 
 	// Also, be sure to assert/handle situations where the rendering
 	// system attempts to draw a texture that either doesn't exist or
@@ -94,6 +113,51 @@ namespace Funny
 	// confines of the ECS, other systems can co-exist and function
 	// alongside our ECS.
 
+	struct PartialRedrawStats
+	{
+		uint64_t redrawnFrames = 0;
+		uint64_t fullFrames = 0;	// Redrawn frames that had to cover the whole viewport
+		uint64_t skippedFrames = 0;	// Nothing changed, so nothing got drawn or presented
+		float dirtyFraction = 0;	// How much of the viewport the last redrawn frame covered
+	};
+
+	/*
+	* The same frame drawn once with our sprite
+	* rasterizer and once with SDL's software
+	* renderer. Difference is the largest gap
+	* between the two in any one channel.
+	*/
+	struct RasterComparison
+	{
+		uint64_t rasterHash = 0;
+		uint64_t sdlHash = 0;
+		int differentPixels = 0;
+		int maxDifference = 0;
+	};
+
+	/*
+	* Drawing is split in two. Draw and friends run on
+	* the simulation thread and only ever write render
+	* commands into a RenderFrame. Those get executed
+	* against the SDL_Renderer by a dedicated render
+	* thread, so the simulation can get on with the
+	* next frame while this one is being drawn.
+	* 
+	* The render thread owns the SDL_Renderer. It
+	* makes it, draws with it and destroys it, since
+	* SDL won't have a renderer used from any other
+	* thread (its GL context for one can only be
+	* current on the one). Anything else that needs
+	* the renderer (texture uploads for example) gets
+	* run over there through RunOnRenderThread, or
+	* PostToRenderThread when it doesn't need to wait.
+	* 
+	* Lockstep mode skips the thread entirely and runs
+	* each frame's commands right when it's presented,
+	* which is a lot easier to step through in a
+	* debugger. The main thread owns the renderer then,
+	* and tasks just run on the spot.
+	*/
 	class RenderSystem : public System
 	{
 	public:
@@ -101,17 +165,292 @@ namespace Funny
 		~RenderSystem();
 
 		void Update() override;
-		void DrawEntity(Entity entity);
+		void Draw(float alpha) override;
+		void DrawEntity(Entity entity, float alpha = 1.0f);
 		void DrawTilemap(Tilemap* tilemap);
+		void DrawTexts(float alpha);
+		void DrawLights(float alpha);
 
+		void SnapshotTransforms();
+		void RefreshSpatialIndex();
+
+		void EntityAdded(Entity entity) override;
+		void EntityRemoved(Entity entity) override;
+
+		void BeginFrame();
 		void RenderClear();
+		void RenderOverlay();
 		void RenderPresent();
 
+		/*
+		* Makes the renderer for the window, on a render
+		* thread of its own unless we're in lockstep.
+		* Stopping lets the thread finish anything that
+		* was already submitted or posted, then takes
+		* the renderer down along with every texture
+		* still on it, so unload those first.
+		*/
+		bool StartRenderer(bool threaded);
+		void StopRenderer();
+		bool IsRenderThreaded() const { return m_RenderThread.joinable(); }
+
+		/*
+		* Run always waits for the task to be done, Post
+		* only waits if there's no render thread to run
+		* it later. Posted tasks still run before the
+		* next frame's drawn.
+		*/
+		void RunOnRenderThread(const std::function<void(SDL_Renderer*)>& task);
+		void PostToRenderThread(std::function<void(SDL_Renderer*)> task);
+
+		// Blocks until every frame submitted and task posted so far is done
+		void WaitForRenderThread() { m_Queue.WaitIdle(); }
+
+		// As of the last frame drawn, for anything on the simulation side that needs to know
+		void GetOutputSize(int& width, int& height) const { width = m_OutputWidth; height = m_OutputHeight; }
+
 		Window& getWindow() { return m_Window; };
+		Camera& GetCamera() { return m_Camera; }
+
+		// Stats come from the render thread, so these hand back copies
+		SpriteBatchStats GetBatchStats();
+		TilemapChunkStats GetChunkStats();
+
+		/*
+		* Waits for everything submitted so far to be
+		* drawn, then reads back the offscreen surface.
+		* These only work offscreen since a window's back
+		* buffer is gone once it's been presented.
+		*/
+		bool HashFrame(uint64_t& hash);
+		bool SaveFrame(std::string filepath);
+
+		/*
+		* Records frames to disk as they're presented,
+		* see FrameCapture. Frames get read back before
+		* the debug overlay is drawn over them.
+		*/
+		bool StartFrameCapture(const FrameCaptureSettings& settings);
+		void StopFrameCapture();
+		bool IsCapturingFrames() const { return m_FrameCapture.IsCapturing(); }
+		FrameCaptureStats GetFrameCaptureStats() const { return m_FrameCapture.GetStats(); }
+
+		/*
+		* Partial redraw keeps the world in a texture
+		* that lives across frames, and only redraws
+		* the part of it covered by sprites and text
+		* that changed since the last frame. When
+		* nothing changed at all (and the debug overlay
+		* has nothing to show) the frame isn't drawn or
+		* presented, so an idle screen costs next to
+		* nothing. Moving the camera, lights, or losing
+		* the texture all mean redrawing everything.
+		*/
+		void SetPartialRedraw(bool enabled);
+		bool IsPartialRedraw() const { return m_PartialRedraw; }
+		void RequestFullRedraw() { m_RedrawAll = true; }
+		const PartialRedrawStats& GetPartialRedrawStats() const { return m_PartialStats; }
+
+		void SetTilemapChunkCaching(bool enabled) { m_CacheTilemapChunks = enabled; }
+		void SetTilemapChunkBudget(size_t chunks);
+		void InvalidateRenderTargets() { m_RenderTargetsLost = true; }
+
+		// Cell size and ambient light are set through here
+		LightMap& GetLightMap() { return m_LightMap; }
+		const LightMapStats& GetLightStats() const { return m_LightMap.GetStats(); }
+
+		/*
+		* Offscreen, sprites get drawn by SpriteRasterizer
+		* straight into the offscreen surface, spread over
+		* worker threads, rather than by SDL's software
+		* renderer on the render thread alone. A texture
+		* gets read back into CPU pixels the first time a
+		* sprite uses it. Anything drawn into the partial
+		* redraw target still goes through SDL.
+		* 
+		* CompareRaster draws the last frame again both
+		* ways and compares them, leaving the surface the
+		* way the current setting draws it. Only set this
+		* before the first frame's submitted.
+		*/
+		void SetSoftwareRaster(bool enabled) { m_SoftwareRaster = enabled; }
+		bool IsSoftwareRaster() const { return m_SoftwareRaster && m_Window.isOffscreen(); }
+		bool CompareRaster(RasterComparison& comparison);
+
+		const DrawSortStats& GetSortStats() const { return m_Sorter.GetStats(); }
+		size_t GetVisibleCount() const { return m_Visible.size(); }
+		size_t GetManagedCount() const { return m_ManagedEntities.size(); }
 
 	private:
 		Window m_Window;
+		Camera m_Camera;
+
+		/*
+		* Where each entity was at the start of the
+		* current simulation tick, so we can draw it
+		* somewhere between there and where the tick
+		* left it. Entities that joined after the last
+		* snapshot just get drawn where they are.
+		*/
+		std::array<Vector2, MAX_ENTITIES> m_PreviousPositions{};
+		std::bitset<MAX_ENTITIES> m_HasPreviousPosition{};
+
+		/*
+		* Every entity we manage, bucketed by where it
+		* is in the world, so culling is a query over
+		* the few cells the camera covers instead of a
+		* test against every single entity. m_Visible
+		* is reused between frames to avoid allocating.
+		*/
+		SpatialGrid m_Grid;
+		std::vector<Entity> m_Visible;
+
+		SDL_FRect GetEntityBounds(Entity entity);
+
+		/*
+		* Visible entities get sorted by draw key before
+		* being drawn. We hand the sorter last frame's
+		* order (plus anything newly visible at the end)
+		* so when little has moved there's little to do.
+		* Texture handles are small and dense already,
+		* so they go into the keys as they are.
+		*/
+		DrawKeySorter m_Sorter;
+		std::vector<DrawKey> m_DrawKeys;
+		std::vector<Entity> m_DrawOrder;
+		std::bitset<MAX_ENTITIES> m_IsVisible{};
+
+		void SortVisible();
+		uint16_t GetTextureID(TextureHandle texture) const;
+
+		bool m_CacheTilemapChunks = true;
+
+		/*
+		* What partial redraw remembers about the last
+		* frame it drew, to compare against. Sprites
+		* are kept by entity along with their draw key
+		* so anything changing order counts too, and
+		* text by the entity it's attached to. Tilemap
+		* chunks get compared by version.
+		* 
+		* Whatever changed adds both where it was and
+		* where it is now to the dirty bounds, a single
+		* rectangle that gets redrawn in full.
+		*/
+		struct DrawnSprite
+		{
+			SDL_Texture* texture;
+			SDL_Rect src;
+			SDL_FRect dst;
+			SDL_Color color;
+			uint64_t key;
+		};
+
+		struct DrawnText
+		{
+			SDL_Texture* texture;
+			uint32_t textID;
+			uint32_t version;
+			SDL_FRect dst;
+			SDL_Color color;
+		};
+
+		bool m_PartialRedraw = false;
+		bool m_RedrawAll = true;
+		bool m_FrameIdle = false;
+		Camera m_DrawnCamera;
+		const Tilemap* m_DrawnTilemap = nullptr;
+		std::vector<uint32_t> m_DrawnChunkVersions;
+
+		std::array<DrawnSprite, MAX_ENTITIES> m_DrawnSprites{};
+		std::bitset<MAX_ENTITIES> m_SpriteWasDrawn{};
+		std::vector<Entity> m_DrawnSpriteEntities;
+
+		std::array<DrawnText, MAX_ENTITIES> m_DrawnTexts{};
+		std::bitset<MAX_ENTITIES> m_TextWasDrawn{};
+		std::vector<Entity> m_DrawnTextEntities;
+		std::vector<Entity> m_DrawnTextScratch;
+
+		bool m_HasDirty = false;
+		SDL_FRect m_DirtyBounds { 0, 0, 0, 0 };
+		SDL_Rect m_DirtyRect { 0, 0, 0, 0 };
+		PartialRedrawStats m_PartialStats;
+
+		void FindDirtyRegion(float alpha);
+		void FindDirtyChunks(const Tilemap* tilemap, bool redrawAll);
+		void AddDirty(const SDL_FRect& rect);
+		bool IsDirty(const SDL_FRect& rect) const;
+		DrawnSprite GetEntitySprite(Entity entity, float alpha);
+		bool GetTextPlacement(int index, float alpha, SDL_FRect& bounds, DrawnText& drawn);
+
+		LightMap m_LightMap;
+		std::vector<LightSource> m_LightSources;
+
+		// Simulation side of the command queue
+		RenderQueue m_Queue;
+		RenderFrame* m_Frame = nullptr;
+
+		void PushSprite(SDL_Texture* texture, const SDL_Rect& src, const SDL_FRect& dst, const ColorRGBA& color);
+		void PushSprite(SDL_Texture* texture, const SDL_Rect& src, const SDL_FRect& dst, const SDL_Color& color);
+		void PushClipRect(const SDL_Rect* clipRect);
+
+		// Everything below belongs to whoever is executing frames
+		std::thread m_RenderThread;
+		std::atomic<bool> m_RenderTargetsLost { false };
+		std::atomic<int> m_OutputWidth { 0 };
+		std::atomic<int> m_OutputHeight { 0 };
+
+		SpriteBatcher m_Batcher;
+		TilemapChunkCache m_ChunkCache; // Static tile layers get drawn from cached chunk textures
+
+		FrameCapture m_FrameCapture;
+
+		SDL_Texture* m_LightTexture = nullptr; // Streaming, resized to fit whatever light map comes in
+		int m_LightTextureWidth = 0;
+		int m_LightTextureHeight = 0;
+
+		// Partial redraw's persistent copy of the world, the size of the renderer's output
+		SDL_Texture* m_PartialTarget = nullptr;
+		int m_PartialTargetWidth = 0;
+		int m_PartialTargetHeight = 0;
+		std::atomic<bool> m_PartialTargetLost { true }; // Set by the render thread, tells the simulation to redraw everything
+
+		/*
+		* CPU copies of textures sprites have been drawn
+		* from. Each texture's user data holds the ID of
+		* its copy, which a new texture landing at a
+		* freed one's address won't have, so it gets
+		* read back again rather than drawn stale.
+		*/
+		struct RasterTexture
+		{
+			uintptr_t id = 0;
+			std::vector<uint32_t> pixels;
+			RasterImage image;
+			uint64_t lastUsed = 0;
+		};
+
+		bool m_SoftwareRaster = true;
+		std::unique_ptr<SpriteRasterizer> m_Rasterizer; // Made the first time it's needed, it starts its own threads
+		std::vector<RasterSprite> m_RasterSprites;
+		std::unordered_map<SDL_Texture*, RasterTexture> m_RasterTextures;
+		uintptr_t m_NextRasterTextureID = 1;
+		uint64_t m_ExecutedFrames = 0;
+		RenderFrame* m_LastFrame = nullptr;
+
+		const RasterImage* GetRasterTexture(SDL_Renderer* renderer, SDL_Texture* texture);
+		void FlushRaster(SDL_Renderer* renderer, const SDL_Rect* clipRect);
+
+		std::mutex m_StatsMutex;
+		SpriteBatchStats m_BatchStats;
+		TilemapChunkStats m_ChunkStats;
 
+		void RenderThreadMain();
+		void ReleaseRenderer();
+		void ExecuteFrame(RenderFrame& frame);
+		void DrawLightMap(SDL_Renderer* renderer, const RenderFrame& frame);
+		bool BeginPartialTarget(SDL_Renderer* renderer, const SDL_Rect& dirtyRect);
+		void DestroyPartialTarget();
 		void DrawSDLTexture(SDL_Texture* texture, SDL_Rect srcRect, SDL_Rect dstRect, bool drawToWorld = true);
 	};
 }
\ No newline at end of file
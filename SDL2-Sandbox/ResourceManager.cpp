@@ -2,43 +2,796 @@
 
 #include "Engine.h"
 #include "RenderSystem.h"
+#include "Profiler.h"
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 namespace Funny
 {
-	std::unordered_map<std::string, SDL_Texture*> ResourceManager::m_Textures;
+	std::vector<TextureResource> ResourceManager::m_TextureTable;
+	std::unordered_map<std::string, TextureHandle> ResourceManager::m_TextureHandles;
+	std::unordered_map<std::string, TextureInfo> ResourceManager::m_TextureInfo;
+	bool ResourceManager::m_Headless = false;
+	size_t ResourceManager::m_TextureBudget = 0;
+	size_t ResourceManager::m_ResidentBytes = 0;
+	uint64_t ResourceManager::m_CurrentFrame = 0;
+	uint64_t ResourceManager::m_Evictions = 0;
+	uint64_t ResourceManager::m_Reuploads = 0;
+	std::vector<ResourceManager::QueuedTexture> ResourceManager::m_QueuedTextures;
+	bool ResourceManager::m_AtlasEnabled = true;
+	int ResourceManager::m_AtlasPageSize = 2048;
+	int ResourceManager::m_AtlasPadding = 2;
+	int ResourceManager::m_AtlasPageCount = 0;
+	std::unordered_map<std::string, ResourceManager::AtlasEntry> ResourceManager::m_AtlasRegions;
+	std::unique_ptr<TaskQueue> ResourceManager::m_DecodeQueue;
+	std::mutex ResourceManager::m_DecodedMutex;
+	std::vector<ResourceManager::DecodedTexture> ResourceManager::m_Decoded;
+	std::mutex ResourceManager::m_UploadMutex;
+	std::deque<ResourceManager::TextureUpload> ResourceManager::m_PendingUploads;
+	std::vector<ResourceManager::TextureUpload> ResourceManager::m_FinishedUploads;
+	bool ResourceManager::m_UploadPosted = false;
+	size_t ResourceManager::m_LoadingCount = 0;
+	float ResourceManager::m_UploadBudgetMs = 2.0f;
+	int ResourceManager::m_UploadedLastFrame = 0;
+	SDL_Texture* ResourceManager::m_Placeholder = nullptr;
+	AssetArchive ResourceManager::m_Archive;
+	DecodeCache ResourceManager::m_DecodeCache;
+	bool ResourceManager::m_DecodeCacheEnabled = true;
+	std::string ResourceManager::m_DecodeCacheDirectory = "cache/decoded";
+	size_t ResourceManager::m_DecodeCacheBudget = 256 * 1024 * 1024;
 
 	SDL_Texture* ResourceManager::loadSDLTexture(std::string filepath, std::string name)
 	{
-		SDL_Surface* tempSurface = IMG_Load(filepath.c_str());
-		if (tempSurface == nullptr)
+		FUNNY_PROFILE_SCOPE("LoadTexture");
+
+		if (m_Headless)
+		{
+			loadTextureStub(filepath, name);
+			return nullptr;
+		}
+
+		DecodedImage image = decodeFile(filepath);
+		return uploadImage(image, filepath, name);
+	}
+
+	void ResourceManager::queueTextureDecode(std::string filepath, std::string name)
+	{
+		// Stubs are just a header read, not worth a thread
+		if (m_Headless)
+		{
+			loadTextureStub(filepath, name);
+			return;
+		}
+
+		auto task = std::make_shared<std::packaged_task<DecodedImage()>>([filepath] { return decodeFile(filepath); });
+		m_QueuedTextures.push_back({ filepath, name, task->get_future() });
+		getDecodeQueue().Push([task] { (*task)(); });
+	}
+
+	TaskQueue& ResourceManager::getDecodeQueue()
+	{
+		if (m_DecodeQueue == nullptr)
+		{
+			m_DecodeQueue = std::make_unique<TaskQueue>();
+		}
+
+		return *m_DecodeQueue;
+	}
+
+	TextureHandle ResourceManager::loadTextureAsync(std::string filepath, std::string name)
+	{
+		if (m_Headless)
+		{
+			loadTextureStub(filepath, name);
+			return getTextureHandle(name);
+		}
+
+		// Already loaded (or on its way), nothing more to do
+		TextureHandle handle = getTextureHandle(name);
+		TextureResource& resource = m_TextureTable[handle];
+		if (isLoaded(resource))
+		{
+			return handle;
+		}
+
+		resource.loading = true;
+		resource.lastUsed = m_CurrentFrame;
+		m_LoadingCount++;
+
+		TextureInfo info;
+		if (readImageHeader(filepath, info))
+		{
+			m_TextureInfo[name] = info;
+		}
+
+		getDecodeQueue().Push([filepath, name]
+		{
+			DecodedTexture decoded { filepath, name, decodeFile(filepath) };
+
+			std::lock_guard<std::mutex> lock(m_DecodedMutex);
+			m_Decoded.push_back(std::move(decoded));
+		});
+
+		return handle;
+	}
+
+	TextureHandle ResourceManager::getTextureHandle(const std::string& name)
+	{
+		auto atlased = m_AtlasRegions.find(name);
+		if (atlased != m_AtlasRegions.end())
+		{
+			return atlased->second.page;
+		}
+
+		return internTexture(name);
+	}
+
+	/*
+	* Hands out the name's own slot in the table,
+	* making an empty one the first time it's seen.
+	* The table only grows, so anything holding a
+	* reference into it has to get it after this.
+	*/
+	TextureHandle ResourceManager::internTexture(const std::string& name)
+	{
+		auto found = m_TextureHandles.find(name);
+		if (found != m_TextureHandles.end())
+		{
+			return found->second;
+		}
+
+		TextureHandle handle = (TextureHandle)m_TextureTable.size();
+		m_TextureTable.emplace_back();
+		m_TextureTable.back().name = name;
+		m_TextureHandles.emplace(name, handle);
+		return handle;
+	}
+
+	/*
+	* Sends finished decodes off to the render thread
+	* in the order they finished, then picks up
+	* whatever it's uploaded since last time. Anything
+	* unloaded while it was still decoding just gets
+	* thrown away, and failed loads stay on the
+	* placeholder.
+	*/
+	void ResourceManager::uploadDecodedTextures()
+	{
+		std::vector<DecodedTexture> decoded;
+		{
+			std::lock_guard<std::mutex> lock(m_DecodedMutex);
+			decoded.swap(m_Decoded);
+		}
+
+		bool post = false;
+		{
+			std::lock_guard<std::mutex> lock(m_UploadMutex);
+			for (DecodedTexture& texture : decoded)
+			{
+				auto found = m_TextureHandles.find(texture.name);
+				bool wanted = found != m_TextureHandles.end() && m_TextureTable[found->second].loading;
+				if (wanted && texture.image.surface != nullptr)
+				{
+					m_PendingUploads.push_back({ texture.filepath, texture.name, std::move(texture.image) });
+					continue;
+				}
+
+				if (wanted)
+				{
+					m_TextureTable[found->second].loading = false;
+					m_LoadingCount--;
+				}
+
+				if (texture.image.surface != nullptr)
+				{
+					SDL_FreeSurface(texture.image.surface);
+				}
+			}
+
+			// One upload task at a time, anything it doesn't get to waits for the next frame's
+			post = !m_PendingUploads.empty() && !m_UploadPosted;
+			m_UploadPosted = m_UploadPosted || post;
+		}
+
+		if (post)
+		{
+			postToRenderer(uploadPending);
+		}
+
+		collectUploads();
+	}
+
+	/*
+	* Runs on the render thread before a frame, and
+	* uploads until the upload budget is spent.
+	*/
+	void ResourceManager::uploadPending(SDL_Renderer* renderer)
+	{
+		FUNNY_PROFILE_SCOPE("UploadDecodedTextures");
+
+		std::unique_lock<std::mutex> lock(m_UploadMutex);
+		m_UploadPosted = false;
+
+		int64_t start = Profiler::nowMicros();
+		int uploaded = 0;
+		while (!m_PendingUploads.empty())
+		{
+			if (uploaded > 0 && (float)(Profiler::nowMicros() - start) / 1000.0f >= m_UploadBudgetMs) { break; }
+
+			TextureUpload upload = std::move(m_PendingUploads.front());
+			m_PendingUploads.pop_front();
+			lock.unlock();
+
+			upload.texture = createTexture(renderer, upload.image, upload.bytes);
+			uploaded++;
+
+			lock.lock();
+			m_FinishedUploads.push_back(std::move(upload));
+		}
+	}
+
+	/*
+	* Hands the render thread's uploads over to their
+	* records. Whatever was unloaded in the meantime
+	* gets its texture destroyed again.
+	*/
+	void ResourceManager::collectUploads()
+	{
+		std::vector<TextureUpload> finished;
+		{
+			std::lock_guard<std::mutex> lock(m_UploadMutex);
+			finished.swap(m_FinishedUploads);
+		}
+
+		m_UploadedLastFrame = 0;
+		for (TextureUpload& upload : finished)
+		{
+			auto found = m_TextureHandles.find(upload.name);
+			if (found == m_TextureHandles.end() || !m_TextureTable[found->second].loading)
+			{
+				if (upload.texture != nullptr)
+				{
+					postToRenderer([texture = upload.texture](SDL_Renderer*) { SDL_DestroyTexture(texture); });
+				}
+				if (upload.image.surface != nullptr)
+				{
+					SDL_FreeSurface(upload.image.surface);
+				}
+				continue;
+			}
+
+			m_TextureTable[found->second].loading = false;
+			m_LoadingCount--;
+
+			if (storeTexture(upload.image, upload.texture, upload.bytes, upload.filepath, upload.name) != nullptr)
+			{
+				m_UploadedLastFrame++;
+			}
+		}
+	}
+
+	void ResourceManager::runOnRenderer(const std::function<void(SDL_Renderer*)>& task)
+	{
+		Engine::getCoordinator()->GetSystem<RenderSystem>()->RunOnRenderThread(task);
+	}
+
+	void ResourceManager::postToRenderer(std::function<void(SDL_Renderer*)> task)
+	{
+		Engine::getCoordinator()->GetSystem<RenderSystem>()->PostToRenderThread(std::move(task));
+	}
+
+	SDL_Texture* ResourceManager::getPlaceholder()
+	{
+		if (m_Placeholder != nullptr || m_Headless) { return m_Placeholder; }
+
+		SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, PLACEHOLDER_SIZE, PLACEHOLDER_SIZE, 32, SDL_PIXELFORMAT_ARGB8888);
+		if (surface == nullptr)
+		{
+			std::cout << "Unable to create placeholder texture: " << SDL_GetError() << std::endl;
+			return nullptr;
+		}
+
+		const int half = PLACEHOLDER_SIZE / 2;
+		for (int y = 0; y < PLACEHOLDER_SIZE; y++)
+		{
+			Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+			for (int x = 0; x < PLACEHOLDER_SIZE; x++)
+			{
+				row[x] = ((x < half) == (y < half)) ? 0xFFFF00FFu : 0xFF202020u;
+			}
+		}
+
+		runOnRenderer([surface](SDL_Renderer* renderer) { m_Placeholder = SDL_CreateTextureFromSurface(renderer, surface); });
+
+		SDL_FreeSurface(surface);
+		return m_Placeholder;
+	}
+
+	void ResourceManager::finishQueuedTextures()
+	{
+		FUNNY_PROFILE_SCOPE("FinishQueuedTextures");
+
+		std::vector<std::pair<QueuedTexture*, DecodedImage>> decoded;
+		for (QueuedTexture& queued : m_QueuedTextures)
+		{
+			DecodedImage image = queued.image.get();
+			if (image.surface == nullptr) { continue; }
+
+			// Anything already handed a handle of its own keeps it, rather than moving onto a page
+			if (m_AtlasEnabled && m_TextureHandles.find(queued.name) == m_TextureHandles.end())
+			{
+				decoded.push_back({ &queued, std::move(image) });
+			}
+			else
+			{
+				uploadImage(image, queued.filepath, queued.name);
+			}
+		}
+
+		if (!decoded.empty())
+		{
+			buildAtlas(decoded);
+		}
+
+		m_QueuedTextures.clear();
+	}
+
+	/*
+	* Packs every decoded surface into atlas pages and
+	* uploads those instead. Anything too big to go on
+	* a page just gets its own texture like before.
+	* Pages are textures of their own, kept along
+	* with their pixels so they can be evicted.
+	*/
+	void ResourceManager::buildAtlas(std::vector<std::pair<QueuedTexture*, DecodedImage>>& decoded)
+	{
+		TextureAtlas atlas(m_AtlasPageSize, m_AtlasPadding);
+		for (auto& entry : decoded)
+		{
+			atlas.Add(entry.first->name, entry.second.surface);
+		}
+		atlas.Build();
+
+		const std::vector<AtlasPageStats>& pages = atlas.GetPageStats();
+
+		int firstPage = m_AtlasPageCount;
+		std::vector<TextureHandle> pageHandles;
+		for (SDL_Surface* page : atlas.ReleasePages())
+		{
+			std::string pageName = "Atlas page " + std::to_string(m_AtlasPageCount++);
+			DecodedImage image;
+			image.surface = page;
+			bool uploaded = uploadImage(image, pageName, pageName) != nullptr;
+			pageHandles.push_back(uploaded ? internTexture(pageName) : INVALID_TEXTURE);
+		}
+
+		int atlased = 0;
+		for (auto& entry : decoded)
+		{
+			const std::string& name = entry.first->name;
+
+			AtlasRegion region;
+			if (atlas.GetRegion(name, region) && pageHandles[region.page] != INVALID_TEXTURE)
+			{
+				m_TextureInfo[name] = { entry.second.surface->w, entry.second.surface->h };
+				m_AtlasRegions[name] = { pageHandles[region.page], region.rect };
+				atlased++;
+
+				std::cout << "Packed texture at path [" << entry.first->filepath << "] into atlas page " << firstPage + region.page << std::endl;
+				SDL_FreeSurface(entry.second.surface);
+			}
+			else
+			{
+				uploadImage(entry.second, entry.first->filepath, name);
+			}
+		}
+
+		for (size_t i = 0; i < pages.size(); i++)
+		{
+			std::cout << "Atlas page " << firstPage + (int)i << ": " << pages[i].width << "x" << pages[i].height << ", "
+				<< pages[i].images << " images, " << (int)(pages[i].fill * 100.0f) << "% filled" << std::endl;
+		}
+
+		// Sprites can only batch if they share a texture, so at
+		// worst a frame now switches between pages, not images
+		std::cout << "Atlased " << atlased << " textures onto " << pages.size() << " pages, at most "
+			<< (atlased - (int)pages.size()) << " fewer texture switches per frame" << std::endl;
+	}
+
+	/*
+	* Finds the handle of the texture an image lives
+	* in (its atlas page if it has one) and where on
+	* it the image is. Names that were only ever
+	* asked about and never loaded don't count.
+	*/
+	bool ResourceManager::findTexture(const std::string& name, TextureHandle& handle, SDL_Rect& rect)
+	{
+		auto atlased = m_AtlasRegions.find(name);
+		if (atlased != m_AtlasRegions.end())
+		{
+			handle = atlased->second.page;
+			rect = atlased->second.rect;
+			return true;
+		}
+
+		auto found = m_TextureHandles.find(name);
+		if (found == m_TextureHandles.end() || !isLoaded(m_TextureTable[found->second]))
+		{
+			return false;
+		}
+
+		const TextureInfo& info = m_TextureInfo[name];
+		handle = found->second;
+		rect = SDL_Rect { 0, 0, info.width, info.height };
+		return true;
+	}
+
+	/*
+	* Whoever asks for a region gets a raw texture
+	* they'll likely keep, so it gets pinned.
+	*/
+	bool ResourceManager::getTextureRegion(std::string name, TextureRegion& region)
+	{
+		TextureHandle handle = INVALID_TEXTURE;
+		if (!findTexture(name, handle, region.rect))
+		{
+			return false;
+		}
+
+		m_TextureTable[handle].pinned = true;
+		region.texture = useTexture(handle);
+		return region.texture != nullptr;
+	}
+
+	bool ResourceManager::applyTexture(Renderable& renderable, std::string name)
+	{
+		TextureInfo info;
+		if (!getTextureInfo(name, info))
+		{
+			return false;
+		}
+
+		return applyTexture(renderable, name, SDL_Rect { 0, 0, info.width, info.height });
+	}
+
+	/*
+	* Takes a source rect relative to the original
+	* image and points the renderable at wherever
+	* that actually is now.
+	*/
+	bool ResourceManager::applyTexture(Renderable& renderable, std::string name, const SDL_Rect& localRect)
+	{
+		TextureHandle handle = INVALID_TEXTURE;
+		SDL_Rect rect;
+		if (!findTexture(name, handle, rect))
+		{
+			std::cout << "Texture named " << name << " does not exist." << std::endl;
+			return false;
+		}
+
+		renderable.texture = handle;
+		renderable.sourceRect = SDL_Rect { rect.x + localRect.x, rect.y + localRect.y, localRect.w, localRect.h };
+		return true;
+	}
+
+	/*
+	* Reads the file into memory and decodes it from
+	* there (or reads it back from the decode cache),
+	* keeping the file's contents around to decode
+	* again if the texture ever gets evicted. This
+	* only touches what it creates, so it's safe to
+	* run on any thread.
+	*/
+	ResourceManager::DecodedImage ResourceManager::decodeFile(std::string filepath)
+	{
+		DecodedImage image;
+
+		// Nothing to decode, the surface just points into the archive
+		if (m_Archive.Find(filepath, image.archived))
+		{
+			const ArchivedImage& archived = image.archived;
+			image.surface = SDL_CreateRGBSurfaceWithFormatFrom((void*)archived.pixels, archived.width, archived.height, 32, archived.pitch, archived.format);
+			if (image.surface == nullptr)
+			{
+				std::cout << "Unable to wrap archived image " << filepath << ": " << SDL_GetError() << std::endl;
+			}
+			return image;
+		}
+
+		std::ifstream file(filepath, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			std::cout << "Unable to create surface from image at path " << filepath << std::endl;
+			return image;
+		}
+
+		image.encoded.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read((char*)image.encoded.data(), (std::streamsize)image.encoded.size());
+
+		if (!m_DecodeCache.IsOpen())
+		{
+			image.surface = decodeSurface(image.encoded, filepath);
+			return image;
+		}
+
+		// The color key's the only option that changes what a decode comes out as
+		DecodeCacheKey key = m_DecodeCache.MakeKey(filepath, image.encoded, COLOR_KEY);
+		image.surface = m_DecodeCache.Load(key);
+		if (image.surface == nullptr)
+		{
+			image.surface = decodeSurface(image.encoded, filepath);
+			m_DecodeCache.Store(key, image.surface);
+		}
+		return image;
+	}
+
+	// Decodes the image and applies our color key
+	SDL_Surface* ResourceManager::decodeSurface(const std::vector<uint8_t>& encoded, std::string filepath)
+	{
+		FUNNY_PROFILE_SCOPE("DecodeTexture");
+
+		SDL_Surface* surface = IMG_Load_RW(SDL_RWFromConstMem(encoded.data(), (int)encoded.size()), 1);
+		if (surface == nullptr)
 		{
 			std::cout << "Unable to create surface from image at path " << filepath << std::endl;
 			return nullptr;
 		}
-		SDL_SetColorKey(tempSurface, SDL_TRUE, SDL_MapRGB(tempSurface->format, 0x00, 0x00, 0x00));
+		SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, (COLOR_KEY >> 16) & 0xFF, (COLOR_KEY >> 8) & 0xFF, COLOR_KEY & 0xFF));
+
+		return surface;
+	}
+
+	/*
+	* Creates a texture from a decoded surface and
+	* takes ownership of the surface, freeing it.
+	* Has to be called from the main thread.
+	*/
+	SDL_Texture* ResourceManager::loadTextureFromSurface(SDL_Surface* surface, std::string name)
+	{
+		if (surface == nullptr)
+		{
+			return nullptr;
+		}
+
+		if (m_Headless)
+		{
+			m_TextureInfo[name] = { surface->w, surface->h };
+			SDL_FreeSurface(surface);
+			return nullptr;
+		}
+
+		// The caller keeps the texture, so it can't ever be evicted out from under them
+		DecodedImage image;
+		image.surface = surface;
+		SDL_Texture* texture = uploadImage(image, name, name);
+		if (texture != nullptr)
+		{
+			m_TextureTable[internTexture(name)].pinned = true;
+		}
+		return texture;
+	}
+
+	SDL_Texture* ResourceManager::createTexture(SDL_Renderer* renderer, SDL_Surface* surface, size_t& bytes)
+	{
+		FUNNY_PROFILE_SCOPE("UploadTexture");
+
+		SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+		if (texture == nullptr)
+		{
+			std::cout << "Unable to create texture: " << SDL_GetError() << std::endl;
+			return nullptr;
+		}
+
+		Uint32 format = 0;
+		int width = 0;
+		int height = 0;
+		SDL_QueryTexture(texture, &format, nullptr, &width, &height);
+		bytes = (size_t)width * (size_t)height * (size_t)std::max(1, (int)SDL_BYTESPERPIXEL(format));
+
+		return texture;
+	}
+
+	/*
+	* Straight from the archive's mapping into a
+	* texture of the same format, so there's no
+	* conversion on our side and, for renderers
+	* that take the format natively, none on SDL's.
+	*/
+	SDL_Texture* ResourceManager::createTexture(SDL_Renderer* renderer, const ArchivedImage& image, size_t& bytes)
+	{
+		FUNNY_PROFILE_SCOPE("UploadTexture");
+
+		SDL_Texture* texture = SDL_CreateTexture(renderer, image.format, SDL_TEXTUREACCESS_STATIC, image.width, image.height);
+		if (texture == nullptr)
+		{
+			std::cout << "Unable to create texture: " << SDL_GetError() << std::endl;
+			return nullptr;
+		}
+
+		if (SDL_UpdateTexture(texture, nullptr, image.pixels, image.pitch) != 0)
+		{
+			std::cout << "Unable to fill texture: " << SDL_GetError() << std::endl;
+			SDL_DestroyTexture(texture);
+			return nullptr;
+		}
+		SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+		bytes = (size_t)image.width * (size_t)image.height * (size_t)SDL_BYTESPERPIXEL(image.format);
+		return texture;
+	}
+
+	SDL_Texture* ResourceManager::createTexture(SDL_Renderer* renderer, const DecodedImage& image, size_t& bytes)
+	{
+		if (image.archived.pixels != nullptr)
+		{
+			return createTexture(renderer, image.archived, bytes);
+		}
+
+		return (image.surface != nullptr) ? createTexture(renderer, image.surface, bytes) : nullptr;
+	}
+
+	// Takes ownership of the image either way, waiting on the render thread to make its texture
+	SDL_Texture* ResourceManager::uploadImage(DecodedImage& image, std::string filepath, std::string name)
+	{
+		if (image.surface == nullptr && image.archived.pixels == nullptr)
+		{
+			return nullptr;
+		}
+
+		SDL_Texture* texture = nullptr;
+		size_t bytes = 0;
+		runOnRenderer([&image, &texture, &bytes](SDL_Renderer* renderer) { texture = createTexture(renderer, image, bytes); });
+
+		return storeTexture(image, texture, bytes, filepath, name);
+	}
+
+	/*
+	* Puts a texture the render thread made from
+	* the image into the name's record, and takes
+	* ownership of the image. Without the file it
+	* came from (or the archive), the surface is
+	* kept as the texture's source, otherwise it
+	* gets freed. Loading over a name that's
+	* already loaded reuses its record, so anything
+	* holding its handle picks up the new texture.
+	*/
+	SDL_Texture* ResourceManager::storeTexture(DecodedImage& image, SDL_Texture* newTexture, size_t bytes, std::string filepath, std::string name)
+	{
+		const bool archived = image.archived.pixels != nullptr;
 
-		SDL_Renderer* renderTarget = Engine::getCoordinator()->GetSystem<RenderSystem>()->getWindow().getSDLRenderer();
-		SDL_Texture* newTexture = SDL_CreateTextureFromSurface(renderTarget, tempSurface);
 		if (newTexture == nullptr)
 		{
-			std::cout << "Unable to create texture from surface " << name << std::endl;
+			std::cout << "Unable to create texture from " << (archived ? "archived image " : "surface ") << name << std::endl;
+			if (image.surface != nullptr)
+			{
+				SDL_FreeSurface(image.surface);
+				image.surface = nullptr;
+			}
+			return nullptr;
 		}
 
-		else
+		std::cout << "Created texture at path [" << filepath << "]" << (archived ? " from the asset archive" : "") << std::endl;
+
+		TextureResource& resource = m_TextureTable[internTexture(name)];
+		destroyTexture(resource);
+		if (resource.surface != nullptr)
 		{
-			std::cout << "Created texture at path [" << filepath << "]" << std::endl;
-			m_Textures[name] = newTexture;
+			SDL_FreeSurface(resource.surface);
+			resource.surface = nullptr;
 		}
 
-		SDL_FreeSurface(tempSurface);
-		tempSurface = nullptr;
+		resource.texture = newTexture;
+		resource.bytes = bytes;
+		resource.lastUsed = m_CurrentFrame;
+		m_ResidentBytes += bytes;
+		m_AtlasRegions.erase(name);
 
+		if (archived)
+		{
+			// The surface only wrapped the archive's pixels
+			resource.encoded.clear();
+			resource.archived = image.archived;
+			m_TextureInfo[name] = { image.archived.width, image.archived.height };
+			SDL_FreeSurface(image.surface);
+		}
+		else
+		{
+			resource.encoded = std::move(image.encoded);
+			resource.archived = ArchivedImage();
+			m_TextureInfo[name] = { image.surface->w, image.surface->h };
+
+			if (resource.encoded.empty())
+			{
+				resource.surface = image.surface;
+			}
+			else
+			{
+				SDL_FreeSurface(image.surface);
+			}
+		}
+
+		image.surface = nullptr;
 		return newTexture;
 	}
 
-	SDL_Texture* ResourceManager::getSDLTexture(std::string name)
+	/*
+	* Makes an evicted texture again from whatever
+	* it was made from the first time. Anything
+	* still loading (or that failed to, or was
+	* never loaded at all) gets the placeholder
+	* instead. The render thread has to make it
+	* before we can hand it back, so this waits on
+	* whatever frame it's in the middle of drawing.
+	*/
+	SDL_Texture* ResourceManager::reuploadTexture(TextureResource& resource)
+	{
+		if (m_Headless) { return nullptr; }
+		if (resource.loading) { return getPlaceholder(); }
+
+		SDL_Surface* surface = resource.surface;
+		if (resource.archived.pixels == nullptr && surface == nullptr && !resource.encoded.empty())
+		{
+			surface = decodeSurface(resource.encoded, resource.name);
+		}
+
+		if (resource.archived.pixels == nullptr && surface == nullptr) { return getPlaceholder(); }
+
+		size_t bytes = 0;
+		SDL_Texture* texture = nullptr;
+		runOnRenderer([&resource, surface, &bytes, &texture](SDL_Renderer* renderer)
+		{
+			texture = (resource.archived.pixels != nullptr) ? createTexture(renderer, resource.archived, bytes) : createTexture(renderer, surface, bytes);
+		});
+
+		if (surface != resource.surface)
+		{
+			SDL_FreeSurface(surface);
+		}
+
+		if (texture == nullptr)
+		{
+			std::cout << "Unable to upload evicted texture " << resource.name << " again" << std::endl;
+			return getPlaceholder();
+		}
+
+		resource.texture = texture;
+		resource.bytes = bytes;
+		m_ResidentBytes += bytes;
+		m_Reuploads++;
+		return texture;
+	}
+
+	/*
+	* Doesn't wait for the render thread, which
+	* destroys it before drawing its next frame.
+	* Nothing still drawing can be using it by
+	* then (see endFrame).
+	*/
+	void ResourceManager::destroyTexture(TextureResource& resource)
 	{
-		SDL_Texture* texture = m_Textures[name];
+		if (resource.texture == nullptr) { return; }
+
+		postToRenderer([texture = resource.texture](SDL_Renderer*) { SDL_DestroyTexture(texture); });
+
+		resource.texture = nullptr;
+		m_ResidentBytes -= resource.bytes;
+	}
+
+	SDL_Texture* ResourceManager::getSDLTexture(const std::string& name)
+	{
+		// Headless loads are only stubs, so a null texture is expected
+		if (m_Headless && m_TextureInfo.find(name) != m_TextureInfo.end())
+		{
+			return nullptr;
+		}
+
+		TextureHandle handle = INVALID_TEXTURE;
+		SDL_Rect rect;
+		SDL_Texture* texture = findTexture(name, handle, rect) ? useTexture(handle) : nullptr;
 
 		if (texture == nullptr)
 		{
@@ -48,29 +801,377 @@ namespace Funny
 		return texture;
 	}
 
+	void ResourceManager::setTexturePinned(const std::string& name, bool pinned)
+	{
+		TextureHandle handle = INVALID_TEXTURE;
+		SDL_Rect rect;
+		if (findTexture(name, handle, rect))
+		{
+			m_TextureTable[handle].pinned = pinned;
+		}
+	}
+
+	/*
+	* Called once a frame's been submitted. Only
+	* textures with a source to make them again
+	* from can go, and never ones used in this or
+	* the last frame, either of which the render
+	* thread could still be drawing.
+	*/
+	void ResourceManager::endFrame()
+	{
+		uploadDecodedTextures();
+
+		if (m_TextureBudget > 0 && m_ResidentBytes > m_TextureBudget)
+		{
+			FUNNY_PROFILE_SCOPE("EvictTextures");
+
+			std::vector<TextureResource*> candidates;
+			for (TextureResource& resource : m_TextureTable)
+			{
+				if (resource.texture == nullptr || resource.pinned || resource.lastUsed + 1 >= m_CurrentFrame) { continue; }
+				if (!hasSource(resource)) { continue; }
+
+				candidates.push_back(&resource);
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [](const TextureResource* a, const TextureResource* b) { return a->lastUsed < b->lastUsed; });
+
+			for (TextureResource* resource : candidates)
+			{
+				if (m_ResidentBytes <= m_TextureBudget) { break; }
+
+				destroyTexture(*resource);
+				m_Evictions++;
+			}
+		}
+
+		m_CurrentFrame++;
+	}
+
+	TextureResidencyStats ResourceManager::getResidencyStats()
+	{
+		TextureResidencyStats stats;
+		for (const TextureResource& resource : m_TextureTable)
+		{
+			stats.textures += isLoaded(resource) ? 1 : 0;
+			stats.resident += (resource.texture != nullptr) ? 1 : 0;
+		}
+
+		stats.residentBytes = m_ResidentBytes;
+		stats.budgetBytes = m_TextureBudget;
+		stats.evictions = m_Evictions;
+		stats.reuploads = m_Reuploads;
+		stats.loading = m_LoadingCount;
+		stats.uploadedLastFrame = m_UploadedLastFrame;
+		return stats;
+	}
+
+	bool ResourceManager::loadTextureStub(std::string filepath, std::string name)
+	{
+		TextureInfo info;
+		if (!readImageHeader(filepath, info))
+		{
+			std::cout << "Unable to read image header at path " << filepath << std::endl;
+			return false;
+		}
+
+		m_TextureInfo[name] = info;
+		return true;
+	}
+
+	bool ResourceManager::getTextureInfo(std::string name, TextureInfo& info)
+	{
+		auto found = m_TextureInfo.find(name);
+		if (found == m_TextureInfo.end())
+		{
+			return false;
+		}
+
+		info = found->second;
+		return true;
+	}
+
+	/*
+	* Pulls the width and height out of a PNG's
+	* IHDR chunk, which always sits right after
+	* the 8 byte signature. Its fields are stored
+	* big endian. Anything that isn't a PNG gets
+	* recorded with a size of 0x0.
+	*/
+	bool ResourceManager::readImageHeader(std::string filepath, TextureInfo& info)
+	{
+		ArchivedImage archived;
+		if (m_Archive.Find(filepath, archived))
+		{
+			info = { archived.width, archived.height };
+			return true;
+		}
+
+		SDL_RWops* file = SDL_RWFromFile(filepath.c_str(), "rb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		Uint8 header[24];
+		size_t read = SDL_RWread(file, header, 1, sizeof(header));
+		SDL_RWclose(file);
+
+		const Uint8 pngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (read == sizeof(header) && SDL_memcmp(header, pngSignature, 8) == 0 && SDL_memcmp(header + 12, "IHDR", 4) == 0)
+		{
+			info.width = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+			info.height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+		}
+
+		return true;
+	}
+
 	void ResourceManager::unloadTexture(std::string name)
 	{
-		SDL_Texture* target = getSDLTexture(name);
+		// Atlas pages are shared, so those only go away with everything else
+		if (m_AtlasRegions.erase(name) > 0)
+		{
+			m_TextureInfo.erase(name);
+			return;
+		}
+
+		auto found = m_TextureHandles.find(name);
+		if (found == m_TextureHandles.end()) { return; }
+
+		// The name keeps its slot, so handles to it just draw the placeholder until it's loaded again
+		TextureResource& resource = m_TextureTable[found->second];
+		if (!isLoaded(resource)) { return; }
+
+		destroyTexture(resource);
+		if (resource.surface != nullptr)
+		{
+			SDL_FreeSurface(resource.surface);
+		}
 
-		if (target != nullptr)
+		if (resource.loading)
 		{
-			std::cout << "Unloaded texture " << name << std::endl;
-			SDL_DestroyTexture(target);
+			m_LoadingCount--;
 		}
+
+		resource = TextureResource();
+		resource.name = name;
+
+		std::cout << "Unloaded texture " << name << std::endl;
+		m_TextureInfo.erase(name);
 	}
 
 	void ResourceManager::unloadAllTextures()
 	{
-		for (auto i = m_Textures.begin(); i != m_Textures.end(); i++)
+		// Let the decode threads finish up first so nothing
+		// lands in the decoded list once we've emptied it,
+		// and the render thread finish any uploads it's on
+		m_DecodeQueue.reset();
+		if (!m_Headless)
+		{
+			Engine::getCoordinator()->GetSystem<RenderSystem>()->WaitForRenderThread();
+		}
+
+		for (DecodedTexture& decoded : m_Decoded)
+		{
+			if (decoded.image.surface != nullptr)
+			{
+				SDL_FreeSurface(decoded.image.surface);
+			}
+		}
+		m_Decoded.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(m_UploadMutex);
+			for (TextureUpload& upload : m_FinishedUploads)
+			{
+				if (upload.texture != nullptr)
+				{
+					postToRenderer([texture = upload.texture](SDL_Renderer*) { SDL_DestroyTexture(texture); });
+				}
+				m_PendingUploads.push_back(std::move(upload));
+			}
+
+			for (TextureUpload& upload : m_PendingUploads)
+			{
+				if (upload.image.surface != nullptr)
+				{
+					SDL_FreeSurface(upload.image.surface);
+				}
+			}
+
+			m_PendingUploads.clear();
+			m_FinishedUploads.clear();
+			m_UploadPosted = false;
+		}
+
+		if (m_Placeholder != nullptr)
+		{
+			postToRenderer([texture = m_Placeholder](SDL_Renderer*) { SDL_DestroyTexture(texture); });
+			m_Placeholder = nullptr;
+		}
+
+		m_AtlasRegions.clear();
+
+		for (TextureResource& resource : m_TextureTable)
+		{
+			unloadTexture(resource.name);
+		}
+
+		closeArchive();
+		closeDecodeCache();
+	}
+
+	bool ResourceManager::openDecodeCache()
+	{
+		if (!m_DecodeCacheEnabled) { return false; }
+
+		m_DecodeQueue.reset();
+		return m_DecodeCache.Open(m_DecodeCacheDirectory, m_DecodeCacheBudget);
+	}
+
+	void ResourceManager::closeDecodeCache()
+	{
+		m_DecodeQueue.reset();
+		m_DecodeCache.Close();
+	}
+
+	bool ResourceManager::openArchive(std::string filepath)
+	{
+		closeArchive();
+		return m_Archive.Open(filepath);
+	}
+
+	void ResourceManager::closeArchive()
+	{
+		if (!m_Archive.IsOpen()) { return; }
+
+		// Let any decode or upload still reading archived pixels finish first,
+		// then drop the loads they were for so nothing uploads from the old mapping
+		m_DecodeQueue.reset();
+		if (!m_Headless)
+		{
+			Engine::getCoordinator()->GetSystem<RenderSystem>()->WaitForRenderThread();
+		}
+
+		std::vector<std::string> dropped;
+		{
+			std::lock_guard<std::mutex> lock(m_DecodedMutex);
+			for (auto decoded = m_Decoded.begin(); decoded != m_Decoded.end();)
+			{
+				if (decoded->image.archived.pixels == nullptr) { ++decoded; continue; }
+
+				dropped.push_back(decoded->name);
+				SDL_FreeSurface(decoded->image.surface);
+				decoded = m_Decoded.erase(decoded);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_UploadMutex);
+			for (auto upload = m_PendingUploads.begin(); upload != m_PendingUploads.end();)
+			{
+				if (upload->image.archived.pixels == nullptr) { ++upload; continue; }
+
+				dropped.push_back(upload->name);
+				SDL_FreeSurface(upload->image.surface);
+				upload = m_PendingUploads.erase(upload);
+			}
+
+			// Already uploaded, these only need their records dropped so endFrame throws them out
+			for (const TextureUpload& upload : m_FinishedUploads)
+			{
+				if (upload.image.archived.pixels != nullptr)
+				{
+					dropped.push_back(upload.name);
+				}
+			}
+		}
+
+		for (const std::string& name : dropped)
+		{
+			unloadTexture(name);
+		}
+
+		for (TextureResource& resource : m_TextureTable)
+		{
+			if (resource.archived.pixels != nullptr)
+			{
+				unloadTexture(resource.name);
+			}
+		}
+
+		m_Archive.Close();
+	}
+
+	// Sorted, so the same assets always pack into the same archive
+	std::vector<std::string> ResourceManager::findImages(std::string directory)
+	{
+		std::error_code error;
+		std::vector<std::string> paths;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error))
 		{
-			unloadTexture(i->first);
+			if (entry.is_regular_file() && entry.path().extension() == ".png")
+			{
+				paths.push_back((std::filesystem::path(directory) / entry.path().filename()).generic_string());
+			}
 		}
+
+		if (error)
+		{
+			std::cout << "Unable to read asset directory " << directory << ": " << error.message() << std::endl;
+		}
+
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+
+	/*
+	* Decodes every PNG in the directory the same way
+	* a normal load would (color key and all) and
+	* writes them out as one archive, each keyed by
+	* the path it would be loaded from. Only needs
+	* SDL_image, not a window or renderer.
+	*/
+	bool ResourceManager::packAssets(std::string directory, std::string archivePath)
+	{
+		if (m_Archive.IsOpen())
+		{
+			std::cout << "Close the asset archive before packing a new one" << std::endl;
+			return false;
+		}
+
+		std::vector<std::pair<std::string, SDL_Surface*>> images;
+		for (const std::string& path : findImages(directory))
+		{
+			DecodedImage image = decodeFile(path);
+			if (image.surface != nullptr)
+			{
+				images.push_back({ path, image.surface });
+			}
+		}
+
+		bool packed = AssetArchive::Write(archivePath, images);
+
+		for (auto& image : images)
+		{
+			SDL_FreeSurface(image.second);
+		}
+
+		return packed;
 	}
 
 	void ResourceManager::loadPrimitives()
 	{
-		loadSDLTexture("assets/Square.png", "Square");
-		loadSDLTexture("assets/Circle.png", "Circle");
-		loadSDLTexture("assets/Triangle.png", "Triangle");
+		queuePrimitives();
+		finishQueuedTextures();
+	}
+
+	void ResourceManager::queuePrimitives()
+	{
+		queueTextureDecode("assets/Square.png", "Square");
+		queueTextureDecode("assets/Circle.png", "Circle");
+		queueTextureDecode("assets/Triangle.png", "Triangle");
 	}
 }
\ No newline at end of file
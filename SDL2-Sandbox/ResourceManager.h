@@ -2,20 +2,362 @@
 #include "SDL2/SDL.h"
 #include "SDL2/SDL_image.h"
 #include "Common.h"
+#include "Types.h"
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include "AssetArchive.h"
+#include "DecodeCache.h"
+#include "TaskQueue.h"
 
 namespace Funny
 {
+	/*
+	* What we know about a texture without
+	* needing the texture itself.
+	*/
+	struct TextureInfo
+	{
+		int width = 0;
+		int height = 0;
+	};
+
+	/*
+	* A texture as the rest of the engine sees it.
+	* Records live in a dense table, each at the
+	* TextureHandle its name was given the first
+	* time anything asked for it. A name keeps its
+	* handle for good (unloading only empties the
+	* record out), so handles stay safe to hold on
+	* to across unloads and reloads, and components
+	* store those rather than the SDL_Texture, which
+	* can come and go underneath them.
+	* 
+	* Every record keeps the source its texture
+	* was made from, either the file as it was on
+	* disk, its pixels in the asset archive, or
+	* (for textures we build ourselves, like atlas
+	* pages) the decoded pixels, so an
+	* evicted texture can be made again the next
+	* time something wants to draw it.
+	*/
+	struct TextureResource
+	{
+		std::string name;
+		SDL_Texture* texture = nullptr;		// Null while evicted
+		std::vector<uint8_t> encoded;		// The file's contents, when it came from one
+		ArchivedImage archived;				// Or its pixels in the asset archive
+		SDL_Surface* surface = nullptr;		// Otherwise the decoded pixels
+		size_t bytes = 0;					// What the texture takes up on the renderer
+		uint64_t lastUsed = 0;				// Frame it was last drawn (or handed out) on
+		bool pinned = false;				// Never evicted
+		bool loading = false;				// Still decoding or being uploaded
+	};
+
+	struct TextureResidencyStats
+	{
+		size_t textures = 0;		// Resident or not
+		size_t resident = 0;
+		size_t residentBytes = 0;
+		size_t budgetBytes = 0;		// 0 when there's no budget
+		uint64_t evictions = 0;
+		uint64_t reuploads = 0;
+		size_t loading = 0;			// Asynchronous loads still decoding or waiting on an upload
+		int uploadedLastFrame = 0;
+	};
+
+	/*
+	* The texture an image actually lives on and
+	* where on it. For atlased images that's a
+	* page shared with others, otherwise it's the
+	* image's own texture and its full size.
+	*/
+	struct TextureRegion
+	{
+		SDL_Texture* texture = nullptr;
+		SDL_Rect rect { 0, 0, 0, 0 };
+	};
+
 	class ResourceManager
 	{
 	public:
 		static SDL_Texture* loadSDLTexture(std::string filepath, std::string name);
-		static SDL_Texture* getSDLTexture(std::string name);
+		static SDL_Texture* getSDLTexture(const std::string& name);
+		static SDL_Texture* getSDLTexture(TextureHandle handle) { return useTexture(handle); }
+
+		/*
+		* Names only get looked up here, once, and
+		* everything after that goes through the handle.
+		* Asking for a name that isn't loaded yet still
+		* hands back its handle, which draws as the
+		* placeholder until something loads under that
+		* name. For an atlased image this is the handle
+		* of its atlas page (applyTexture works out the
+		* rect on it as well).
+		*/
+		static TextureHandle getTextureHandle(const std::string& name);
+		static bool getTextureInfo(std::string name, TextureInfo& info);
 		static void unloadTexture(std::string name);
 		static void unloadAllTextures();
 
 		static void loadPrimitives();
 
+		/*
+		* For textures we make ourselves rather than
+		* load from a file (like baked font pages).
+		* Takes ownership of the surface. Headless it
+		* just records the size and frees it.
+		*/
+		static SDL_Texture* loadTextureFromSurface(SDL_Surface* surface, std::string name);
+
+		/*
+		* Textures decoded through the queue get packed
+		* into shared atlas pages when they're finished,
+		* so sprites using different images can still be
+		* drawn in the same batch. getSDLTexture hands
+		* back the page for an atlased image, so anything
+		* sampling from it needs its source rect offset
+		* to match, which applyTexture does for us.
+		*/
+		static bool getTextureRegion(std::string name, TextureRegion& region);
+		static bool applyTexture(Renderable& renderable, std::string name);
+		static bool applyTexture(Renderable& renderable, std::string name, const SDL_Rect& localRect);
+
+		/*
+		* Texture memory is budgeted. Once the textures
+		* on the renderer add up to more than the budget,
+		* endFrame evicts whichever have gone longest
+		* without being drawn (never anything from the
+		* last couple of frames, the render thread may
+		* still be using it) until they fit again.
+		* 
+		* Drawing goes through useTexture, which marks
+		* the texture as used and makes it again if it
+		* was evicted (waiting on the render thread to
+		* do it). Raw SDL_Textures handed out by
+		* getSDLTexture are only good for the frame
+		* they were asked for in, anything holding on
+		* to one for longer (like getTextureRegion's
+		* callers) pins it for good.
+		*/
+		static void setTextureBudget(size_t bytes) { m_TextureBudget = bytes; }
+		static void setTexturePinned(const std::string& name, bool pinned);
+		static SDL_Texture* useTexture(TextureHandle handle)
+		{
+			if (handle >= m_TextureTable.size()) { return nullptr; }
+
+			TextureResource& resource = m_TextureTable[handle];
+			resource.lastUsed = m_CurrentFrame;
+			return (resource.texture != nullptr) ? resource.texture : reuploadTexture(resource);
+		}
+		static void endFrame();
+		static TextureResidencyStats getResidencyStats();
+
+		static void setAtlasEnabled(bool enabled) { m_AtlasEnabled = enabled; }
+		static void setAtlasLayout(int pageSize, int padding) { m_AtlasPageSize = pageSize; m_AtlasPadding = padding; }
+
+		/*
+		* Queued loads start decoding on a worker
+		* thread right away, letting the caller get
+		* on with other startup work (like creating
+		* the window) in the meantime. Uploading to
+		* the renderer has to wait for it to exist,
+		* finishQueuedTextures does that once it does.
+		* 
+		* Every texture's made and destroyed on the
+		* render thread, which owns the renderer. The
+		* calls here that hand back an SDL_Texture wait
+		* for it to be made, destroying never waits.
+		*/
+		static void queueTextureDecode(std::string filepath, std::string name);
+		static void queuePrimitives();
+		static void finishQueuedTextures();
+
+		/*
+		* Loads a texture without holding anything up.
+		* The record comes back right away (sized from
+		* the file's header when it's a PNG, so source
+		* rects work out as usual) and draws as the
+		* placeholder until its texture is ready.
+		* 
+		* Decoding happens on the decode threads, then
+		* endFrame hands whatever's finished to the
+		* render thread. That uploads only as much as
+		* fits in the upload budget before each frame
+		* (but always at least one texture, so loads
+		* can't stall), and the record picks up its
+		* texture in the first endFrame after.
+		*/
+		static TextureHandle loadTextureAsync(std::string filepath, std::string name);
+		static bool isTextureLoading(TextureHandle handle) { return handle < m_TextureTable.size() && m_TextureTable[handle].loading; }
+		static bool isAtlased(const std::string& name) { return m_AtlasRegions.find(name) != m_AtlasRegions.end(); }
+		static void setUploadBudget(float milliseconds) { m_UploadBudgetMs = milliseconds; }
+
+		/*
+		* With an archive open, any image in it gets
+		* loaded from there instead of its file (the
+		* archive's keyed by the same paths we load
+		* with), skipping decoding entirely. Closing
+		* it unloads everything that came out of it
+		* (queued decodes have to be finished first).
+		* 
+		* packAssets is the offline half, decoding
+		* every PNG in a directory into a new archive.
+		*/
+		static std::vector<std::string> findImages(std::string directory);
+
+		/*
+		* Images decoded from files get cached on disk
+		* (see DecodeCache), so the next launch can read
+		* their pixels back instead of decoding again.
+		* The cache is opened by the engine before it
+		* loads anything, with whatever directory and
+		* size limit were set beforehand. Opening and
+		* closing both wait on any decodes in flight.
+		*/
+		static void setDecodeCacheDirectory(std::string directory) { m_DecodeCacheDirectory = directory; }
+		static const std::string& getDecodeCacheDirectory() { return m_DecodeCacheDirectory; }
+		static void setDecodeCacheBudget(size_t bytes) { m_DecodeCacheBudget = bytes; }
+		static void setDecodeCacheEnabled(bool enabled) { m_DecodeCacheEnabled = enabled; }
+		static bool openDecodeCache();
+		static void closeDecodeCache();
+		static bool isDecodeCacheOpen() { return m_DecodeCache.IsOpen(); }
+		static DecodeCacheStats getDecodeCacheStats() { return m_DecodeCache.GetStats(); }
+		static bool openArchive(std::string filepath);
+		static void closeArchive();
+		static const AssetArchive& getArchive() { return m_Archive; }
+		static bool packAssets(std::string directory, std::string archivePath);
+
+		// A small checkerboard, drawn in place of textures that aren't loaded
+		static const int PLACEHOLDER_SIZE = 16;
+		static bool isPlaceholder(SDL_Texture* texture) { return texture != nullptr && texture == m_Placeholder; }
+
+		/*
+		* When headless there's no renderer to
+		* upload to, so texture loads only record
+		* the image's dimensions (read straight
+		* from the file header, no decoding) and
+		* hand back a null texture.
+		*/
+		static void setHeadless(bool headless) { m_Headless = headless; }
+		static bool isHeadless() { return m_Headless; }
+
 	private:
-		static std::unordered_map<std::string, SDL_Texture*> m_Textures;
+		// Atlas pages are in here too, under names no image can have
+		static std::vector<TextureResource> m_TextureTable;
+		static std::unordered_map<std::string, TextureHandle> m_TextureHandles;
+		static std::unordered_map<std::string, TextureInfo> m_TextureInfo;
+		static bool m_Headless;
+
+		static size_t m_TextureBudget;
+		static size_t m_ResidentBytes;
+		static uint64_t m_CurrentFrame;
+		static uint64_t m_Evictions;
+		static uint64_t m_Reuploads;
+
+		struct AtlasEntry
+		{
+			TextureHandle page;
+			SDL_Rect rect;
+		};
+
+		static bool m_AtlasEnabled;
+		static int m_AtlasPageSize;
+		static int m_AtlasPadding;
+		static int m_AtlasPageCount;
+		static std::unordered_map<std::string, AtlasEntry> m_AtlasRegions;
+
+		// Archived images come with a surface wrapped around their mapped pixels, for the atlas
+		struct DecodedImage
+		{
+			SDL_Surface* surface = nullptr;
+			std::vector<uint8_t> encoded;
+			ArchivedImage archived;
+		};
+
+		struct QueuedTexture
+		{
+			std::string filepath;
+			std::string name;
+			std::future<DecodedImage> image;
+		};
+		static std::vector<QueuedTexture> m_QueuedTextures;
+
+		/*
+		* Decode threads push what they've finished in
+		* here for endFrame to send off for uploading.
+		* Anything else about the load stays on the
+		* main thread.
+		*/
+		struct DecodedTexture
+		{
+			std::string filepath;
+			std::string name;
+			DecodedImage image;
+		};
+		static std::unique_ptr<TaskQueue> m_DecodeQueue;
+		static std::mutex m_DecodedMutex;
+		static std::vector<DecodedTexture> m_Decoded;
+		static size_t m_LoadingCount;
+		static float m_UploadBudgetMs;
+		static int m_UploadedLastFrame;
+		static SDL_Texture* m_Placeholder;
+		static AssetArchive m_Archive;
+
+		static DecodeCache m_DecodeCache;
+		static bool m_DecodeCacheEnabled;
+		static std::string m_DecodeCacheDirectory;
+		static size_t m_DecodeCacheBudget;
+
+		// Black is transparent in every image we load
+		static const Uint32 COLOR_KEY = 0x000000;
+
+		/*
+		* Decodes waiting on the render thread to upload
+		* them, and the textures it's made from them
+		* waiting on endFrame to pick them up. Both are
+		* shared with the render thread.
+		*/
+		struct TextureUpload
+		{
+			std::string filepath;
+			std::string name;
+			DecodedImage image;
+			SDL_Texture* texture = nullptr;
+			size_t bytes = 0;
+		};
+		static std::mutex m_UploadMutex;
+		static std::deque<TextureUpload> m_PendingUploads;
+		static std::vector<TextureUpload> m_FinishedUploads;
+		static bool m_UploadPosted;
+
+		static TaskQueue& getDecodeQueue();
+		static void uploadDecodedTextures();
+		static void uploadPending(SDL_Renderer* renderer); // Render thread only
+		static void collectUploads();
+		static SDL_Texture* getPlaceholder();
+
+		static void runOnRenderer(const std::function<void(SDL_Renderer*)>& task);
+		static void postToRenderer(std::function<void(SDL_Renderer*)> task);
+
+		static DecodedImage decodeFile(std::string filepath);
+		static SDL_Surface* decodeSurface(const std::vector<uint8_t>& encoded, std::string filepath);
+		// The createTexture calls are all for the render thread
+		static SDL_Texture* createTexture(SDL_Renderer* renderer, SDL_Surface* surface, size_t& bytes);
+		static SDL_Texture* createTexture(SDL_Renderer* renderer, const ArchivedImage& image, size_t& bytes);
+		static SDL_Texture* createTexture(SDL_Renderer* renderer, const DecodedImage& image, size_t& bytes);
+		static SDL_Texture* uploadImage(DecodedImage& image, std::string filepath, std::string name);
+		static SDL_Texture* storeTexture(DecodedImage& image, SDL_Texture* texture, size_t bytes, std::string filepath, std::string name);
+		static SDL_Texture* reuploadTexture(TextureResource& resource);
+		static void destroyTexture(TextureResource& resource);
+		static TextureHandle internTexture(const std::string& name);
+		static bool findTexture(const std::string& name, TextureHandle& handle, SDL_Rect& rect);
+		static bool isLoaded(const TextureResource& resource) { return resource.texture != nullptr || hasSource(resource) || resource.loading; }
+		static bool hasSource(const TextureResource& resource) { return resource.surface != nullptr || !resource.encoded.empty() || resource.archived.pixels != nullptr; }
+		static bool loadTextureStub(std::string filepath, std::string name);
+		static bool readImageHeader(std::string filepath, TextureInfo& info);
+		static void buildAtlas(std::vector<std::pair<QueuedTexture*, DecodedImage>>& decoded);
 	};
 }
@@ -0,0 +1,143 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace Funny
+{
+	void SpatialGrid::Insert(Entity entity, const SDL_FRect& bounds)
+	{
+		assert(entity < MAX_ENTITIES && "That ID is out of bounds!");
+
+		if (m_Entries[entity].active)
+		{
+			Update(entity, bounds);
+			return;
+		}
+
+		m_Entries[entity].active = true;
+		m_Entries[entity].bounds = bounds;
+		AddToCell(entity, CellOf(bounds));
+		m_Count++;
+
+		m_MaxHalfWidth = std::max(m_MaxHalfWidth, bounds.w * 0.5f);
+		m_MaxHalfHeight = std::max(m_MaxHalfHeight, bounds.h * 0.5f);
+	}
+
+	void SpatialGrid::Update(Entity entity, const SDL_FRect& bounds)
+	{
+		Entry& entry = m_Entries[entity];
+		if (!entry.active)
+		{
+			Insert(entity, bounds);
+			return;
+		}
+
+		entry.bounds = bounds;
+
+		int64_t cell = CellOf(bounds);
+		if (cell != entry.cell)
+		{
+			RemoveFromCell(entity);
+			AddToCell(entity, cell);
+		}
+
+		m_MaxHalfWidth = std::max(m_MaxHalfWidth, bounds.w * 0.5f);
+		m_MaxHalfHeight = std::max(m_MaxHalfHeight, bounds.h * 0.5f);
+	}
+
+	void SpatialGrid::Remove(Entity entity)
+	{
+		if (!m_Entries[entity].active) { return; }
+
+		RemoveFromCell(entity);
+		m_Entries[entity].active = false;
+		m_Count--;
+	}
+
+	void SpatialGrid::Clear()
+	{
+		for (Entry& entry : m_Entries)
+		{
+			entry.active = false;
+		}
+
+		m_Cells.clear();
+		m_Count = 0;
+		m_MaxHalfWidth = 0;
+		m_MaxHalfHeight = 0;
+	}
+
+	void SpatialGrid::Query(const SDL_FRect& area, std::vector<Entity>& results) const
+	{
+		// Grow the search by how far any entity can hang out of its cell
+		int minX = CellCoord(area.x - m_MaxHalfWidth);
+		int minY = CellCoord(area.y - m_MaxHalfHeight);
+		int maxX = CellCoord(area.x + area.w + m_MaxHalfWidth);
+		int maxY = CellCoord(area.y + area.h + m_MaxHalfHeight);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				auto cell = m_Cells.find(PackCell(x, y));
+				if (cell == m_Cells.end()) { continue; }
+
+				for (Entity entity : cell->second)
+				{
+					const SDL_FRect& bounds = m_Entries[entity].bounds;
+
+					if (bounds.x < area.x + area.w && bounds.x + bounds.w > area.x &&
+						bounds.y < area.y + area.h && bounds.y + bounds.h > area.y)
+					{
+						results.push_back(entity);
+					}
+				}
+			}
+		}
+	}
+
+	int SpatialGrid::CellCoord(float value) const
+	{
+		return (int)std::floor(value / m_CellSize);
+	}
+
+	int64_t SpatialGrid::CellOf(const SDL_FRect& bounds) const
+	{
+		return PackCell(CellCoord(bounds.x + bounds.w * 0.5f), CellCoord(bounds.y + bounds.h * 0.5f));
+	}
+
+	void SpatialGrid::AddToCell(Entity entity, int64_t cell)
+	{
+		std::vector<Entity>& entities = m_Cells[cell];
+
+		m_Entries[entity].cell = cell;
+		m_Entries[entity].slot = (int)entities.size();
+		entities.push_back(entity);
+	}
+
+	/*
+	* Same idea as our component arrays, we fill
+	* the hole with the last entity in the cell
+	* and fix up its slot. Empty cells are erased
+	* so the map only ever holds occupied cells.
+	*/
+	void SpatialGrid::RemoveFromCell(Entity entity)
+	{
+		Entry& entry = m_Entries[entity];
+
+		auto cell = m_Cells.find(entry.cell);
+		assert(cell != m_Cells.end() && "Entity's cell doesn't exist!");
+
+		std::vector<Entity>& entities = cell->second;
+		Entity last = entities.back();
+		entities[entry.slot] = last;
+		m_Entries[last].slot = entry.slot;
+		entities.pop_back();
+
+		if (entities.empty())
+		{
+			m_Cells.erase(cell);
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <SDL2/SDL.h>
+#include "Types.h"
+
+namespace Funny
+{
+	/*
+	* A loose grid for quickly finding every
+	* entity that overlaps a rectangle, which
+	* the RenderSystem uses to skip everything
+	* outside of the camera.
+	* 
+	* Each entity lives in exactly one cell, the
+	* one containing the center of its bounds.
+	* Since an entity can hang over the edge of
+	* its cell, queries grow the search area by
+	* the largest half size we've seen, then do
+	* an exact overlap test per candidate. That
+	* keeps inserts and moves simple since we
+	* never have to deal with an entity sitting
+	* in several cells at once.
+	* 
+	* Cells are stored sparsely in a hash map by
+	* their packed XY coordinate so the world can
+	* be as large as we want without allocating
+	* cells for empty space.
+	* 
+	* Updates are incremental. If an entity is
+	* still in the same cell we just store its
+	* new bounds, and only cell changes touch
+	* the cell lists at all.
+	*/
+	class SpatialGrid
+	{
+	public:
+		SpatialGrid(float cellSize = 256.0f) : m_CellSize(cellSize) {}
+
+		void Insert(Entity entity, const SDL_FRect& bounds);
+		void Update(Entity entity, const SDL_FRect& bounds);
+		void Remove(Entity entity);
+		void Clear();
+
+		bool Contains(Entity entity) const { return m_Entries[entity].active; }
+
+		// Appends every entity whose bounds overlap the area to results
+		void Query(const SDL_FRect& area, std::vector<Entity>& results) const;
+
+		size_t GetCount() const { return m_Count; }
+		size_t GetCellCount() const { return m_Cells.size(); }
+
+	private:
+		struct Entry
+		{
+			SDL_FRect bounds;
+			int64_t cell;
+			int slot;		// Where this entity sits in its cell's list, for O(1) removal
+			bool active;
+		};
+
+		float m_CellSize;
+		float m_MaxHalfWidth = 0;
+		float m_MaxHalfHeight = 0;
+		size_t m_Count = 0;
+
+		std::array<Entry, MAX_ENTITIES> m_Entries{};
+		std::unordered_map<int64_t, std::vector<Entity>> m_Cells;
+
+		int CellCoord(float value) const;
+		static int64_t PackCell(int x, int y) { return ((int64_t)x << 32) | (uint32_t)y; }
+		int64_t CellOf(const SDL_FRect& bounds) const;
+
+		void AddToCell(Entity entity, int64_t cell);
+		void RemoveFromCell(Entity entity);
+	};
+}
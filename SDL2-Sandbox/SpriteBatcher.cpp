@@ -0,0 +1,128 @@
+#include "SpriteBatcher.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace Funny
+{
+	void SpriteBatcher::Begin()
+	{
+		m_Sprites.clear();
+		m_Building = SpriteBatchStats();
+	}
+
+	void SpriteBatcher::Submit(SDL_Texture* texture, const SDL_Rect& src, const SDL_FRect& dst, const ColorRGBA& color)
+	{
+		if (texture == nullptr) { return; }
+
+		SDL_Color vertexColor
+		{
+			(Uint8)std::min<uint32>(color.r, 255),
+			(Uint8)std::min<uint32>(color.g, 255),
+			(Uint8)std::min<uint32>(color.b, 255),
+			(Uint8)std::min<uint32>(color.a, 255)
+		};
+
+		m_Sprites.push_back({ texture, src, dst, vertexColor });
+	}
+
+	/*
+	* Turns everything submitted since Begin into
+	* geometry and draws it, one call per run of
+	* sprites sharing a texture. Sprites are drawn
+	* in the order they were submitted.
+	*/
+	void SpriteBatcher::Flush(SDL_Renderer* renderer)
+	{
+		FUNNY_PROFILE_SCOPE("SpriteBatcher::Flush");
+
+		if (m_Sprites.empty())
+		{
+			m_Stats = m_Building;
+			return;
+		}
+
+		BuildIndices((int)m_Sprites.size());
+
+		m_Vertices.resize(m_Sprites.size() * 4);
+
+		size_t runStart = 0;
+		SDL_Texture* previousTexture = nullptr;
+		float texWidth = 1;
+		float texHeight = 1;
+
+		for (size_t i = 0; i < m_Sprites.size(); i++)
+		{
+			const Sprite& sprite = m_Sprites[i];
+
+			if (sprite.texture != previousTexture)
+			{
+				int w = 1;
+				int h = 1;
+				SDL_QueryTexture(sprite.texture, nullptr, nullptr, &w, &h);
+				texWidth = (float)w;
+				texHeight = (float)h;
+			}
+
+			float u0 = (float)sprite.src.x / texWidth;
+			float v0 = (float)sprite.src.y / texHeight;
+			float u1 = (float)(sprite.src.x + sprite.src.w) / texWidth;
+			float v1 = (float)(sprite.src.y + sprite.src.h) / texHeight;
+
+			float x0 = sprite.dst.x;
+			float y0 = sprite.dst.y;
+			float x1 = sprite.dst.x + sprite.dst.w;
+			float y1 = sprite.dst.y + sprite.dst.h;
+
+			SDL_Vertex* quad = &m_Vertices[i * 4];
+			quad[0] = { { x0, y0 }, sprite.color, { u0, v0 } };
+			quad[1] = { { x1, y0 }, sprite.color, { u1, v0 } };
+			quad[2] = { { x1, y1 }, sprite.color, { u1, v1 } };
+			quad[3] = { { x0, y1 }, sprite.color, { u0, v1 } };
+
+			// Submit the previous run once the texture changes
+			if (sprite.texture != previousTexture && i > 0)
+			{
+				size_t runCount = i - runStart;
+				SDL_RenderGeometry(renderer, previousTexture, &m_Vertices[runStart * 4], (int)(runCount * 4), m_Indices.data(), (int)(runCount * 6));
+				m_Building.drawCalls++;
+				m_Building.textureSwitches++;
+				runStart = i;
+			}
+
+			previousTexture = sprite.texture;
+		}
+
+		size_t runCount = m_Sprites.size() - runStart;
+		SDL_RenderGeometry(renderer, previousTexture, &m_Vertices[runStart * 4], (int)(runCount * 4), m_Indices.data(), (int)(runCount * 6));
+		m_Building.drawCalls++;
+
+		m_Building.sprites += (int)m_Sprites.size();
+		m_Stats = m_Building;
+		m_Sprites.clear();
+	}
+
+	/*
+	* Every quad uses the same two triangle pattern,
+	* and since each draw call gets a vertex pointer
+	* starting at its own first quad, one shared
+	* index buffer works for every run.
+	*/
+	void SpriteBatcher::BuildIndices(int spriteCount)
+	{
+		int builtSprites = (int)m_Indices.size() / 6;
+		if (builtSprites >= spriteCount) { return; }
+
+		m_Indices.resize((size_t)spriteCount * 6);
+		for (int i = builtSprites; i < spriteCount; i++)
+		{
+			int base = i * 4;
+			int* quad = &m_Indices[(size_t)i * 6];
+			quad[0] = base + 0;
+			quad[1] = base + 1;
+			quad[2] = base + 2;
+			quad[3] = base + 2;
+			quad[4] = base + 3;
+			quad[5] = base + 0;
+		}
+	}
+}
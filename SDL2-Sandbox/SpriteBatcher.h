@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <SDL2/SDL.h>
+#include "Color.h"
+
+namespace Funny
+{
+	/*
+	* Per frame numbers from the batcher so we
+	* can see how well things are batching. A
+	* texture switch is any time two neighbouring
+	* draw calls use a different texture.
+	*/
+	struct SpriteBatchStats
+	{
+		int sprites = 0;
+		int drawCalls = 0;
+		int textureSwitches = 0;
+	};
+
+	/*
+	* Drawing a sprite with SDL_RenderCopy means
+	* a draw call per sprite, plus a couple more
+	* state changes if we want to tint it. The
+	* batcher instead collects every sprite for
+	* the frame, groups them by texture and turns
+	* each group into one SDL_RenderGeometry call,
+	* with the tint baked into each vertex's color
+	* rather than set on the texture.
+	* 
+	* Sprites get drawn in the order they came in,
+	* so draw order is up to whoever submits them
+	* (the RenderSystem sorts by draw key, which
+	* already puts sprites sharing a texture next
+	* to each other).
+	*/
+	class SpriteBatcher
+	{
+	public:
+		void Begin();
+		void Submit(SDL_Texture* texture, const SDL_Rect& src, const SDL_FRect& dst, const ColorRGBA& color);
+		void Flush(SDL_Renderer* renderer);
+
+		const SpriteBatchStats& GetStats() const { return m_Stats; }
+
+	private:
+		struct Sprite
+		{
+			SDL_Texture* texture;
+			SDL_Rect src;
+			SDL_FRect dst;
+			SDL_Color color;
+		};
+
+		std::vector<Sprite> m_Sprites;
+		std::vector<SDL_Vertex> m_Vertices;
+		std::vector<int> m_Indices;
+
+		SpriteBatchStats m_Stats;
+		SpriteBatchStats m_Building;
+
+		void BuildIndices(int spriteCount);
+	};
+}
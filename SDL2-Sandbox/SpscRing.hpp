@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace Funny
+{
+	/*
+	* A fixed size queue between exactly one thread
+	* pushing and exactly one thread popping, with
+	* no locks. Neither side ever waits on the other,
+	* a full ring just refuses the push and an empty
+	* one refuses the pop, so it's up to the caller
+	* to decide whether to drop, retry or sleep.
+	*
+	* Head and tail only ever count up (wrapping is
+	* done by masking), which is why the capacity
+	* gets rounded up to a power of two. They sit
+	* on their own cache lines so the two threads
+	* aren't fighting over one.
+	*/
+	template <typename T>
+	class SpscRing
+	{
+	public:
+		SpscRing(size_t capacity = 0) { Reset(capacity); }
+
+		// Not safe while either side is using the ring
+		void Reset(size_t capacity)
+		{
+			size_t size = 1;
+			while (size < capacity)
+			{
+				size <<= 1;
+			}
+
+			m_Items.assign(size, T());
+			m_Mask = size - 1;
+			m_Head.store(0, std::memory_order_relaxed);
+			m_Tail.store(0, std::memory_order_relaxed);
+		}
+
+		// Producer side
+		bool TryPush(const T& item)
+		{
+			size_t head = m_Head.load(std::memory_order_relaxed);
+			if (head - m_Tail.load(std::memory_order_acquire) == m_Items.size()) { return false; }
+
+			m_Items[head & m_Mask] = item;
+			m_Head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side
+		bool TryPop(T& item)
+		{
+			size_t tail = m_Tail.load(std::memory_order_relaxed);
+			if (tail == m_Head.load(std::memory_order_acquire)) { return false; }
+
+			item = m_Items[tail & m_Mask];
+			m_Tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Only a snapshot, the other side may have moved on by the time it's used
+		size_t Size() const { return m_Head.load(std::memory_order_acquire) - m_Tail.load(std::memory_order_acquire); }
+		size_t Capacity() const { return m_Items.size(); }
+
+	private:
+		std::vector<T> m_Items;
+		size_t m_Mask = 0;
+
+		alignas(64) std::atomic<size_t> m_Head { 0 };
+		alignas(64) std::atomic<size_t> m_Tail { 0 };
+	};
+}
@@ -49,11 +49,32 @@ namespace Funny
 	* update all of their managed entities.
 	* This is called for all managed systems
 	* from the SystemManager and Coordinator.
+	* 
+	* Update runs once per fixed simulation tick,
+	* which can happen zero or several times per
+	* rendered frame. Draw runs once per frame
+	* with how far we are between the last tick
+	* and the next one (0-1), so anything that
+	* presents state can interpolate instead of
+	* snapping from tick to tick. Most systems
+	* don't draw, so it does nothing by default.
+	* 
+	* EntityAdded and EntityRemoved get called by
+	* the SystemManager whenever an Entity actually
+	* joins or leaves our managed set, for systems
+	* that keep their own structures in sync with
+	* it (like the RenderSystem's spatial index).
+	* By the time EntityRemoved is called the
+	* Entity's components may already be gone, so
+	* it shouldn't try to read them.
 	*/
 	class System
 	{
 	public:
 		virtual void Update() = 0;
+		virtual void Draw(float /*alpha*/) {}
+		virtual void EntityAdded(Entity /*entity*/) {}
+		virtual void EntityRemoved(Entity /*entity*/) {}
 		std::set<Entity> m_ManagedEntities{};
 	};
 }
\ No newline at end of file
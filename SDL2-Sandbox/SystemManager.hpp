@@ -1,8 +1,10 @@
 #pragma once
 #include <unordered_map>
 #include <memory>
+#include <string>
 
 #include "System.hpp"
+#include "Profiler.h"
 
 namespace Funny
 {
@@ -38,6 +40,7 @@ namespace Funny
 
 			std::shared_ptr<T> sys = std::make_shared<T>();
 			m_Systems[typeName] = sys;
+			m_DrawScopeNames[typeName] = std::string(typeName) + "::Draw";
 			return sys;
 		}
 
@@ -86,7 +89,10 @@ namespace Funny
 			{
 				auto const& sys = sysEntry.second;
 
-				sys->m_ManagedEntities.erase(entity);
+				if (sys->m_ManagedEntities.erase(entity) > 0)
+				{
+					sys->EntityRemoved(entity);
+				}
 			}
 		}
 
@@ -109,29 +115,50 @@ namespace Funny
 				// system's signature, add it to the system
 				if ((signature & sysSignature) == sysSignature)
 				{
-					sys->m_ManagedEntities.insert(entity);
+					if (sys->m_ManagedEntities.insert(entity).second)
+					{
+						sys->EntityAdded(entity);
+					}
 				}
 
 				// Otherwise, remove it
 				else
 				{
-					sys->m_ManagedEntities.erase(entity);
+					if (sys->m_ManagedEntities.erase(entity) > 0)
+					{
+						sys->EntityRemoved(entity);
+					}
 				}
 
 				// Once again, sets don't require that additional
-				// check to see if an Entity exists within it.
+				// check to see if an Entity exists within it, but
+				// we do look at the result so we only notify the
+				// system when its set actually changed.
 			}
 		}
 
-		// Loops through each of our systems and runs their update loop
+		// Loops through each of our systems and runs their update loop,
+		// timing each one under its type name for the profiler
 		void UpdateSystems()
 		{
 			for (auto const& sys : m_Systems)
 			{
+				FUNNY_PROFILE_SCOPE(sys.first);
 				sys.second->Update();
 			}
 		}
 
+		// Loops through each of our systems and lets them draw,
+		// which happens once per frame rather than once per tick
+		void DrawSystems(float alpha)
+		{
+			for (auto const& sys : m_Systems)
+			{
+				FUNNY_PROFILE_SCOPE(m_DrawScopeNames[sys.first].c_str());
+				sys.second->Draw(alpha);
+			}
+		}
+
 	private:
 		/* 
 		* Unordered maps to track the signatures
@@ -143,5 +170,9 @@ namespace Funny
 		*/
 		std::unordered_map<const char*, Signature> m_Signatures;
 		std::unordered_map<const char*, std::shared_ptr<System>> m_Systems;
+
+		// Profiler scope names for each system's Draw, built once on
+		// registration so the profiler always gets the same stable pointer
+		std::unordered_map<const char*, std::string> m_DrawScopeNames;
 	};
 }
\ No newline at end of file
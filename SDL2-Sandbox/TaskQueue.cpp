@@ -0,0 +1,71 @@
+#include "TaskQueue.h"
+
+#include <algorithm>
+
+namespace Funny
+{
+	TaskQueue::TaskQueue(int threads)
+	{
+		if (threads <= 0)
+		{
+			threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+		}
+
+		for (int i = 0; i < threads; i++)
+		{
+			m_Workers.push_back(std::thread(&TaskQueue::WorkerMain, this));
+		}
+	}
+
+	TaskQueue::~TaskQueue()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_Condition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void TaskQueue::Push(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Tasks.push_back(std::move(task));
+		}
+		m_Condition.notify_one();
+	}
+
+	size_t TaskQueue::GetPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Tasks.size() + m_Running;
+	}
+
+	void TaskQueue::WorkerMain()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (true)
+		{
+			m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+
+			// Stopping still empties the queue before anyone leaves
+			if (m_Tasks.empty()) { return; }
+
+			std::function<void()> task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+			m_Running++;
+
+			lock.unlock();
+			task();
+			lock.lock();
+
+			m_Running--;
+		}
+	}
+}
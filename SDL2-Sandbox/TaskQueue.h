@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Funny
+{
+	/*
+	* Threads that work through a queue of tasks in
+	* the background, for jobs that take a while
+	* and don't need to be waited on (decoding an
+	* image off disk for example). Unlike the
+	* WorkerPool nothing blocks here, Push returns
+	* right away and whoever pushed the task hears
+	* back however the task itself arranges.
+	*
+	* Tasks run in the order they were pushed, but
+	* with more than one thread they can finish in
+	* any order. Destroying the queue finishes off
+	* everything already pushed first.
+	*/
+	class TaskQueue
+	{
+	public:
+		// 0 threads leaves one hardware thread for the caller
+		TaskQueue(int threads = 0);
+		~TaskQueue();
+
+		TaskQueue(const TaskQueue&) = delete;
+		TaskQueue& operator=(const TaskQueue&) = delete;
+
+		void Push(std::function<void()> task);
+
+		// Pushed but not finished, only a snapshot
+		size_t GetPendingCount();
+		int GetThreadCount() const { return (int)m_Workers.size(); }
+
+	private:
+		std::deque<std::function<void()>> m_Tasks;
+		size_t m_Running = 0;
+
+		std::vector<std::thread> m_Workers;
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool m_Stopping = false;
+
+		void WorkerMain();
+	};
+}
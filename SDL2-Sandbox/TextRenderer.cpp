@@ -0,0 +1,267 @@
+#include "TextRenderer.h"
+#include "ResourceManager.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+// ImGui compiles its copy of stb_truetype as static, so we need our own
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "ImGui/imstb_truetype.h"
+
+namespace Funny
+{
+	static const int FIRST_GLYPH = 32;
+	static const int GLYPH_COUNT = 95;		// Space through tilde
+	static const int MAX_PAGE_SIZE = 2048;
+
+	struct TextRenderer::Font
+	{
+		std::vector<unsigned char> data;	// stb_truetype reads from this for as long as the font is loaded
+		stbtt_fontinfo info;
+		stbtt_bakedchar glyphs[GLYPH_COUNT];
+		float scale;
+		float ascent;
+		float lineHeight;
+		std::string textureName;
+		SDL_Texture* texture;
+	};
+
+	std::unordered_map<std::string, std::unique_ptr<TextRenderer::Font>> TextRenderer::m_Fonts;
+	std::vector<TextRenderer::TextEntry> TextRenderer::m_Texts;
+	std::vector<uint32_t> TextRenderer::m_FreeTexts;
+	uint64_t TextRenderer::m_LayoutsBuilt = 0;
+
+	/*
+	* The page starts small and doubles until every
+	* glyph fits, so small fonts don't waste memory
+	* on a mostly empty texture.
+	*/
+	bool TextRenderer::loadFont(std::string name, std::string filepath, float pixelHeight)
+	{
+		FUNNY_PROFILE_SCOPE("LoadFont");
+
+		if (m_Fonts.find(name) != m_Fonts.end())
+		{
+			std::cout << "Font " << name << " is already loaded." << std::endl;
+			return true;
+		}
+
+		std::ifstream file(filepath, std::ios::in | std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cout << "Unable to open font at path " << filepath << std::endl;
+			return false;
+		}
+
+		std::unique_ptr<Font> font = std::make_unique<Font>();
+		font->data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+		int offset = stbtt_GetFontOffsetForIndex(font->data.data(), 0);
+		if (offset < 0 || !stbtt_InitFont(&font->info, font->data.data(), offset))
+		{
+			std::cout << "Unable to read font at path " << filepath << std::endl;
+			return false;
+		}
+
+		int pageSize = 128;
+		std::vector<unsigned char> coverage;
+		while (true)
+		{
+			coverage.assign(pageSize * pageSize, 0);
+			if (stbtt_BakeFontBitmap(font->data.data(), offset, pixelHeight, coverage.data(), pageSize, pageSize, FIRST_GLYPH, GLYPH_COUNT, font->glyphs) > 0)
+			{
+				break;
+			}
+
+			pageSize *= 2;
+			if (pageSize > MAX_PAGE_SIZE)
+			{
+				std::cout << "Font " << name << " at " << pixelHeight << " pixels doesn't fit on a glyph page." << std::endl;
+				return false;
+			}
+		}
+
+		int ascent, descent, lineGap;
+		stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &lineGap);
+		font->scale = stbtt_ScaleForPixelHeight(&font->info, pixelHeight);
+		font->ascent = (float)ascent * font->scale;
+		font->lineHeight = (float)(ascent - descent + lineGap) * font->scale;
+
+		SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat(0, pageSize, pageSize, 32, SDL_PIXELFORMAT_RGBA32);
+		if (page == nullptr)
+		{
+			std::cout << "Unable to create glyph page for font " << name << std::endl;
+			return false;
+		}
+
+		for (int y = 0; y < pageSize; y++)
+		{
+			Uint32* row = (Uint32*)((Uint8*)page->pixels + y * page->pitch);
+			for (int x = 0; x < pageSize; x++)
+			{
+				row[x] = SDL_MapRGBA(page->format, 255, 255, 255, coverage[y * pageSize + x]);
+			}
+		}
+
+		font->textureName = "Font:" + name;
+		font->texture = ResourceManager::loadTextureFromSurface(page, font->textureName);
+
+		m_Fonts[name] = std::move(font);
+
+		// Anything made before the font showed up can be laid out now
+		for (TextEntry& entry : m_Texts)
+		{
+			if (entry.alive && entry.font == name)
+			{
+				layoutText(entry);
+			}
+		}
+
+		return true;
+	}
+
+	void TextRenderer::unloadFont(std::string name)
+	{
+		auto found = m_Fonts.find(name);
+		if (found == m_Fonts.end()) { return; }
+
+		ResourceManager::unloadTexture(found->second->textureName);
+		m_Fonts.erase(found);
+
+		for (TextEntry& entry : m_Texts)
+		{
+			if (entry.alive && entry.font == name)
+			{
+				entry.layout = TextLayout();
+			}
+		}
+	}
+
+	void TextRenderer::unloadAllFonts()
+	{
+		while (!m_Fonts.empty())
+		{
+			unloadFont(m_Fonts.begin()->first);
+		}
+	}
+
+	uint32_t TextRenderer::createText(std::string font, const std::string& text)
+	{
+		uint32_t textID;
+		if (!m_FreeTexts.empty())
+		{
+			textID = m_FreeTexts.back();
+			m_FreeTexts.pop_back();
+		}
+		else
+		{
+			textID = (uint32_t)m_Texts.size();
+			m_Texts.emplace_back();
+		}
+
+		TextEntry& entry = m_Texts[textID];
+		entry.alive = true;
+		entry.font = font;
+		entry.text = text;
+		layoutText(entry);
+
+		return textID;
+	}
+
+	bool TextRenderer::setText(uint32_t textID, const std::string& text)
+	{
+		if (textID >= m_Texts.size() || !m_Texts[textID].alive) { return false; }
+
+		TextEntry& entry = m_Texts[textID];
+		if (entry.text != text)
+		{
+			entry.text = text;
+			layoutText(entry);
+		}
+
+		return true;
+	}
+
+	void TextRenderer::destroyText(uint32_t textID)
+	{
+		if (textID >= m_Texts.size() || !m_Texts[textID].alive) { return; }
+
+		m_Texts[textID] = TextEntry();
+		m_FreeTexts.push_back(textID);
+	}
+
+	const TextLayout* TextRenderer::getLayout(uint32_t textID)
+	{
+		if (textID >= m_Texts.size() || !m_Texts[textID].alive) { return nullptr; }
+		return &m_Texts[textID].layout;
+	}
+
+	/*
+	* Lays glyphs out left to right along a baseline,
+	* kerning between pairs and starting a new line
+	* on '\n'. Anything outside printable ASCII gets
+	* drawn as a question mark. Glyph positions are
+	* rounded to whole pixels so text stays sharp.
+	*/
+	void TextRenderer::layoutText(TextEntry& entry)
+	{
+		TextLayout& layout = entry.layout;
+		layout.glyphs.clear();
+		layout.width = 0;
+		layout.height = 0;
+
+		auto found = m_Fonts.find(entry.font);
+		if (found == m_Fonts.end())
+		{
+			layout.texture = nullptr;
+			return;
+		}
+
+		const Font& font = *found->second;
+		layout.texture = font.texture;
+		m_LayoutsBuilt++;
+		layout.version = (uint32_t)m_LayoutsBuilt;
+
+		float x = 0;
+		float baseline = font.ascent;
+		int previous = 0;
+
+		for (unsigned char c : entry.text)
+		{
+			if (c == '\n')
+			{
+				layout.width = std::max(layout.width, x);
+				x = 0;
+				baseline += font.lineHeight;
+				previous = 0;
+				continue;
+			}
+
+			int codepoint = (c >= FIRST_GLYPH && c < FIRST_GLYPH + GLYPH_COUNT) ? c : '?';
+			if (previous != 0)
+			{
+				x += (float)stbtt_GetCodepointKernAdvance(&font.info, previous, codepoint) * font.scale;
+			}
+
+			const stbtt_bakedchar& glyph = font.glyphs[codepoint - FIRST_GLYPH];
+			int w = glyph.x1 - glyph.x0;
+			int h = glyph.y1 - glyph.y0;
+			if (w > 0 && h > 0)
+			{
+				GlyphQuad quad;
+				quad.src = SDL_Rect { glyph.x0, glyph.y0, w, h };
+				quad.dst = SDL_FRect { std::floor(x + glyph.xoff + 0.5f), std::floor(baseline + glyph.yoff + 0.5f), (float)w, (float)h };
+				layout.glyphs.push_back(quad);
+			}
+
+			x += glyph.xadvance;
+			previous = codepoint;
+		}
+
+		layout.width = std::max(layout.width, x);
+		layout.height = baseline - font.ascent + font.lineHeight;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <memory>
+#include <SDL2/SDL.h>
+#include "Common.h"
+
+namespace Funny
+{
+	// One glyph of a laid out string, dst is relative to the string's top left
+	struct GlyphQuad
+	{
+		SDL_Rect src;
+		SDL_FRect dst;
+	};
+
+	struct TextLayout
+	{
+		SDL_Texture* texture = nullptr;		// The font's glyph page
+		std::vector<GlyphQuad> glyphs;
+		float width = 0;
+		float height = 0;
+		uint32_t version = 0;				// Different every time the layout gets rebuilt
+	};
+
+	/*
+	* Bitmap font text, for the damage numbers and
+	* name tags ImGui is no good for.
+	* 
+	* Loading a font bakes its printable ASCII glyphs
+	* into a single page (white, with coverage in
+	* alpha, so the sprite tint colors it) using our
+	* own copy of stb_truetype. Strings get laid out
+	* once into glyph quads when they're created and
+	* again only when their text actually changes, so
+	* thousands of mostly static labels cost nothing
+	* to keep around. Drawing is left to the Render
+	* System, which turns the cached quads into plain
+	* sprites so text batches along with everything
+	* else.
+	* 
+	* Like the ResourceManager this is all static,
+	* and only meant to be used from the main thread.
+	*/
+	class TextRenderer
+	{
+	public:
+		static const uint32_t INVALID_TEXT = 0xFFFFFFFF;
+
+		static bool loadFont(std::string name, std::string filepath, float pixelHeight);
+		static void unloadFont(std::string name);
+		static void unloadAllFonts();
+
+		static uint32_t createText(std::string font, const std::string& text);
+		static bool setText(uint32_t textID, const std::string& text);
+		static void destroyText(uint32_t textID);
+		static const TextLayout* getLayout(uint32_t textID);
+
+		static size_t getTextCount() { return m_Texts.size() - m_FreeTexts.size(); }
+		static uint64_t getLayoutsBuilt() { return m_LayoutsBuilt; }
+
+	private:
+		struct Font;
+
+		struct TextEntry
+		{
+			bool alive = false;
+			std::string font;
+			std::string text;
+			TextLayout layout;
+		};
+
+		static std::unordered_map<std::string, std::unique_ptr<Font>> m_Fonts;
+		static std::vector<TextEntry> m_Texts;
+		static std::vector<uint32_t> m_FreeTexts;
+		static uint64_t m_LayoutsBuilt;
+
+		static void layoutText(TextEntry& entry);
+	};
+}
@@ -0,0 +1,186 @@
+#include "TextureAtlas.h"
+#include "Profiler.h"
+#include <algorithm>
+
+// ImGui compiles its copy of stb_rect_pack as static, so we need our own
+#define STB_RECT_PACK_IMPLEMENTATION
+#define STBRP_STATIC
+#include "ImGui/imstb_rectpack.h"
+
+namespace Funny
+{
+	TextureAtlas::~TextureAtlas()
+	{
+		for (Image& image : m_Images)
+		{
+			SDL_FreeSurface(image.surface);
+		}
+
+		for (SDL_Surface* page : m_Pages)
+		{
+			SDL_FreeSurface(page);
+		}
+	}
+
+	/*
+	* Everything gets converted to 32 bit RGBA up
+	* front so copying into a page is just moving
+	* pixels around. Any color key on the surface
+	* gets turned into transparent alpha by SDL
+	* during the conversion.
+	*/
+	bool TextureAtlas::Add(std::string name, SDL_Surface* surface)
+	{
+		if (surface == nullptr) { return false; }
+
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+		if (converted == nullptr)
+		{
+			std::cout << "Unable to convert " << name << " for the texture atlas! SDL Error: " << SDL_GetError() << std::endl;
+			return false;
+		}
+
+		m_Images.push_back({ name, converted });
+		return true;
+	}
+
+	/*
+	* Packs as much as fits onto a page, then starts
+	* a new one for whatever was left over, until
+	* everything is placed. Each page is trimmed down
+	* to the area it actually used afterwards so a
+	* mostly empty last page doesn't cost a full
+	* page worth of memory.
+	*/
+	void TextureAtlas::Build()
+	{
+		FUNNY_PROFILE_SCOPE("BuildTextureAtlas");
+
+		std::vector<stbrp_rect> remaining;
+		for (size_t i = 0; i < m_Images.size(); i++)
+		{
+			stbrp_rect rect {};
+			rect.id = (int)i;
+			rect.w = m_Images[i].surface->w + m_Padding * 2;
+			rect.h = m_Images[i].surface->h + m_Padding * 2;
+
+			if (rect.w > m_PageSize || rect.h > m_PageSize)
+			{
+				m_Rejected.push_back(m_Images[i].name);
+				continue;
+			}
+
+			remaining.push_back(rect);
+		}
+
+		std::vector<stbrp_node> nodes(m_PageSize);
+
+		while (!remaining.empty())
+		{
+			stbrp_context context;
+			stbrp_init_target(&context, m_PageSize, m_PageSize, nodes.data(), (int)nodes.size());
+			stbrp_pack_rects(&context, remaining.data(), (int)remaining.size());
+
+			std::vector<stbrp_rect> packed;
+			std::vector<stbrp_rect> leftover;
+			for (const stbrp_rect& rect : remaining)
+			{
+				(rect.was_packed ? packed : leftover).push_back(rect);
+			}
+
+			// Every rect fits on an empty page by itself, so this shouldn't happen
+			if (packed.empty()) { break; }
+
+			AtlasPageStats stats;
+			int usedArea = 0;
+			for (const stbrp_rect& rect : packed)
+			{
+				stats.width = std::max(stats.width, rect.x + rect.w);
+				stats.height = std::max(stats.height, rect.y + rect.h);
+
+				SDL_Surface* image = m_Images[rect.id].surface;
+				usedArea += image->w * image->h;
+			}
+			stats.images = (int)packed.size();
+			stats.fill = (float)usedArea / (float)(stats.width * stats.height);
+
+			SDL_Surface* page = SDL_CreateRGBSurfaceWithFormat(0, stats.width, stats.height, 32, SDL_PIXELFORMAT_RGBA32);
+			if (page == nullptr)
+			{
+				std::cout << "Unable to create texture atlas page! SDL Error: " << SDL_GetError() << std::endl;
+				break;
+			}
+			SDL_FillRect(page, nullptr, 0);
+
+			int pageIndex = (int)m_Pages.size();
+			for (const stbrp_rect& rect : packed)
+			{
+				const Image& image = m_Images[rect.id];
+				CopyWithBleed(image.surface, page, rect.x + m_Padding, rect.y + m_Padding);
+
+				m_Regions[image.name] = AtlasRegion { pageIndex, SDL_Rect { rect.x + m_Padding, rect.y + m_Padding, image.surface->w, image.surface->h } };
+			}
+
+			m_Pages.push_back(page);
+			m_PageStats.push_back(stats);
+
+			remaining.swap(leftover);
+		}
+
+		for (const stbrp_rect& rect : remaining)
+		{
+			m_Rejected.push_back(m_Images[rect.id].name);
+		}
+	}
+
+	bool TextureAtlas::GetRegion(std::string name, AtlasRegion& region) const
+	{
+		auto found = m_Regions.find(name);
+		if (found == m_Regions.end())
+		{
+			return false;
+		}
+
+		region = found->second;
+		return true;
+	}
+
+	/*
+	* Copies the image in row by row, then stretches
+	* its outermost rows and columns out across the
+	* padding. Corners get filled by extending the
+	* already extended rows sideways.
+	*/
+	void TextureAtlas::CopyWithBleed(SDL_Surface* image, SDL_Surface* page, int x, int y)
+	{
+		SDL_LockSurface(image);
+		SDL_LockSurface(page);
+
+		auto pixelAt = [](SDL_Surface* surface, int px, int py) -> Uint32*
+		{
+			return (Uint32*)((Uint8*)surface->pixels + py * surface->pitch) + px;
+		};
+
+		for (int row = 0; row < image->h; row++)
+		{
+			Uint32* destination = pixelAt(page, x, y + row);
+			SDL_memcpy(destination, pixelAt(image, 0, row), image->w * sizeof(Uint32));
+
+			for (int i = 1; i <= m_Padding; i++)
+			{
+				destination[-i] = destination[0];
+				destination[image->w - 1 + i] = destination[image->w - 1];
+			}
+		}
+
+		int rowWidth = (image->w + m_Padding * 2) * sizeof(Uint32);
+		for (int i = 1; i <= m_Padding; i++)
+		{
+			SDL_memcpy(pixelAt(page, x - m_Padding, y - i), pixelAt(page, x - m_Padding, y), rowWidth);
+			SDL_memcpy(pixelAt(page, x - m_Padding, y + image->h - 1 + i), pixelAt(page, x - m_Padding, y + image->h - 1), rowWidth);
+		}
+
+		SDL_UnlockSurface(page);
+		SDL_UnlockSurface(image);
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <SDL2/SDL.h>
+
+namespace Funny
+{
+	/*
+	* Where an image ended up once packed,
+	* as the page it's on and its rect there.
+	*/
+	struct AtlasRegion
+	{
+		int page = 0;
+		SDL_Rect rect { 0, 0, 0, 0 };
+	};
+
+	struct AtlasPageStats
+	{
+		int width = 0;
+		int height = 0;
+		int images = 0;
+		float fill = 0;		// How much of the page is actual image rather than padding or empty space
+	};
+
+	/*
+	* Packs a bunch of decoded images into as few
+	* large pages as it can, so sprites that used to
+	* each have their own texture can share one and
+	* batch together.
+	* 
+	* Packing is done by stb_rect_pack. Every image
+	* gets a border of padding around it, and the
+	* image's edge pixels are copied out into that
+	* border. That way any filtering or rounding that
+	* samples slightly outside an image's rect picks
+	* up its own edge color rather than bleeding in
+	* its neighbour.
+	* 
+	* This is all CPU side, pages are just surfaces
+	* until someone uploads them. Images that can't
+	* fit on a page at all are skipped and reported
+	* back through GetRejected.
+	*/
+	class TextureAtlas
+	{
+	public:
+		TextureAtlas(int pageSize = 2048, int padding = 2) : m_PageSize(pageSize), m_Padding(padding) {}
+		~TextureAtlas();
+
+		// Copies the surface, so the caller keeps ownership of theirs
+		bool Add(std::string name, SDL_Surface* surface);
+		void Build();
+
+		const std::vector<SDL_Surface*>& GetPages() const { return m_Pages; }
+		std::vector<SDL_Surface*> ReleasePages() { return std::move(m_Pages); } // Caller frees them from then on
+		const std::vector<AtlasPageStats>& GetPageStats() const { return m_PageStats; }
+		const std::vector<std::string>& GetRejected() const { return m_Rejected; }
+		bool GetRegion(std::string name, AtlasRegion& region) const;
+
+	private:
+		struct Image
+		{
+			std::string name;
+			SDL_Surface* surface;
+		};
+
+		int m_PageSize;
+		int m_Padding;
+
+		std::vector<Image> m_Images;
+		std::vector<SDL_Surface*> m_Pages;
+		std::vector<AtlasPageStats> m_PageStats;
+		std::vector<std::string> m_Rejected;
+		std::unordered_map<std::string, AtlasRegion> m_Regions;
+
+		void CopyWithBleed(SDL_Surface* image, SDL_Surface* page, int x, int y);
+	};
+}
@@ -1,50 +1,139 @@
 #include "Tilemap.h"
 #include "ResourceManager.h"
+#include <algorithm>
 #include <cassert>
 
 namespace Funny
 {
-	void Tilemap::loadMap()
+	void Tilemap::loadMap(const TilemapLayout& layout)
 	{
-		m_GridData.xBounds = 10;
-		m_GridData.yBounds = 5;
+		std::unique_lock<std::mutex> lock = Lock();
+
+		m_GridData.xBounds = layout.columns;
+		m_GridData.yBounds = layout.rows;
 		m_GridData.tileCount = m_GridData.xBounds * m_GridData.yBounds;
 		m_GridData.transform.position = Vector2(0, 0);
-		m_GridData.transform.scale = Vector2(50, 50);
+		m_GridData.transform.scale = Vector2(layout.tileSize, layout.tileSize);
 
-		m_RenderData.texture = ResourceManager::getSDLTexture("CaveTileset");
-		m_RenderData.xBounds = 16;
-		m_RenderData.yBounds = 5;
-		m_RenderData.tileWidth = 16;
-		m_RenderData.tileHeight = 16;
+		TextureRegion sheet;
+		ResourceManager::getTextureRegion(layout.sheet, sheet);
+		m_RenderData.texture = sheet.texture;
+		m_RenderData.sheetOrigin = SDL_Point { sheet.rect.x, sheet.rect.y };
+		m_RenderData.xBounds = layout.sheetColumns;
+		m_RenderData.yBounds = layout.sheetRows;
+		m_RenderData.tileWidth = layout.tileWidth;
+		m_RenderData.tileHeight = layout.tileHeight;
 		m_RenderData.tileCount = m_RenderData.xBounds * m_RenderData.yBounds;
 
-		std::string test = "2222222222222222222222222";
+		m_ActiveTileCount = 0;
+		m_TileIDToIndex.clear();
+		m_IndexToTileID.clear();
+		m_DenseSprites.assign(m_GridData.tileCount, EMPTY_TILE);
+		m_DenseCollision.assign(m_GridData.tileCount, NONE);
+		m_CollisionVersion++;
+		BuildSourceRects();
+
+		m_ChunkColumns = (m_GridData.xBounds + CHUNK_TILES - 1) / CHUNK_TILES;
+		m_ChunkRows = (m_GridData.yBounds + CHUNK_TILES - 1) / CHUNK_TILES;
+		m_ChunkVersions.assign(m_ChunkColumns * m_ChunkRows, ++m_NextChunkVersion);
+		lock.unlock();
 
-		for (int i = 0; i < m_GridData.tileCount; i++)
+		int tileCount = std::min((int)layout.tiles.size(), m_GridData.tileCount);
+		for (int i = 0; i < tileCount; i++)
 		{
-			AddTile(TileIDToGrid(i), i);
+			if (layout.tiles[i] != EMPTY_TILE)
+			{
+				TileCollisionType collision = i < (int)layout.collision.size() ? layout.collision[i] : NONE;
+				AddTile(TileIDToGrid(i), layout.tiles[i], collision);
+			}
 		}
 	}
 
+	/*
+	* Leaves an empty map with no sheet, which the
+	* renderer skips. The sheet's texture is the
+	* caller's to unload.
+	*/
 	void Tilemap::unloadMap()
 	{
+		std::unique_lock<std::mutex> lock = Lock();
+
+		m_RenderData.texture = nullptr;
+		m_RenderData.tileCount = 0;
+		m_GridData.xBounds = 0;
+		m_GridData.yBounds = 0;
+		m_GridData.tileCount = 0;
 
+		m_ActiveTileCount = 0;
+		m_TileIDToIndex.clear();
+		m_IndexToTileID.clear();
+		m_DenseSprites.clear();
+		m_DenseCollision.clear();
+		m_SourceRects.clear();
+		m_CollisionVersion++;
+
+		m_ChunkColumns = 0;
+		m_ChunkRows = 0;
+		m_ChunkVersions.clear();
+	}
+
+	/*
+	* Sprite IDs go left to right, top to bottom
+	* across the sheet, so this is the same math
+	* the renderer used to do for every tile every
+	* frame, just done once per sheet instead.
+	*/
+	void Tilemap::BuildSourceRects()
+	{
+		m_SourceRects.resize(m_RenderData.tileCount);
+
+		for (int spriteID = 0; spriteID < m_RenderData.tileCount; spriteID++)
+		{
+			m_SourceRects[spriteID] = SDL_Rect
+			{
+				m_RenderData.sheetOrigin.x + (spriteID % m_RenderData.xBounds) * m_RenderData.tileWidth,
+				m_RenderData.sheetOrigin.y + (spriteID / m_RenderData.xBounds) * m_RenderData.tileHeight,
+				m_RenderData.tileWidth,
+				m_RenderData.tileHeight
+			};
+		}
 	}
 
-	void Tilemap::AddTile(Vector2 gridPos, int spriteID)
+	void Tilemap::AddTile(Vector2 gridPos, int spriteID, TileCollisionType collision)
 	{
+		std::unique_lock<std::mutex> lock = Lock();
+
 		int tileID = GridToTileID(gridPos);
-		int tileIndex = m_ActiveTileCount;
 
-		if (spriteID > m_RenderData.tileCount)
+		if (spriteID < 0 || spriteID >= m_RenderData.tileCount)
 		{
 			std::cout << "Given sprite ID of " << spriteID << " exceeds total sprite count!" << std::endl;
 			spriteID = 0;
 		}
 
+		m_DenseSprites[tileID] = spriteID;
+		MarkChunkDirty(tileID);
+
+		if (m_DenseCollision[tileID] != collision)
+		{
+			m_DenseCollision[tileID] = collision;
+			m_CollisionVersion++;
+		}
+
+		// Already a tile here, so just swap out its sprite and collision
+		auto existing = m_TileIDToIndex.find(tileID);
+		if (existing != m_TileIDToIndex.end())
+		{
+			m_Sprite[existing->second].spriteID = spriteID;
+			m_Collision[existing->second].type = collision;
+			return;
+		}
+
+		assert(m_ActiveTileCount < MAX_TILES && "Too many tiles!");
+		int tileIndex = m_ActiveTileCount;
+
 		m_Sprite[tileIndex].spriteID = spriteID;
-		//m_Collision[tileIndex].collision = collisionType;
+		m_Collision[tileIndex].type = collision;
 
 		m_TileIDToIndex[tileID] = tileIndex;
 		m_IndexToTileID[tileIndex] = tileID;
@@ -54,8 +143,22 @@ namespace Funny
 
 	void Tilemap::RemoveTile(Vector2 gridPos)
 	{
+		std::unique_lock<std::mutex> lock = Lock();
+
 		int removedTileID = GridToTileID(gridPos);
-		int removedTileIndex = m_TileIDToIndex[removedTileID];
+
+		auto removed = m_TileIDToIndex.find(removedTileID);
+		if (removed == m_TileIDToIndex.end()) { return; }
+		int removedTileIndex = removed->second;
+
+		m_DenseSprites[removedTileID] = EMPTY_TILE;
+		MarkChunkDirty(removedTileID);
+
+		if (m_DenseCollision[removedTileID] != NONE)
+		{
+			m_DenseCollision[removedTileID] = NONE;
+			m_CollisionVersion++;
+		}
 
 		int lastTileID = m_IndexToTileID[m_ActiveTileCount - 1];
 		int lastTileIndex = m_ActiveTileCount - 1;
@@ -65,7 +168,7 @@ namespace Funny
 		* the last tile's data
 		*/
 		m_Sprite[removedTileIndex] = m_Sprite[lastTileIndex];
-		// do same w/ collision
+		m_Collision[removedTileIndex] = m_Collision[lastTileIndex];
 
 		/*
 		* Have the ID of the last tile now point towards
@@ -93,6 +196,13 @@ namespace Funny
 		m_ActiveTileCount--;
 	}
 
+	void Tilemap::MarkChunkDirty(int tileID)
+	{
+		int chunkX = (tileID % m_GridData.xBounds) / CHUNK_TILES;
+		int chunkY = (tileID / m_GridData.xBounds) / CHUNK_TILES;
+		m_ChunkVersions[chunkY * m_ChunkColumns + chunkX] = ++m_NextChunkVersion;
+	}
+
 	int Tilemap::GridToTileID(Vector2 gridPos)
 	{
 		assert((gridPos.x >= 0 && gridPos.x < m_GridData.xBounds) && "Given X position is out of bounds!");
@@ -137,4 +247,14 @@ namespace Funny
 	{
 		return m_Sprite[tileIndex];
 	}
-}
\ No newline at end of file
+
+	TileCollision Tilemap::GetTileCollision(Vector2 gridPos)
+	{
+		return TileCollision { (TileCollisionType)m_DenseCollision[GridToTileID(gridPos)] };
+	}
+
+	TileCollision Tilemap::GetTileCollision(int tileIndex)
+	{
+		return m_Collision[tileIndex];
+	}
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include <unordered_map>
 #include <array>
+#include <string>
+#include <vector>
+#include <mutex>
 #include <SDL2/SDL.h>
 #include "Vector.h"
 #include "Types.h"
@@ -118,6 +121,8 @@ namespace Funny
 	* maps accordingly.
 	*/
 	const int MAX_TILES = 5000;
+	const int EMPTY_TILE = -1;
+	const int CHUNK_TILES = 32; // Width and height of a render chunk in tiles
 
 	enum TileCollisionType : uint8_t
 	{
@@ -135,6 +140,7 @@ namespace Funny
 	struct TilemapRenderData
 	{
 		SDL_Texture* texture;
+		SDL_Point sheetOrigin; // Where the sheet starts on its texture, since it may be packed into an atlas
 
 		int xBounds;
 		int yBounds;
@@ -157,6 +163,29 @@ namespace Funny
 		int tileCount;
 	};
 
+	/*
+	* Which sheet a map's tiles come from, how the
+	* sheet is cut up, how big the map is and the
+	* sprite ID of every tile in it, row by row
+	* (EMPTY_TILE where there isn't one), plus the
+	* same for each tile's collision. Without tiles
+	* the map loads empty, without collision every
+	* tile is NONE. The defaults are the test map's.
+	*/
+	struct TilemapLayout
+	{
+		std::string sheet = "CaveTileset";	// Texture name
+		int sheetColumns = 16;
+		int sheetRows = 5;
+		int tileWidth = 16;		// On the sheet, in pixels
+		int tileHeight = 16;
+		int columns = 10;
+		int rows = 5;
+		float tileSize = 50;	// In the world
+		std::vector<int> tiles;
+		std::vector<TileCollisionType> collision;
+	};
+
 	struct TileRenderable
 	{
 		uint8_t spriteID;
@@ -170,10 +199,11 @@ namespace Funny
 	class Tilemap
 	{
 	public:
-		void loadMap();
+		// Reuses this tilemap's storage, so chunk versions stay unique across loads
+		void loadMap(const TilemapLayout& layout = TilemapLayout());
 		void unloadMap();
 
-		void AddTile(Vector2 gridPos, int spriteID);
+		void AddTile(Vector2 gridPos, int spriteID, TileCollisionType collision = NONE);
 		void RemoveTile(Vector2 gridPos);
 
 		int GridToTileID(Vector2 gridPos); // Converts from grid pos to tile ID
@@ -181,20 +211,63 @@ namespace Funny
 		Vector2 IndexToGrid(int index); // Converts from index to grid position
 		int GetActiveTileCount() { return m_ActiveTileCount; }
 
-		TilemapRenderData GetRenderData() { return m_RenderData; }
-		TilemapGridData GetGridData() { return m_GridData; }
+		TilemapRenderData GetRenderData() const { return m_RenderData; }
+		TilemapGridData GetGridData() const { return m_GridData; }
 
 		TileRenderable GetTileSprite(Vector2 gridPos); // Gets tile sprite by grid position
 		TileRenderable GetTileSprite(int tileIndex); // Gets tile sprite by index in tile array
 
-		//TileCollision GetTileCollision(Vector2 gridPos);
-		//TileCollision GetTileCollision(int tileIndex);
+		/*
+		* A dense copy of every tile's sprite ID laid
+		* out row by row (EMPTY_TILE where there's no
+		* tile), plus the source rect for every sprite
+		* ID in the sheet. These exist so the renderer
+		* can walk just the rows and columns the camera
+		* sees without going through the index maps or
+		* redoing the ID to rect math for every tile.
+		*/
+		const int16_t* GetDenseRow(int y) const { return m_DenseSprites.data() + (y * m_GridData.xBounds); }
+		const SDL_Rect& GetSourceRect(int spriteID) const { return m_SourceRects[spriteID]; }
+
+		/*
+		* The map is also split into CHUNK_TILES sized
+		* chunks for the renderer to cache. Every chunk
+		* has a version that changes whenever a tile in
+		* it does, so a cached copy is stale whenever
+		* its version doesn't match anymore.
+		*/
+		int GetChunkColumns() const { return m_ChunkColumns; }
+		int GetChunkRows() const { return m_ChunkRows; }
+		uint32_t GetChunkVersion(int chunkX, int chunkY) const { return m_ChunkVersions[chunkY * m_ChunkColumns + chunkX]; }
+
+		/*
+		* The render thread reads tiles when it builds
+		* chunks while the simulation might be editing
+		* them, so edits happen under this lock and the
+		* render thread takes it before reading. Reads
+		* from the simulation thread don't need it.
+		*/
+		std::unique_lock<std::mutex> Lock() const { return std::unique_lock<std::mutex>(m_Mutex); }
+
+		TileCollision GetTileCollision(Vector2 gridPos); // Gets tile collision by grid position
+		TileCollision GetTileCollision(int tileIndex); // Gets tile collision by index in tile array
+
+		/*
+		* Same idea as the dense sprite rows, but with
+		* every tile's TileCollisionType (NONE where
+		* there's no tile). The version changes any
+		* time a tile's collision does, so anything
+		* built from the collision data (like light
+		* visibility) knows when it's gone stale.
+		*/
+		const uint8_t* GetCollisionRow(int y) const { return m_DenseCollision.data() + (y * m_GridData.xBounds); }
+		uint32_t GetCollisionVersion() const { return m_CollisionVersion; }
 
 	private:
 		TilemapRenderData m_RenderData;
 		TilemapGridData m_GridData;
 
-		int m_ActiveTileCount;
+		int m_ActiveTileCount = 0;
 
 		// Actual data for our tiles
 
@@ -203,5 +276,20 @@ namespace Funny
 
 		std::unordered_map<int, int> m_IndexToTileID; // From an index in the array to the tile's one dimensional tile ID
 		std::unordered_map<int, int> m_TileIDToIndex; // From the tile's one dimensional tile ID to its index in the array
+
+		std::vector<int16_t> m_DenseSprites; // Sprite ID per tile ID, kept in sync by AddTile and RemoveTile
+		std::vector<uint8_t> m_DenseCollision; // Collision type per tile ID, same as above
+		uint32_t m_CollisionVersion = 0;
+		std::vector<SDL_Rect> m_SourceRects; // Sprite ID to its rect on the tile sheet
+
+		mutable std::mutex m_Mutex;
+
+		int m_ChunkColumns = 0;
+		int m_ChunkRows = 0;
+		uint32_t m_NextChunkVersion = 0; // Only ever goes up, so versions stay unique across reloads
+		std::vector<uint32_t> m_ChunkVersions;
+
+		void BuildSourceRects();
+		void MarkChunkDirty(int tileID);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "TilemapChunkCache.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace Funny
+{
+	TilemapChunkCache::~TilemapChunkCache()
+	{
+		Clear();
+	}
+
+	void TilemapChunkCache::BeginFrame()
+	{
+		m_Frame++;
+
+		m_Stats.visibleChunks = 0;
+		m_Stats.rebuiltChunks = 0;
+		m_Stats.fallbackChunks = 0;
+		m_Stats.evictedChunks = 0;
+		m_Stats.cachedChunks = (int)m_Chunks.size();
+	}
+
+	SDL_Texture* TilemapChunkCache::GetChunk(SDL_Renderer* renderer, const Tilemap* tilemap, int chunkX, int chunkY)
+	{
+		m_Stats.visibleChunks++;
+
+		std::unique_lock<std::mutex> lock = tilemap->Lock();
+
+		TilemapRenderData renderData = tilemap->GetRenderData();
+		TilemapGridData gridData = tilemap->GetGridData();
+
+		ChunkKey key { tilemap, chunkY * tilemap->GetChunkColumns() + chunkX };
+		uint32_t version = tilemap->GetChunkVersion(chunkX, chunkY);
+
+		// Chunks on the far edges of the map can be smaller than the rest
+		int tilesWide = std::min(CHUNK_TILES, gridData.xBounds - chunkX * CHUNK_TILES);
+		int tilesHigh = std::min(CHUNK_TILES, gridData.yBounds - chunkY * CHUNK_TILES);
+		int width = tilesWide * renderData.tileWidth;
+		int height = tilesHigh * renderData.tileHeight;
+
+		Chunk* chunk = nullptr;
+
+		// A map loaded over the old one can leave a chunk a different size, which needs a new texture
+		auto found = m_Lookup.find(key);
+		if (found != m_Lookup.end() && (found->second->width != width || found->second->height != height))
+		{
+			Evict(found->second);
+			found = m_Lookup.end();
+		}
+
+		if (found != m_Lookup.end())
+		{
+			// Move it to the front of the line
+			m_Chunks.splice(m_Chunks.begin(), m_Chunks, found->second);
+			chunk = &m_Chunks.front();
+		}
+		else
+		{
+			chunk = AcquireChunk(renderer, key, width, height);
+			if (chunk == nullptr)
+			{
+				m_Stats.fallbackChunks++;
+				return nullptr;
+			}
+		}
+
+		chunk->lastUsedFrame = m_Frame;
+
+		if (chunk->version != version)
+		{
+			RenderChunk(renderer, tilemap, chunkX, chunkY, *chunk);
+			chunk->version = version;
+		}
+
+		m_Stats.cachedChunks = (int)m_Chunks.size();
+		return chunk->texture;
+	}
+
+	/*
+	* Finds a texture for a chunk we haven't got
+	* cached, either by making a new one or by taking
+	* over the least recently used chunk. If that one
+	* happens to be the same size we keep its texture
+	* rather than destroying and recreating it.
+	*/
+	TilemapChunkCache::Chunk* TilemapChunkCache::AcquireChunk(SDL_Renderer* renderer, const ChunkKey& key, int width, int height)
+	{
+		if (m_Budget == 0 || !SDL_RenderTargetSupported(renderer)) { return nullptr; }
+
+		SDL_Texture* texture = nullptr;
+
+		if (m_Chunks.size() >= m_Budget)
+		{
+			auto oldest = std::prev(m_Chunks.end());
+			if (oldest->lastUsedFrame == m_Frame) { return nullptr; }
+
+			if (oldest->width == width && oldest->height == height)
+			{
+				texture = oldest->texture;
+				oldest->texture = nullptr;
+			}
+
+			Evict(oldest);
+		}
+
+		if (texture == nullptr)
+		{
+			texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height);
+			if (texture == nullptr)
+			{
+				std::cout << "Unable to create tilemap chunk texture! SDL Error: " << SDL_GetError() << std::endl;
+				return nullptr;
+			}
+			SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+		}
+
+		// Version 0 is never handed out by a tilemap, so this forces a render
+		m_Chunks.push_front(Chunk { key, texture, width, height, 0, m_Frame });
+		m_Lookup[key] = m_Chunks.begin();
+
+		return &m_Chunks.front();
+	}
+
+	/*
+	* Draws every tile in the chunk into its texture
+	* at the tile sheet's native resolution, using our
+	* own batcher so it's still one draw call per
+	* chunk. Whatever render target and draw color
+	* were set before get put back afterwards.
+	*/
+	void TilemapChunkCache::RenderChunk(SDL_Renderer* renderer, const Tilemap* tilemap, int chunkX, int chunkY, Chunk& chunk)
+	{
+		FUNNY_PROFILE_SCOPE("RenderTilemapChunk");
+
+		TilemapRenderData renderData = tilemap->GetRenderData();
+		TilemapGridData gridData = tilemap->GetGridData();
+
+		SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer);
+		Uint8 r, g, b, a;
+		SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+		SDL_SetRenderTarget(renderer, chunk.texture);
+		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+		SDL_RenderClear(renderer);
+
+		int startX = chunkX * CHUNK_TILES;
+		int startY = chunkY * CHUNK_TILES;
+		int endX = std::min(startX + CHUNK_TILES, gridData.xBounds);
+		int endY = std::min(startY + CHUNK_TILES, gridData.yBounds);
+
+		m_Batcher.Begin();
+		for (int y = startY; y < endY; y++)
+		{
+			const int16_t* row = tilemap->GetDenseRow(y);
+
+			for (int x = startX; x < endX; x++)
+			{
+				int spriteID = row[x];
+				if (spriteID == EMPTY_TILE) { continue; }
+
+				SDL_FRect dst
+				{
+					(float)((x - startX) * renderData.tileWidth),
+					(float)((y - startY) * renderData.tileHeight),
+					(float)renderData.tileWidth,
+					(float)renderData.tileHeight
+				};
+				m_Batcher.Submit(renderData.texture, tilemap->GetSourceRect(spriteID), dst, ColorRGBA(255, 255, 255, 255));
+			}
+		}
+		m_Batcher.Flush(renderer);
+
+		SDL_SetRenderTarget(renderer, previousTarget);
+		SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+		m_Stats.rebuiltChunks++;
+	}
+
+	void TilemapChunkCache::Evict(std::list<Chunk>::iterator chunk)
+	{
+		if (chunk->texture != nullptr)
+		{
+			SDL_DestroyTexture(chunk->texture);
+		}
+
+		m_Lookup.erase(chunk->key);
+		m_Chunks.erase(chunk);
+		m_Stats.evictedChunks++;
+	}
+
+	void TilemapChunkCache::SetBudget(size_t budget)
+	{
+		m_Budget = budget;
+
+		while (m_Chunks.size() > m_Budget)
+		{
+			Evict(std::prev(m_Chunks.end()));
+		}
+	}
+
+	/*
+	* Also what we fall back on when the renderer
+	* tells us its render targets were lost, since
+	* every chunk would need redrawing anyways.
+	*/
+	void TilemapChunkCache::Clear()
+	{
+		for (Chunk& chunk : m_Chunks)
+		{
+			if (chunk.texture != nullptr)
+			{
+				SDL_DestroyTexture(chunk.texture);
+			}
+		}
+
+		m_Chunks.clear();
+		m_Lookup.clear();
+	}
+}
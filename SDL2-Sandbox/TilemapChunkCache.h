@@ -0,0 +1,93 @@
+#pragma once
+#include <list>
+#include <unordered_map>
+#include <SDL2/SDL.h>
+#include "Tilemap.h"
+#include "SpriteBatcher.h"
+
+namespace Funny
+{
+	struct TilemapChunkStats
+	{
+		int visibleChunks = 0;
+		int rebuiltChunks = 0;		// Chunks re-rendered this frame because they were new or dirty
+		int fallbackChunks = 0;		// Chunks drawn tile by tile because the budget was full
+		int evictedChunks = 0;
+		int cachedChunks = 0;
+	};
+
+	/*
+	* Keeps pre-rendered copies of tilemap chunks
+	* around as render target textures, so a chunk
+	* full of static tiles costs one sprite to draw
+	* instead of one per tile.
+	* 
+	* A chunk is only re-rendered when its version
+	* on the tilemap changes (AddTile and RemoveTile
+	* bump it), and the number of chunk textures we
+	* hold on to is capped by a budget. Once we hit
+	* the budget the least recently drawn chunk gets
+	* recycled, though never one that's already been
+	* drawn this frame. If that's all we've got left
+	* GetChunk hands back nullptr and the caller is
+	* expected to draw those tiles the old way.
+	* 
+	* Only the thread that owns the renderer should
+	* be using this.
+	*/
+	class TilemapChunkCache
+	{
+	public:
+		TilemapChunkCache(size_t budget = 64) : m_Budget(budget) {}
+		~TilemapChunkCache();
+
+		void BeginFrame();
+		SDL_Texture* GetChunk(SDL_Renderer* renderer, const Tilemap* tilemap, int chunkX, int chunkY);
+
+		void SetBudget(size_t budget);
+		void Clear();
+
+		const TilemapChunkStats& GetStats() const { return m_Stats; }
+
+	private:
+		struct ChunkKey
+		{
+			const Tilemap* tilemap;
+			int chunk;
+
+			bool operator==(const ChunkKey& other) const { return tilemap == other.tilemap && chunk == other.chunk; }
+		};
+
+		struct ChunkKeyHash
+		{
+			size_t operator()(const ChunkKey& key) const
+			{
+				return std::hash<const void*>()(key.tilemap) ^ (std::hash<int>()(key.chunk) * 31);
+			}
+		};
+
+		struct Chunk
+		{
+			ChunkKey key;
+			SDL_Texture* texture;
+			int width;
+			int height;
+			uint32_t version;
+			uint64_t lastUsedFrame;
+		};
+
+		size_t m_Budget;
+		uint64_t m_Frame = 0;
+
+		// Most recently used at the front
+		std::list<Chunk> m_Chunks;
+		std::unordered_map<ChunkKey, std::list<Chunk>::iterator, ChunkKeyHash> m_Lookup;
+
+		SpriteBatcher m_Batcher;
+		TilemapChunkStats m_Stats;
+
+		Chunk* AcquireChunk(SDL_Renderer* renderer, const ChunkKey& key, int width, int height);
+		void RenderChunk(SDL_Renderer* renderer, const Tilemap* tilemap, int chunkX, int chunkY, Chunk& chunk);
+		void Evict(std::list<Chunk>::iterator chunk);
+	};
+}
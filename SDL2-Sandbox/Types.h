@@ -28,9 +28,19 @@ namespace Funny
 	* MAX_ENTITIES is assigned as an Entity
 	* for the sake of keeping consistent
 	* integer sizes for arrays n such.
+	* 
+	* The limit can be raised at build time
+	* through FUNNY_MAX_ENTITIES (the benchmarks
+	* do this to stress larger entity counts),
+	* but it has to stay below the max value
+	* of our 16 bit Entity type.
 	*/
 	typedef std::uint16_t Entity;
-	const Entity MAX_ENTITIES = 1000;
+#ifndef FUNNY_MAX_ENTITIES
+#define FUNNY_MAX_ENTITIES 1000
+#endif
+	static_assert(FUNNY_MAX_ENTITIES > 0 && FUNNY_MAX_ENTITIES < 65536, "FUNNY_MAX_ENTITIES has to fit in an Entity!");
+	const Entity MAX_ENTITIES = FUNNY_MAX_ENTITIES;
 
 	/*
 	* When a new Component is registered in
@@ -61,9 +71,17 @@ namespace Funny
 	*/
 	typedef std::bitset<MAX_COMPONENTS> Signature;
 
+	/*
+	* Where a texture sits in the ResourceManager's
+	* texture table, resolved to an SDL_Texture only
+	* when something actually gets drawn with it.
+	*/
+	typedef uint32_t TextureHandle;
+	const TextureHandle INVALID_TEXTURE = 0xFFFFFFFF;
+
 	struct Renderable
 	{
-		SDL_Texture* texture;
+		TextureHandle texture = INVALID_TEXTURE;
 		SDL_Rect sourceRect;
 		ColorRGBA color
 		{
@@ -73,6 +91,10 @@ namespace Funny
 			color.a = 255
 		};
 		bool drawToScreen;
+
+		// Higher layers draw on top, then higher depth within a layer
+		uint8_t layer = 0;
+		float depth = 0;
 	};
 
 	struct Transform
@@ -81,4 +103,63 @@ namespace Funny
 		Vector2 scale;
 		Vector2 rotation;
 	};
-}
\ No newline at end of file
+
+	/*
+	* Plays an animation clip on an Entity's
+	* Renderable. The clip's frames live in
+	* AnimationClips, so all this holds is which
+	* clip, how far into it we are in seconds and
+	* how fast it plays (negative plays backwards).
+	*/
+	struct Animator
+	{
+		uint32_t clipID = 0;
+		float time = 0;
+		float speed = 1;
+	};
+
+	/*
+	* Draws a string made with TextRenderer at
+	* the Entity's Transform, plus an offset. Text
+	* goes on top of every sprite. Screen space
+	* text takes its position in window pixels
+	* and ignores the camera, for HUDs and debug
+	* readouts.
+	*/
+	struct Text
+	{
+		uint32_t textID = 0;
+		Vector2 offset;
+		ColorRGBA color
+		{
+			color.r = 255,
+			color.g = 255,
+			color.b = 255,
+			color.a = 255
+		};
+		bool drawToScreen = false;
+	};
+
+	/*
+	* A point light at the Entity's Transform, plus
+	* an offset. Once a scene has any lights at all,
+	* anything they don't reach drops down to the
+	* ambient light, and BLOCK tiles cast shadows.
+	* Static lights promise not to move, so their
+	* shadows get worked out once and kept.
+	*/
+	struct Light
+	{
+		ColorRGBA color
+		{
+			color.r = 255,
+			color.g = 255,
+			color.b = 255,
+			color.a = 255
+		};
+		float radius = 200;
+		float intensity = 1;
+		Vector2 offset;
+		bool isStatic = false;
+	};
+}
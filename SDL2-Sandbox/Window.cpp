@@ -1,5 +1,6 @@
 #include "Window.h"
 #include "Common.h"
+#include "Engine.h"
 
 namespace Funny
 {
@@ -9,7 +10,7 @@ namespace Funny
 		m_Width = windowWidth;
 		m_Height = windowHeight;
 
-		if (isInit())
+		if (m_Window != nullptr)
 		{
 			SDL_SetWindowSize(m_Window, windowWidth, windowHeight);
 			return true;
@@ -21,9 +22,64 @@ namespace Funny
 		}
 	}
 
+	bool Window::setOffscreen(std::string windowName, int windowWidth, int windowHeight)
+	{
+		close();
+
+		m_Name = windowName;
+		m_Width = windowWidth;
+		m_Height = windowHeight;
+
+		m_Surface = SDL_CreateRGBSurfaceWithFormat(0, windowWidth, windowHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+		if (m_Surface == nullptr)
+		{
+			std::cout << "Could not create offscreen surface: " << SDL_GetError() << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool Window::createRenderer()
+	{
+		if (m_Renderer != nullptr) { return true; }
+
+		if (isOffscreen())
+		{
+			m_Renderer = SDL_CreateSoftwareRenderer(m_Surface);
+			if (m_Renderer == nullptr)
+			{
+				std::cout << "Could not create software renderer: " << SDL_GetError() << std::endl;
+				return false;
+			}
+
+			return true;
+		}
+
+		if (m_Window == nullptr) { return false; }
+
+		m_Renderer = SDL_CreateRenderer(m_Window, -1, 0);
+		if (m_Renderer == nullptr)
+		{
+			std::cout << "Could not create SDL renderer." << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Window::destroyRenderer()
+	{
+		if (m_Renderer != nullptr)
+		{
+			SDL_DestroyRenderer(m_Renderer);
+			m_Renderer = nullptr;
+		}
+	}
+
 	bool Window::isInit()
 	{
-		if (m_Window == nullptr || m_Renderer == nullptr)
+		if (m_Renderer == nullptr || (m_Window == nullptr && m_Surface == nullptr))
 		{
 			return false;
 		}
@@ -37,14 +93,11 @@ namespace Funny
 	// which is bound to our single SDL window. But we don't need multiple windows.
 	bool Window::init()
 	{
-		if (m_Window != nullptr)
-		{
-			SDL_DestroyWindow(m_Window);
-		}
+		close();
 
-		if (m_Renderer != nullptr)
+		if (!Engine::requireSubsystem(SDL_INIT_VIDEO))
 		{
-			SDL_DestroyRenderer(m_Renderer);
+			return false;
 		}
 
 		m_Window = SDL_CreateWindow(m_Name.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, m_Width, m_Height, 0);
@@ -54,23 +107,13 @@ namespace Funny
 			return false;
 		}
 
-		m_Renderer = SDL_CreateRenderer(m_Window, -1, 0);
-		if (m_Renderer == nullptr)
-		{
-			std::cout << "Could not create SDL renderer." << std::endl;
-			return false;
-		}
-
 		return true;
 	}
 
+	// With a render thread the renderer's already been destroyed over there by now
 	bool Window::close()
 	{
-		if (m_Renderer != nullptr)
-		{
-			SDL_DestroyRenderer(m_Renderer);
-			m_Renderer = nullptr;
-		}
+		destroyRenderer();
 
 		if (m_Window != nullptr)
 		{
@@ -78,6 +121,12 @@ namespace Funny
 			m_Window = nullptr;
 		}
 
+		if (m_Surface != nullptr)
+		{
+			SDL_FreeSurface(m_Surface);
+			m_Surface = nullptr;
+		}
+
 		return true;
 	}
 }
\ No newline at end of file
@@ -11,12 +11,39 @@ namespace Funny
 		bool isInit();
 		bool close();
 
+		/*
+		* Offscreen mode skips the SDL window entirely
+		* and draws into a plain SDL_Surface through
+		* SDL's software renderer instead. Nothing shows
+		* up on screen, but it needs no video driver and
+		* draws the same pixels on every machine, which
+		* is what headless benchmarks and golden image
+		* comparisons want.
+		*/
+		bool setOffscreen(std::string name, int width, int height);
+		bool isOffscreen() const { return m_Surface != nullptr; }
+
+		/*
+		* The renderer's made separately from the
+		* window, on whichever thread is going to
+		* draw with it, since SDL only lets the thread
+		* that made a renderer use it. That goes for
+		* destroying it too, which takes every texture
+		* made with it along.
+		*/
+		bool createRenderer();
+		void destroyRenderer();
+
 		SDL_Window* getSDLWindow() { return m_Window; }
-		SDL_Renderer* getSDLRenderer() { return m_Renderer; };
+		SDL_Renderer* getSDLRenderer() { return m_Renderer; }; // Only for the thread that made it
+		SDL_Surface* getSurface() { return m_Surface; } // Only set when offscreen
+		int getWidth() { return m_Width; }
+		int getHeight() { return m_Height; }
 
 	private:
 		SDL_Window* m_Window = nullptr;
 		SDL_Renderer* m_Renderer = nullptr;
+		SDL_Surface* m_Surface = nullptr;
 
 		std::string m_Name;
 		int m_Width;
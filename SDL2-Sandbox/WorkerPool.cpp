@@ -0,0 +1,100 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace Funny
+{
+	WorkerPool::WorkerPool(int threads)
+	{
+		if (threads <= 0)
+		{
+			threads = std::max(1, (int)std::thread::hardware_concurrency());
+		}
+
+		for (int i = 1; i < threads; i++)
+		{
+			m_Workers.push_back(std::thread(&WorkerPool::WorkerMain, this));
+		}
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stopping = true;
+		}
+		m_WorkCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	/*
+	* Workers are only woken when there's more than
+	* one index to go around, a single piece of work
+	* is quicker to just do ourselves.
+	*/
+	void WorkerPool::ParallelFor(int count, const std::function<void(int)>& job)
+	{
+		if (count <= 0) { return; }
+
+		m_Function = &job;
+		m_Count = count;
+		m_Next = 0;
+
+		const bool wakeWorkers = !m_Workers.empty() && count > 1;
+		if (wakeWorkers)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				m_Job++;
+				m_Busy = (int)m_Workers.size();
+			}
+			m_WorkCondition.notify_all();
+		}
+
+		RunJobs();
+
+		if (wakeWorkers)
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_DoneCondition.wait(lock, [this] { return m_Busy == 0; });
+		}
+
+		m_Function = nullptr;
+	}
+
+	void WorkerPool::RunJobs()
+	{
+		int index;
+		while ((index = m_Next.fetch_add(1, std::memory_order_relaxed)) < m_Count)
+		{
+			(*m_Function)(index);
+		}
+	}
+
+	void WorkerPool::WorkerMain()
+	{
+		uint64_t lastJob = 0;
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_WorkCondition.wait(lock, [this, lastJob] { return m_Stopping || m_Job != lastJob; });
+				if (m_Stopping) { return; }
+				lastJob = m_Job;
+			}
+
+			RunJobs();
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (--m_Busy == 0)
+			{
+				m_DoneCondition.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Funny
+{
+	/*
+	* A handful of threads that sleep until they're
+	* given a job, for splitting up work that comes
+	* in neat independent pieces (tiles of a frame,
+	* lights in a scene and the like).
+	*
+	* ParallelFor hands out indices from 0 up to
+	* the given count one at a time, so uneven
+	* pieces balance out on their own, and doesn't
+	* return until every one of them is done. The
+	* calling thread takes indices too rather than
+	* sitting idle while it waits.
+	*/
+	class WorkerPool
+	{
+	public:
+		// 0 threads uses one per hardware thread, counting the caller
+		WorkerPool(int threads = 0);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		void ParallelFor(int count, const std::function<void(int)>& job);
+
+		int GetThreadCount() const { return (int)m_Workers.size() + 1; }
+
+	private:
+		const std::function<void(int)>* m_Function = nullptr;
+		int m_Count = 0;
+		std::atomic<int> m_Next { 0 };
+
+		void RunJobs();
+
+		std::vector<std::thread> m_Workers;
+		std::mutex m_Mutex;
+		std::condition_variable m_WorkCondition;
+		std::condition_variable m_DoneCondition;
+		uint64_t m_Job = 0;
+		int m_Busy = 0;
+		bool m_Stopping = false;
+
+		void WorkerMain();
+	};
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+
+#include "Common.h"
+#include "DrawKeySorter.h"
+
+/*
+* Times our draw key sorting at sprite counts
+* up to well past what a frame should ever see,
+* alongside std::sort as a baseline. Like the
+* ECS benchmark this is headless and reports
+* the median and fastest run, as JSON lines or
+* CSV with --csv.
+* 
+* The cases cover a fresh shuffle (full radix
+* sort), last frame's order with nothing moved,
+* and last frame's order with a handful of
+* sprites changing depth.
+*
+* Usage:
+*   DrawSortBenchmark [--csv] [--reps N] [--filter name] [--counts 1000,50000,...]
+*/
+namespace Funny
+{
+	namespace Bench
+	{
+		struct Case
+		{
+			const char* name;
+			// Builds the keys as they'd arrive this frame
+			std::function<void(std::vector<DrawKey>&, int, std::mt19937&)> prepare;
+			std::function<void(DrawKeySorter&, std::vector<DrawKey>&)> run;
+		};
+
+		struct Result
+		{
+			const char* name;
+			int sprites;
+			double medianUs;
+			double minUs;
+			DrawSortMode mode;
+		};
+
+		/*
+		* Roughly what a scene looks like, a few layers
+		* and textures, with depth following the sprite's
+		* Y position like a top down game would do it.
+		*/
+		static void MakeSceneKeys(std::vector<DrawKey>& keys, int count, std::mt19937& rng)
+		{
+			std::uniform_int_distribution<int> layer(0, 3);
+			std::uniform_int_distribution<int> texture(0, 15);
+			std::uniform_real_distribution<float> depth(0.0f, 1080.0f);
+
+			keys.resize(count);
+			for (int i = 0; i < count; i++)
+			{
+				keys[i] = { MakeDrawKey((uint8_t)layer(rng), depth(rng), (uint16_t)texture(rng)), (uint32_t)i };
+			}
+		}
+
+		static void SortedSceneKeys(std::vector<DrawKey>& keys, int count, std::mt19937& rng)
+		{
+			MakeSceneKeys(keys, count, rng);
+			std::sort(keys.begin(), keys.end(), [](const DrawKey& a, const DrawKey& b) { return a.key < b.key; });
+		}
+
+		std::vector<Case> MakeCases()
+		{
+			std::vector<Case> cases;
+
+			cases.push_back({ "radix_shuffled",
+				MakeSceneKeys,
+				[](DrawKeySorter& sorter, std::vector<DrawKey>& keys) { sorter.Sort(keys); } });
+
+			cases.push_back({ "std_sort_shuffled",
+				MakeSceneKeys,
+				[](DrawKeySorter&, std::vector<DrawKey>& keys)
+				{
+					std::sort(keys.begin(), keys.end(), [](const DrawKey& a, const DrawKey& b) { return a.key < b.key; });
+				} });
+
+			cases.push_back({ "reuse_unchanged",
+				SortedSceneKeys,
+				[](DrawKeySorter& sorter, std::vector<DrawKey>& keys) { sorter.Sort(keys); } });
+
+			cases.push_back({ "reuse_few_moved",
+				[](std::vector<DrawKey>& keys, int count, std::mt19937& rng)
+				{
+					SortedSceneKeys(keys, count, rng);
+
+					// A few sprites walk up or down a little
+					std::uniform_int_distribution<int> pick(0, count - 1);
+					std::uniform_real_distribution<float> depth(0.0f, 1080.0f);
+					for (int i = 0; i < 8; i++)
+					{
+						DrawKey& moved = keys[pick(rng)];
+						moved.key = MakeDrawKey((uint8_t)(moved.key >> 40), depth(rng), (uint16_t)moved.key);
+					}
+				},
+				[](DrawKeySorter& sorter, std::vector<DrawKey>& keys) { sorter.Sort(keys); } });
+
+			cases.push_back({ "reuse_many_moved",
+				[](std::vector<DrawKey>& keys, int count, std::mt19937& rng)
+				{
+					SortedSceneKeys(keys, count, rng);
+
+					std::uniform_int_distribution<int> pick(0, count - 1);
+					std::uniform_real_distribution<float> depth(0.0f, 1080.0f);
+					for (int i = 0; i < count / 10; i++)
+					{
+						DrawKey& moved = keys[pick(rng)];
+						moved.key = MakeDrawKey((uint8_t)(moved.key >> 40), depth(rng), (uint16_t)moved.key);
+					}
+				},
+				[](DrawKeySorter& sorter, std::vector<DrawKey>& keys) { sorter.Sort(keys); } });
+
+			return cases;
+		}
+
+		Result RunCase(const Case& benchCase, int count, int reps)
+		{
+			std::vector<double> samples;
+			std::mt19937 rng(1234);
+			DrawKeySorter sorter;
+			std::vector<DrawKey> keys;
+
+			for (int rep = 0; rep < reps; rep++)
+			{
+				benchCase.prepare(keys, count, rng);
+
+				auto start = std::chrono::steady_clock::now();
+				benchCase.run(sorter, keys);
+				auto end = std::chrono::steady_clock::now();
+
+				for (size_t i = 1; i < keys.size(); i++)
+				{
+					if (keys[i].key < keys[i - 1].key)
+					{
+						std::cerr << benchCase.name << " left keys out of order!" << std::endl;
+						std::exit(1);
+					}
+				}
+
+				samples.push_back((double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000.0);
+			}
+
+			std::sort(samples.begin(), samples.end());
+			return { benchCase.name, count, samples[samples.size() / 2], samples[0], sorter.GetStats().mode };
+		}
+
+		const char* ModeName(DrawSortMode mode)
+		{
+			switch (mode)
+			{
+			case DrawSortMode::ALREADY_SORTED: return "already_sorted";
+			case DrawSortMode::INSERTION: return "insertion";
+			case DrawSortMode::RADIX: return "radix";
+			}
+			return "unknown";
+		}
+
+		std::vector<int> ParseCounts(const char* arg)
+		{
+			std::vector<int> counts;
+			std::string list = arg;
+			size_t start = 0;
+
+			while (start < list.size())
+			{
+				size_t end = list.find(',', start);
+				if (end == std::string::npos)
+				{
+					end = list.size();
+				}
+
+				counts.push_back(std::atoi(list.substr(start, end - start).c_str()));
+				start = end + 1;
+			}
+
+			return counts;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace Funny::Bench;
+
+	bool csv = false;
+	int reps = 21;
+	std::string filter;
+	std::vector<int> counts = { 1000, 10000, 50000, 100000 };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--csv") == 0)
+		{
+			csv = true;
+		}
+
+		else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+		{
+			reps = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--counts") == 0 && i + 1 < argc)
+		{
+			counts = ParseCounts(argv[++i]);
+		}
+
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--csv] [--reps N] [--filter name] [--counts 1000,50000,...]" << std::endl;
+			return 1;
+		}
+	}
+
+	counts.erase(std::remove_if(counts.begin(), counts.end(), [](int count) { return count <= 1; }), counts.end());
+
+	if (csv)
+	{
+		std::cout << "suite,bench,sprites,mode,us_median,us_min" << std::endl;
+	}
+
+	for (const Case& benchCase : MakeCases())
+	{
+		if (!filter.empty() && std::string(benchCase.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		for (int count : counts)
+		{
+			Result result = RunCase(benchCase, count, reps);
+			const char* mode = (std::strncmp(result.name, "std_sort", 8) == 0) ? "std_sort" : ModeName(result.mode);
+
+			if (csv)
+			{
+				std::cout << "draw_sort," << result.name << "," << result.sprites << "," << mode << ","
+					<< result.medianUs << "," << result.minUs << std::endl;
+			}
+
+			else
+			{
+				std::cout << "{\"suite\":\"draw_sort\",\"bench\":\"" << result.name << "\",\"sprites\":" << result.sprites
+					<< ",\"mode\":\"" << mode << "\",\"us_median\":" << result.medianUs
+					<< ",\"us_min\":" << result.minUs << "}" << std::endl;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,547 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <utility>
+
+#include "Common.h"
+#include "Coordinator.hpp"
+#include "AnimationClips.h"
+
+/*
+* A headless microbenchmark suite for our ECS.
+* None of this touches SDL beyond the types
+* that Types.h pulls in, so it builds and runs
+* anywhere without a window or a renderer.
+*
+* Each benchmark builds a fresh Coordinator at
+* a given entity count, runs its workload a few
+* times and reports the median and fastest run
+* in nanoseconds per operation. Results are
+* written as one JSON object per line (or CSV
+* with --csv) so they can be diffed and tracked
+* between releases.
+*
+* Usage:
+*   ECSBenchmark [--csv] [--reps N] [--filter name] [--counts 100,1000,...]
+*/
+namespace Funny
+{
+	namespace Bench
+	{
+		struct Velocity
+		{
+			Vector2 linear;
+		};
+
+		struct Health
+		{
+			int current;
+			int max;
+		};
+
+		/*
+		* Keeps the optimizer from throwing away
+		* the work done in our iteration benchmarks.
+		*/
+		static volatile float g_Sink = 0;
+
+		/*
+		* A system that only looks at transforms,
+		* used for the single component iteration
+		* benchmark.
+		*/
+		class TransformSystem : public System
+		{
+		public:
+			void Update() override
+			{
+				float sum = 0;
+				for (auto const& entity : m_ManagedEntities)
+				{
+					Transform& trans = m_Coordinator->GetComponent<Transform>(entity);
+					trans.position.x += 1.0f;
+					sum += trans.position.x;
+				}
+				g_Sink = sum;
+			}
+
+			Coordinator* m_Coordinator = nullptr;
+		};
+
+		/*
+		* A system that reads and writes three
+		* components per entity, roughly what a
+		* movement or render pass looks like.
+		*/
+		class MovementSystem : public System
+		{
+		public:
+			void Update() override
+			{
+				float sum = 0;
+				for (auto const& entity : m_ManagedEntities)
+				{
+					Transform& trans = m_Coordinator->GetComponent<Transform>(entity);
+					Velocity& vel = m_Coordinator->GetComponent<Velocity>(entity);
+					Renderable& rend = m_Coordinator->GetComponent<Renderable>(entity);
+
+					trans.position.x += vel.linear.x;
+					trans.position.y += vel.linear.y;
+					rend.sourceRect.x = (int)trans.position.x;
+					sum += trans.position.y;
+				}
+				g_Sink = sum;
+			}
+
+			Coordinator* m_Coordinator = nullptr;
+		};
+
+		/*
+		* Empty systems that only exist to have
+		* their own type (and so their own entry
+		* in the SystemManager) for the signature
+		* change benchmark.
+		*/
+		template <int N>
+		class DummySystem : public System
+		{
+		public:
+			void Update() override {}
+		};
+
+		const int DUMMY_SYSTEM_COUNT = 32;
+
+		template <int... N>
+		void RegisterDummySystems(Coordinator& coordinator, std::integer_sequence<int, N...>)
+		{
+			// Every system requires a different mix of our four components
+			// so signature changes actually move entities in and out of sets.
+			ComponentType types[4] =
+			{
+				coordinator.GetComponentType<Transform>(),
+				coordinator.GetComponentType<Renderable>(),
+				coordinator.GetComponentType<Velocity>(),
+				coordinator.GetComponentType<Health>()
+			};
+
+			auto registerOne = [&](auto system, int index)
+			{
+				using SystemType = typename decltype(system)::element_type;
+				coordinator.RegisterSystem<SystemType>();
+
+				Signature signature;
+				for (int bit = 0; bit < 4; bit++)
+				{
+					if ((index + 1) & (1 << bit))
+					{
+						signature.set(types[bit]);
+					}
+				}
+				coordinator.SetSystemSignature<SystemType>(signature);
+			};
+
+			(registerOne(std::shared_ptr<DummySystem<N>>(), N), ...);
+		}
+
+		/*
+		* Builds a coordinator with all of our
+		* benchmark components registered.
+		*/
+		std::unique_ptr<Coordinator> MakeCoordinator()
+		{
+			std::unique_ptr<Coordinator> coordinator = std::make_unique<Coordinator>();
+			coordinator->Init();
+			coordinator->RegisterComponent<Transform>();
+			coordinator->RegisterComponent<Renderable>();
+			coordinator->RegisterComponent<Velocity>();
+			coordinator->RegisterComponent<Health>();
+			coordinator->RegisterComponent<Animator>();
+			return coordinator;
+		}
+
+		Transform MakeTransform(int i)
+		{
+			Transform trans;
+			trans.position = Vector2((float)i, (float)(i * 2));
+			trans.scale = Vector2(16, 16);
+			return trans;
+		}
+
+		/*
+		* Every benchmark is a setup step that isn't
+		* timed and a run step that is. The run step
+		* returns how many operations it did so we
+		* can normalize to a per-operation cost.
+		*/
+		struct Case
+		{
+			const char* name;
+			std::function<void(Coordinator&, int)> setup;
+			std::function<long long(Coordinator&, int)> run;
+		};
+
+		struct Result
+		{
+			const char* name;
+			int entities;
+			long long ops;
+			double medianNs;
+			double minNs;
+		};
+
+		std::vector<Case> MakeCases()
+		{
+			std::vector<Case> cases;
+
+			/*
+			* Create every entity then destroy them all
+			* in a shuffled order, which is what the ID
+			* queue sees during level loads and teardown.
+			*/
+			cases.push_back({ "create_destroy_churn",
+				[](Coordinator&, int) {},
+				[](Coordinator& coordinator, int count)
+				{
+					std::vector<Entity> entities(count);
+					for (int i = 0; i < count; i++)
+					{
+						entities[i] = coordinator.CreateEntity();
+					}
+
+					std::mt19937 rng(1234);
+					std::shuffle(entities.begin(), entities.end(), rng);
+
+					for (int i = 0; i < count; i++)
+					{
+						coordinator.DestroyEntity(entities[i]);
+					}
+
+					return (long long)count * 2;
+				} });
+
+			/*
+			* Attach and detach a component on every entity.
+			*/
+			cases.push_back({ "add_remove_component",
+				[](Coordinator& coordinator, int count)
+				{
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = coordinator.CreateEntity();
+						coordinator.AddComponent<Transform>(entity, MakeTransform(i));
+					}
+				},
+				[](Coordinator& coordinator, int count)
+				{
+					for (int i = 0; i < count; i++)
+					{
+						coordinator.AddComponent<Velocity>((Entity)i, Velocity{ Vector2(1, 1) });
+					}
+
+					for (int i = 0; i < count; i++)
+					{
+						coordinator.RemoveComponent<Velocity>((Entity)i);
+					}
+
+					return (long long)count * 2;
+				} });
+
+			/*
+			* Iterate a system that touches one component.
+			*/
+			cases.push_back({ "iterate_single_component",
+				[](Coordinator& coordinator, int count)
+				{
+					std::shared_ptr<TransformSystem> system = coordinator.RegisterSystem<TransformSystem>();
+					system->m_Coordinator = &coordinator;
+					Signature signature;
+					signature.set(coordinator.GetComponentType<Transform>());
+					coordinator.SetSystemSignature<TransformSystem>(signature);
+
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = coordinator.CreateEntity();
+						coordinator.AddComponent<Transform>(entity, MakeTransform(i));
+					}
+				},
+				[](Coordinator& coordinator, int count)
+				{
+					const int passes = 10;
+					for (int pass = 0; pass < passes; pass++)
+					{
+						coordinator.UpdateSystems();
+					}
+
+					return (long long)count * passes;
+				} });
+
+			/*
+			* Iterate a system that touches three components.
+			*/
+			cases.push_back({ "iterate_multi_component",
+				[](Coordinator& coordinator, int count)
+				{
+					std::shared_ptr<MovementSystem> system = coordinator.RegisterSystem<MovementSystem>();
+					system->m_Coordinator = &coordinator;
+					Signature signature;
+					signature.set(coordinator.GetComponentType<Transform>());
+					signature.set(coordinator.GetComponentType<Velocity>());
+					signature.set(coordinator.GetComponentType<Renderable>());
+					coordinator.SetSystemSignature<MovementSystem>(signature);
+
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = coordinator.CreateEntity();
+						coordinator.AddComponent<Transform>(entity, MakeTransform(i));
+						coordinator.AddComponent<Velocity>(entity, Velocity{ Vector2(1, 0.5f) });
+						coordinator.AddComponent<Renderable>(entity, Renderable{});
+					}
+				},
+				[](Coordinator& coordinator, int count)
+				{
+					const int passes = 10;
+					for (int pass = 0; pass < passes; pass++)
+					{
+						coordinator.UpdateSystems();
+					}
+
+					return (long long)count * passes;
+				} });
+
+			/*
+			* Flip components on and off with a large
+			* number of registered systems, so every
+			* signature change walks all of them.
+			*/
+			cases.push_back({ "signature_change_many_systems",
+				[](Coordinator& coordinator, int count)
+				{
+					RegisterDummySystems(coordinator, std::make_integer_sequence<int, DUMMY_SYSTEM_COUNT>());
+
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = coordinator.CreateEntity();
+						coordinator.AddComponent<Transform>(entity, MakeTransform(i));
+						coordinator.AddComponent<Renderable>(entity, Renderable{});
+					}
+				},
+				[](Coordinator& coordinator, int count)
+				{
+					for (int i = 0; i < count; i++)
+					{
+						coordinator.AddComponent<Health>((Entity)i, Health{ 10, 10 });
+						coordinator.AddComponent<Velocity>((Entity)i, Velocity{ Vector2(1, 1) });
+					}
+
+					for (int i = 0; i < count; i++)
+					{
+						coordinator.RemoveComponent<Health>((Entity)i);
+						coordinator.RemoveComponent<Velocity>((Entity)i);
+					}
+
+					return (long long)count * 4;
+				} });
+
+			/*
+			* Look up components for entities in a random
+			* order, which is the worst case for both the
+			* entity to index map and the component array.
+			*/
+			cases.push_back({ "random_get_component",
+				[](Coordinator& coordinator, int count)
+				{
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = coordinator.CreateEntity();
+						coordinator.AddComponent<Transform>(entity, MakeTransform(i));
+					}
+				},
+				[](Coordinator& coordinator, int count)
+				{
+					const int lookups = std::max(count * 4, 100000);
+					std::mt19937 rng(5678);
+					std::uniform_int_distribution<int> dist(0, count - 1);
+
+					float sum = 0;
+					for (int i = 0; i < lookups; i++)
+					{
+						sum += coordinator.GetComponent<Transform>((Entity)dist(rng)).position.x;
+					}
+					g_Sink = sum;
+
+					return (long long)lookups;
+				} });
+
+			/*
+			* Advance an Animator on every entity and write
+			* its frame into the Renderable, through the
+			* single pass AnimationClips does over both
+			* arrays. Half the clips have uneven frame
+			* durations so the frame search gets timed too.
+			*/
+			cases.push_back({ "animate_sprites",
+				[](Coordinator& coordinator, int count)
+				{
+					AnimationClips::clear();
+					for (int clip = 0; clip < 8; clip++)
+					{
+						std::vector<AnimationFrame> frames;
+						for (int frame = 0; frame < 4 + clip; frame++)
+						{
+							float duration = (clip % 2 == 0) ? 0.1f : 0.05f + 0.02f * (float)frame;
+							frames.push_back({ SDL_Rect { frame * 16, clip * 16, 16, 16 }, duration });
+						}
+						AnimationClips::addClip("clip" + std::to_string(clip), INVALID_TEXTURE, SDL_Point { 0, 0 }, frames);
+					}
+
+					for (int i = 0; i < count; i++)
+					{
+						Entity entity = coordinator.CreateEntity();
+						coordinator.AddComponent<Renderable>(entity, Renderable{});
+						coordinator.AddComponent<Animator>(entity, Animator{ (uint32_t)(i % 8), (float)(i % 7) * 0.03f, 0.5f + (float)(i % 5) * 0.25f });
+					}
+				},
+				[](Coordinator& coordinator, int count)
+				{
+					ComponentArray<Animator>& animators = *coordinator.GetComponentArray<Animator>();
+					ComponentArray<Renderable>& renderables = *coordinator.GetComponentArray<Renderable>();
+
+					const int passes = 10;
+					for (int pass = 0; pass < passes; pass++)
+					{
+						AnimationClips::animate(animators, renderables, 1.0f / 60.0f);
+					}
+					g_Sink = (float)renderables.Data()[0].sourceRect.x;
+
+					return (long long)count * passes;
+				} });
+
+			return cases;
+		}
+
+		Result RunCase(const Case& benchCase, int count, int reps)
+		{
+			std::vector<double> samples;
+			long long ops = 0;
+
+			for (int rep = 0; rep < reps; rep++)
+			{
+				std::unique_ptr<Coordinator> coordinator = MakeCoordinator();
+				benchCase.setup(*coordinator, count);
+
+				auto start = std::chrono::steady_clock::now();
+				ops = benchCase.run(*coordinator, count);
+				auto end = std::chrono::steady_clock::now();
+
+				double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+				samples.push_back(ns / (double)ops);
+			}
+
+			std::sort(samples.begin(), samples.end());
+			return { benchCase.name, count, ops, samples[samples.size() / 2], samples[0] };
+		}
+
+		std::vector<int> ParseCounts(const char* arg)
+		{
+			std::vector<int> counts;
+			std::string list = arg;
+			size_t start = 0;
+
+			while (start < list.size())
+			{
+				size_t end = list.find(',', start);
+				if (end == std::string::npos)
+				{
+					end = list.size();
+				}
+
+				counts.push_back(std::atoi(list.substr(start, end - start).c_str()));
+				start = end + 1;
+			}
+
+			return counts;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace Funny::Bench;
+
+	bool csv = false;
+	int reps = 5;
+	std::string filter;
+	std::vector<int> counts = { 100, 1000, 10000, Funny::MAX_ENTITIES };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--csv") == 0)
+		{
+			csv = true;
+		}
+
+		else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+		{
+			reps = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			filter = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--counts") == 0 && i + 1 < argc)
+		{
+			counts = ParseCounts(argv[++i]);
+		}
+
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--csv] [--reps N] [--filter name] [--counts 100,1000,...]" << std::endl;
+			return 1;
+		}
+	}
+
+	// Counts above the compiled entity limit can't be created, so drop them
+	counts.erase(std::remove_if(counts.begin(), counts.end(),
+		[](int count) { return count <= 0 || count > Funny::MAX_ENTITIES; }), counts.end());
+	std::sort(counts.begin(), counts.end());
+	counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+
+	if (csv)
+	{
+		std::cout << "suite,bench,entities,ops,ns_per_op_median,ns_per_op_min" << std::endl;
+	}
+
+	for (const Case& benchCase : MakeCases())
+	{
+		if (!filter.empty() && std::string(benchCase.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		for (int count : counts)
+		{
+			Result result = RunCase(benchCase, count, reps);
+
+			if (csv)
+			{
+				std::cout << "ecs," << result.name << "," << result.entities << "," << result.ops << ","
+					<< result.medianNs << "," << result.minNs << std::endl;
+			}
+
+			else
+			{
+				std::cout << "{\"suite\":\"ecs\",\"bench\":\"" << result.name << "\",\"entities\":" << result.entities
+					<< ",\"ops\":" << result.ops << ",\"ns_per_op_median\":" << result.medianNs
+					<< ",\"ns_per_op_min\":" << result.minNs << "}" << std::endl;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <thread>
+
+#include "Common.h"
+#include "LightMap.h"
+#include "Tilemap.h"
+
+/*
+* Times building a 1080p frame's light map with
+* 64 lights (half of them static) over a cave of
+* BLOCK tiles. Every thread count has to come out
+* the same as a single thread, cell for cell,
+* before it gets timed.
+*
+* The cases are a cold build where every light
+* works out its visibility polygon, a warm one
+* where static lights reuse theirs from the last
+* frame, and the static lights alone (so nothing
+* but the fill) for a lower bound.
+*
+* Usage:
+*   LightMapBenchmark [--csv] [--reps N] [--lights N] [--cell PIXELS] [--threads 1,4,...]
+*/
+namespace Funny
+{
+	namespace Bench
+	{
+		const int TILE_SIZE = 32;
+
+		struct Scene
+		{
+			std::vector<uint8_t> collision;
+			LightOccluders occluders;
+			std::vector<LightSource> lights;
+			std::vector<LightSource> staticLights;
+			Camera camera;
+		};
+
+		struct Result
+		{
+			std::string name;
+			int threads;
+			double medianUs;
+			double minUs;
+			LightMapStats stats;
+		};
+
+		/*
+		* A border wall, some solid pillars and a few
+		* long walls with gaps in them, so there are
+		* plenty of corners for shadows to come off.
+		*/
+		static void MakeScene(Scene& scene, int width, int height, int lightCount)
+		{
+			std::mt19937 rng(42);
+
+			const int columns = width / TILE_SIZE + 1;
+			const int rows = height / TILE_SIZE + 1;
+			scene.collision.assign(columns * rows, NONE);
+
+			auto block = [&](int x, int y)
+			{
+				if (x >= 0 && y >= 0 && x < columns && y < rows) { scene.collision[y * columns + x] = BLOCK; }
+			};
+
+			for (int x = 0; x < columns; x++) { block(x, 0); block(x, rows - 1); }
+			for (int y = 0; y < rows; y++) { block(0, y); block(columns - 1, y); }
+
+			std::uniform_int_distribution<int> column(2, columns - 3);
+			std::uniform_int_distribution<int> row(2, rows - 3);
+			std::uniform_int_distribution<int> size(1, 3);
+			for (int pillar = 0; pillar < 40; pillar++)
+			{
+				int x = column(rng);
+				int y = row(rng);
+				int w = size(rng);
+				int h = size(rng);
+				for (int dy = 0; dy < h; dy++)
+				{
+					for (int dx = 0; dx < w; dx++) { block(x + dx, y + dy); }
+				}
+			}
+
+			for (int wall = 1; wall <= 3; wall++)
+			{
+				int y = wall * rows / 4;
+				for (int x = 2; x < columns - 2; x++)
+				{
+					if (x % 12 > 2) { block(x, y); }
+				}
+			}
+
+			scene.occluders.collision = scene.collision.data();
+			scene.occluders.columns = columns;
+			scene.occluders.rows = rows;
+			scene.occluders.tileWidth = (float)TILE_SIZE;
+			scene.occluders.tileHeight = (float)TILE_SIZE;
+			scene.occluders.version = 1;
+
+			std::uniform_real_distribution<float> x((float)TILE_SIZE, (float)(width - TILE_SIZE));
+			std::uniform_real_distribution<float> y((float)TILE_SIZE, (float)(height - TILE_SIZE));
+			std::uniform_real_distribution<float> radius(120.0f, 420.0f);
+			std::uniform_real_distribution<float> channel(0.2f, 0.8f);
+
+			scene.lights.clear();
+			for (int i = 0; i < lightCount; i++)
+			{
+				LightSource light;
+				light.position.x = x(rng);
+				light.position.y = y(rng);
+				light.radius = radius(rng);
+				light.r = channel(rng);
+				light.g = channel(rng);
+				light.b = channel(rng);
+				light.isStatic = (i % 2 == 0);
+				light.id = (uint32_t)i;
+				scene.lights.push_back(light);
+			}
+
+			scene.staticLights.clear();
+			std::copy_if(scene.lights.begin(), scene.lights.end(), std::back_inserter(scene.staticLights), [](const LightSource& light) { return light.isStatic; });
+
+			scene.camera.position = Vector2(0, 0);
+			scene.camera.zoom = 1.0f;
+			scene.camera.viewport = SDL_Rect { 0, 0, width, height };
+		}
+
+		template <typename Prepare>
+		static Result Time(const char* name, LightMap& lightMap, int reps, Prepare prepare, const Scene& scene, const std::vector<LightSource>& lights, LightMapImage& image)
+		{
+			std::vector<double> times;
+			for (int rep = 0; rep < reps; rep++)
+			{
+				prepare();
+
+				auto start = std::chrono::steady_clock::now();
+				lightMap.Build(scene.camera, scene.occluders, lights, image);
+				auto end = std::chrono::steady_clock::now();
+
+				times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+			}
+
+			std::sort(times.begin(), times.end());
+			return { name, lightMap.GetThreadCount(), times[times.size() / 2], times.front(), lightMap.GetStats() };
+		}
+
+		static std::vector<int> ParseList(const char* text)
+		{
+			std::vector<int> values;
+			const char* cursor = text;
+			while (*cursor != '\0')
+			{
+				char* end = nullptr;
+				long value = std::strtol(cursor, &end, 10);
+				if (end == cursor) { break; }
+
+				values.push_back((int)value);
+				cursor = (*end == ',') ? end + 1 : end;
+			}
+			return values;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace Funny;
+	using namespace Funny::Bench;
+
+	bool csv = false;
+	int reps = 21;
+	int lightCount = 64;
+	int cellSize = 4;
+	const int width = 1920;
+	const int height = 1080;
+	std::vector<int> threadCounts = { 1, (int)std::max(1u, std::thread::hardware_concurrency()) };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--csv") == 0)
+		{
+			csv = true;
+		}
+
+		else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+		{
+			reps = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+		{
+			lightCount = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--cell") == 0 && i + 1 < argc)
+		{
+			cellSize = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCounts = ParseList(argv[++i]);
+		}
+
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--csv] [--reps N] [--lights N] [--cell PIXELS] [--threads 1,4,...]" << std::endl;
+			return 1;
+		}
+	}
+
+	threadCounts.erase(std::remove_if(threadCounts.begin(), threadCounts.end(), [](int threads) { return threads <= 0; }), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	if (csv)
+	{
+		std::cout << "suite,bench,lights,cell,threads,us_median,us_min,built,cached,points,width,height" << std::endl;
+	}
+
+	Scene scene;
+	MakeScene(scene, width, height, lightCount);
+
+	LightMapImage reference;
+	{
+		LightMap single(1);
+		single.SetCellSize(cellSize);
+		single.Build(scene.camera, scene.occluders, scene.lights, reference);
+	}
+
+	std::vector<Result> results;
+	for (int threads : threadCounts)
+	{
+		LightMap lightMap(threads);
+		lightMap.SetCellSize(cellSize);
+
+		LightMapImage image;
+		lightMap.Build(scene.camera, scene.occluders, scene.lights, image);
+		if (image.pixels != reference.pixels)
+		{
+			std::cerr << "Light map with " << threads << " threads doesn't match a single thread!" << std::endl;
+			return 2;
+		}
+
+		results.push_back(Time("cold", lightMap, reps, [&] { lightMap.ClearCache(); }, scene, scene.lights, image));
+		results.push_back(Time("static_cached", lightMap, reps, [] {}, scene, scene.lights, image));
+		results.push_back(Time("fill_only", lightMap, reps, [] {}, scene, scene.staticLights, image));
+	}
+
+	for (const Result& result : results)
+	{
+		if (csv)
+		{
+			std::cout << "light_map," << result.name << "," << result.stats.lights << "," << cellSize << "," << result.threads << ","
+				<< result.medianUs << "," << result.minUs << "," << result.stats.builtPolygons << "," << result.stats.cachedPolygons << ","
+				<< result.stats.polygonPoints << "," << result.stats.width << "," << result.stats.height << std::endl;
+		}
+
+		else
+		{
+			std::cout << "{\"suite\":\"light_map\",\"bench\":\"" << result.name << "\",\"lights\":" << result.stats.lights
+				<< ",\"cell\":" << cellSize << ",\"threads\":" << result.threads
+				<< ",\"us_median\":" << result.medianUs << ",\"us_min\":" << result.minUs
+				<< ",\"built\":" << result.stats.builtPolygons << ",\"cached\":" << result.stats.cachedPolygons
+				<< ",\"points\":" << result.stats.polygonPoints << ",\"width\":" << result.stats.width << ",\"height\":" << result.stats.height << "}" << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "Common.h"
+#include "SpriteRasterizer.h"
+
+/*
+* Times the CPU sprite rasterizer drawing a
+* 1080p frame full of sprites, against the
+* single threaded scalar reference. Before any
+* timing, each configuration draws the scene
+* once and has to match the reference pixel for
+* pixel, otherwise we bail with an error code.
+*
+* Sprites use a few generated textures (solid,
+* soft edged and checkered), get scaled anywhere
+* from a bit smaller to a lot bigger than their
+* texture, and about half are translucent.
+*
+* Usage:
+*   SpriteRasterBenchmark [--csv] [--reps N] [--width W] [--height H] [--counts 10000,50000,...] [--threads 1,4,...]
+*/
+namespace Funny
+{
+	namespace Bench
+	{
+		struct Scene
+		{
+			std::vector<std::vector<uint32_t>> texturePixels;
+			std::vector<RasterImage> textures;
+			std::vector<RasterSprite> sprites;
+		};
+
+		struct Result
+		{
+			std::string name;
+			int threads;
+			double medianUs;
+			double minUs;
+		};
+
+		static uint32_t Pack(uint32_t a, uint32_t r, uint32_t g, uint32_t b)
+		{
+			return (a << 24) | (r << 16) | (g << 8) | b;
+		}
+
+		static void MakeTextures(Scene& scene)
+		{
+			const int size = 32;
+			scene.texturePixels.assign(3, std::vector<uint32_t>(size * size));
+
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					float dx = (float)x + 0.5f - size / 2.0f;
+					float dy = (float)y + 0.5f - size / 2.0f;
+					float distance = std::sqrt(dx * dx + dy * dy) / (size / 2.0f);
+					uint32_t edge = (uint32_t)(255.0f * std::max(0.0f, std::min(1.0f, (1.0f - distance) * 4.0f)));
+
+					scene.texturePixels[0][y * size + x] = Pack(255, 255, 255, 255);
+					scene.texturePixels[1][y * size + x] = Pack(edge, 255, 255 - x * 4, 128 + y * 4);
+					scene.texturePixels[2][y * size + x] = ((x / 8 + y / 8) % 2 == 0) ? Pack(255, 240, 240, 240) : Pack(96, 32, 32, 32);
+				}
+			}
+
+			for (std::vector<uint32_t>& pixels : scene.texturePixels)
+			{
+				RasterImage image;
+				image.pixels = pixels.data();
+				image.width = size;
+				image.height = size;
+				image.pitch = size;
+				scene.textures.push_back(image);
+			}
+		}
+
+		static void MakeSprites(Scene& scene, int count, int width, int height)
+		{
+			std::mt19937 rng(1234);
+			std::uniform_real_distribution<float> x(-32.0f, (float)width);
+			std::uniform_real_distribution<float> y(-32.0f, (float)height);
+			std::uniform_real_distribution<float> size(12.0f, 72.0f);
+			std::uniform_int_distribution<int> texture(0, (int)scene.textures.size() - 1);
+			std::uniform_int_distribution<int> channel(64, 255);
+			std::uniform_int_distribution<int> coin(0, 1);
+
+			scene.sprites.resize(count);
+			for (RasterSprite& sprite : scene.sprites)
+			{
+				sprite.texture = &scene.textures[texture(rng)];
+				sprite.src = SDL_Rect { 0, 0, sprite.texture->width, sprite.texture->height };
+				float w = size(rng);
+				float h = size(rng);
+				sprite.dst = SDL_FRect { x(rng), y(rng), w, h };
+				Uint8 r = (Uint8)channel(rng);
+				Uint8 g = (Uint8)channel(rng);
+				Uint8 b = (Uint8)channel(rng);
+				Uint8 a = coin(rng) ? 255 : (Uint8)channel(rng);
+				sprite.color = SDL_Color { r, g, b, a };
+			}
+		}
+
+		static void Clear(std::vector<uint32_t>& pixels)
+		{
+			std::fill(pixels.begin(), pixels.end(), Pack(255, 24, 24, 32));
+		}
+
+		template <typename Draw>
+		static Result Time(const char* name, int threads, int reps, std::vector<uint32_t>& pixels, Draw draw)
+		{
+			std::vector<double> times;
+			for (int rep = 0; rep < reps; rep++)
+			{
+				Clear(pixels);
+
+				auto start = std::chrono::steady_clock::now();
+				draw();
+				auto end = std::chrono::steady_clock::now();
+
+				times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+			}
+
+			std::sort(times.begin(), times.end());
+			return { name, threads, times[times.size() / 2], times.front() };
+		}
+
+		static std::vector<int> ParseList(const char* text)
+		{
+			std::vector<int> values;
+			const char* cursor = text;
+			while (*cursor != '\0')
+			{
+				char* end = nullptr;
+				long value = std::strtol(cursor, &end, 10);
+				if (end == cursor) { break; }
+
+				values.push_back((int)value);
+				cursor = (*end == ',') ? end + 1 : end;
+			}
+			return values;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace Funny;
+	using namespace Funny::Bench;
+
+	bool csv = false;
+	int reps = 11;
+	int width = 1920;
+	int height = 1080;
+	std::vector<int> counts = { 10000, 50000 };
+	std::vector<int> threadCounts = { 1, (int)std::max(1u, std::thread::hardware_concurrency()) };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--csv") == 0)
+		{
+			csv = true;
+		}
+
+		else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+		{
+			reps = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+		{
+			width = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+		{
+			height = std::max(1, std::atoi(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--counts") == 0 && i + 1 < argc)
+		{
+			counts = ParseList(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCounts = ParseList(argv[++i]);
+		}
+
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [--csv] [--reps N] [--width W] [--height H] [--counts 10000,50000,...] [--threads 1,4,...]" << std::endl;
+			return 1;
+		}
+	}
+
+	threadCounts.erase(std::remove_if(threadCounts.begin(), threadCounts.end(), [](int threads) { return threads <= 0; }), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	if (csv)
+	{
+		std::cout << "suite,bench,sprites,width,height,threads,us_median,us_min" << std::endl;
+	}
+
+	Scene scene;
+	MakeTextures(scene);
+
+	std::vector<uint32_t> reference(width * height);
+	std::vector<uint32_t> pixels(width * height);
+	RasterImage target { pixels.data(), width, height, width };
+	RasterImage referenceTarget { reference.data(), width, height, width };
+
+	for (int count : counts)
+	{
+		MakeSprites(scene, count, width, height);
+
+		std::vector<Result> results;
+		results.push_back(Time("reference", 1, reps, reference, [&] { SpriteRasterizer::DrawReference(referenceTarget, scene.sprites); }));
+
+		for (int threads : threadCounts)
+		{
+			SpriteRasterizer rasterizer(threads);
+
+			Clear(pixels);
+			rasterizer.Draw(target, scene.sprites);
+			if (pixels != reference)
+			{
+				std::cerr << "Tiled output with " << threads << " threads doesn't match the reference at " << count << " sprites!" << std::endl;
+				return 2;
+			}
+
+			results.push_back(Time("tiled", threads, reps, pixels, [&] { rasterizer.Draw(target, scene.sprites); }));
+		}
+
+		for (const Result& result : results)
+		{
+			if (csv)
+			{
+				std::cout << "sprite_raster," << result.name << "," << count << "," << width << "," << height << ","
+					<< result.threads << "," << result.medianUs << "," << result.minUs << std::endl;
+			}
+
+			else
+			{
+				std::cout << "{\"suite\":\"sprite_raster\",\"bench\":\"" << result.name << "\",\"sprites\":" << count
+					<< ",\"width\":" << width << ",\"height\":" << height << ",\"threads\":" << result.threads
+					<< ",\"us_median\":" << result.medianUs << ",\"us_min\":" << result.minUs << "}" << std::endl;
+			}
+		}
+	}
+
+	return 0;
+}
@@ -1,17 +1,326 @@
 #include "Engine.h"
+#include "ResourceManager.h"
+#include "RenderBenchmark.h"
+#include "AssetBenchmark.h"
+#include "LevelLoader.h"
 
+#include <cstdlib>
+#include <cstring>
+
+/*
+* Command line options:
+*   --headless       Run without a window or renderer
+*   --free-run       Step simulation as fast as possible instead of at the tick rate
+*   --tick-rate N    Simulation ticks per second
+*   --max-ticks N    Quit after N simulation ticks (handy for soak tests and benchmarks)
+*   --startup-budget MS  Exit with an error code if the first frame took longer than MS to show up
+*   --no-atlas       Give every startup texture its own SDL texture instead of packing them into an atlas
+*   --texture-budget MB  Evict textures that haven't been drawn lately once they take up more than MB, uploading them again when needed
+*   --upload-budget MS   Time per frame spent uploading textures that finished loading in the background (default 2)
+*   --render-lockstep  Draw each frame on the main thread instead of overlapping it with the next on a render thread
+*   --offscreen      Render into an offscreen surface instead of a window, with sprites drawn by our tiled rasterizer
+*   --sdl-raster     Offscreen, draw sprites with SDL's software renderer instead of our rasterizer
+*   --partial-redraw  Only redraw what changed since the last frame, and skip frames where nothing did
+*
+* Frame capture (frames are dropped rather than slowing the game down when the disk can't keep up):
+*   --record DIR          Write every presented frame into DIR as a numbered image sequence, with timings in DIR/capture.txt
+*   --record-format FMT   png (default) or raw ARGB8888 dumps
+*   --record-interval N   Only record every Nth frame
+*   --record-buffers N    Frames that can wait on the encoder before we start dropping (default 8)
+*
+* Render benchmarks (these imply --offscreen and --free-run):
+*   --render-bench SCENE  Play a scripted scene (sprites, tilemap, mixed, text or lights), print frame times and the final frame's hash, then quit
+*   --bench-frames N      Frames to time (default 300)
+*   --bench-warmup N      Frames to play before timing starts (default 10)
+*   --bench-sprites N     Sprites (or labels) in the sprites, mixed and text scenes (default 900)
+*   --bench-font FILE     TTF to draw the text scene's labels with
+*   --golden FILE         Exit with an error code if the final frame's hash doesn't match the one in FILE, or record it if FILE doesn't exist
+*   --capture FILE        Save the final frame as a BMP
+*   --compare-raster      Draw the final frame again with SDL's software renderer and report how it differs from our rasterizer's
+*
+* Asset archives:
+*   --pack-assets FILE    Decode every PNG in assets/ into an archive at FILE, then quit (no window needed)
+*   --asset-archive FILE  Load any image that's in the archive at FILE from there instead of decoding its PNG
+*   --asset-bench FILE    Time loading assets/ from its PNGs, the decode cache (in an emptied temporary directory) and an archive packed into FILE, cold (file cache dropped, Linux only) and warm, then quit (implies --offscreen)
+*
+* Decode cache (decoded images kept on disk so later launches skip decoding, on by default):
+*   --decode-cache DIR       Keep the cache in DIR instead of cache/decoded
+*   --decode-cache-size MB   Delete the least recently used entries once the cache is bigger than MB (default 256, 0 for no limit)
+*   --no-decode-cache        Decode every image every launch
+*
+* Levels:
+*   --level FILE       Start in the level described by the manifest at FILE instead of assets/levels/sandbox.level
+*   --next-level FILE  Load the level at FILE in the background once the game's running, and switch to it when it's ready
+*/
 int main(int argc, char* argv[])
 {
+	Funny::Profiler::markStartup("main");
+
+	bool headless = false;
+	uint64_t maxTicks = 0;
+
+	bool recordFrames = false;
+	Funny::FrameCaptureSettings captureSettings;
+
+	bool renderBenchmark = false;
+	Funny::RenderBenchmarkSettings benchSettings;
+
+	bool assetBenchmark = false;
+	Funny::AssetBenchmarkSettings assetBenchSettings;
+
+	std::string nextLevel;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+
+		else if (std::strcmp(argv[i], "--free-run") == 0)
+		{
+			Funny::Engine::setFreeRunning(true);
+		}
+
+		else if (std::strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+		{
+			int tickRate = std::atoi(argv[++i]);
+			if (tickRate > 0)
+			{
+				Funny::Engine::setTickRate(tickRate);
+			}
+		}
+
+		else if (std::strcmp(argv[i], "--max-ticks") == 0 && i + 1 < argc)
+		{
+			maxTicks = std::strtoull(argv[++i], nullptr, 10);
+		}
+
+		else if (std::strcmp(argv[i], "--startup-budget") == 0 && i + 1 < argc)
+		{
+			Funny::Engine::setStartupBudget((float)std::atof(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--no-atlas") == 0)
+		{
+			Funny::ResourceManager::setAtlasEnabled(false);
+		}
+
+		else if (std::strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+		{
+			Funny::ResourceManager::setTextureBudget((size_t)(std::atof(argv[++i]) * 1024.0 * 1024.0));
+		}
+
+		else if (std::strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc)
+		{
+			Funny::ResourceManager::setUploadBudget((float)std::atof(argv[++i]));
+		}
+
+		else if (std::strcmp(argv[i], "--render-lockstep") == 0)
+		{
+			Funny::Engine::setRenderLockstep(true);
+		}
+
+		else if (std::strcmp(argv[i], "--offscreen") == 0)
+		{
+			Funny::Engine::setOffscreen(true);
+		}
+
+		else if (std::strcmp(argv[i], "--sdl-raster") == 0)
+		{
+			Funny::Engine::setSoftwareRaster(false);
+		}
+
+		else if (std::strcmp(argv[i], "--partial-redraw") == 0)
+		{
+			Funny::Engine::setPartialRedraw(true);
+		}
+
+		else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+		{
+			recordFrames = true;
+			captureSettings.directory = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--record-format") == 0 && i + 1 < argc)
+		{
+			const char* format = argv[++i];
+			if (std::strcmp(format, "png") == 0)
+			{
+				captureSettings.format = Funny::CaptureFormat::PNG;
+			}
+
+			else if (std::strcmp(format, "raw") == 0)
+			{
+				captureSettings.format = Funny::CaptureFormat::RAW;
+			}
+
+			else
+			{
+				std::cout << "Unknown capture format " << format << ", expected png or raw" << std::endl;
+				return 1;
+			}
+		}
+
+		else if (std::strcmp(argv[i], "--record-interval") == 0 && i + 1 < argc)
+		{
+			captureSettings.interval = std::atoi(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--record-buffers") == 0 && i + 1 < argc)
+		{
+			captureSettings.buffers = std::atoi(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--render-bench") == 0 && i + 1 < argc)
+		{
+			renderBenchmark = true;
+			benchSettings.scene = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc)
+		{
+			benchSettings.frames = std::atoi(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--bench-warmup") == 0 && i + 1 < argc)
+		{
+			benchSettings.warmupFrames = std::atoi(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--bench-sprites") == 0 && i + 1 < argc)
+		{
+			benchSettings.sprites = std::atoi(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--bench-font") == 0 && i + 1 < argc)
+		{
+			benchSettings.fontPath = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+		{
+			benchSettings.goldenPath = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			benchSettings.capturePath = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--compare-raster") == 0)
+		{
+			benchSettings.compareRaster = true;
+		}
+
+		else if (std::strcmp(argv[i], "--pack-assets") == 0 && i + 1 < argc)
+		{
+			return Funny::ResourceManager::packAssets("assets", argv[++i]) ? 0 : 1;
+		}
+
+		else if (std::strcmp(argv[i], "--asset-archive") == 0 && i + 1 < argc)
+		{
+			if (!Funny::ResourceManager::openArchive(argv[++i]))
+			{
+				std::cout << "Falling back to loading images from their files" << std::endl;
+			}
+		}
+
+		else if (std::strcmp(argv[i], "--decode-cache") == 0 && i + 1 < argc)
+		{
+			Funny::ResourceManager::setDecodeCacheDirectory(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--decode-cache-size") == 0 && i + 1 < argc)
+		{
+			Funny::ResourceManager::setDecodeCacheBudget((size_t)(std::atof(argv[++i]) * 1024.0 * 1024.0));
+		}
+
+		else if (std::strcmp(argv[i], "--no-decode-cache") == 0)
+		{
+			Funny::ResourceManager::setDecodeCacheEnabled(false);
+		}
+
+		else if (std::strcmp(argv[i], "--asset-bench") == 0 && i + 1 < argc)
+		{
+			assetBenchmark = true;
+			assetBenchSettings.archivePath = argv[++i];
+		}
+
+		else if (std::strcmp(argv[i], "--level") == 0 && i + 1 < argc)
+		{
+			Funny::Engine::setStartLevel(argv[++i]);
+		}
+
+		else if (std::strcmp(argv[i], "--next-level") == 0 && i + 1 < argc)
+		{
+			nextLevel = argv[++i];
+		}
+	}
+
+	if (renderBenchmark)
+	{
+		if (!Funny::RenderBenchmark::isScene(benchSettings.scene))
+		{
+			std::cout << "Unknown render benchmark scene " << benchSettings.scene << std::endl;
+			return 1;
+		}
+
+		// Frames should go as fast as they can and look the same on every machine
+		Funny::Engine::setOffscreen(true);
+		Funny::Engine::setFreeRunning(true);
+		Funny::Engine::setFrameRateLimit(0);
+		headless = false;
+	}
+
+	if (assetBenchmark)
+	{
+		Funny::Engine::setOffscreen(true);
+		headless = false;
+	}
+
+	if (recordFrames)
+	{
+		Funny::Engine::setFrameCapture(captureSettings);
+	}
+
 	Funny::Engine* engine = nullptr;
 	engine = Funny::Engine::createInstance();
-	engine->init("Funny", 640, 480);
+	if (!engine->init("Funny", 640, 480, headless))
+	{
+		return 1;
+	}
 
-	while (engine->gameLoop())
+	if (renderBenchmark)
+	{
+		int result = Funny::RenderBenchmark::run(engine, benchSettings);
+		engine->close();
+		delete(engine);
+		return result;
+	}
+
+	if (assetBenchmark)
+	{
+		int result = Funny::AssetBenchmark::run(assetBenchSettings);
+		engine->close();
+		delete(engine);
+		return result;
+	}
+
+	if (!nextLevel.empty())
 	{
+		Funny::LevelLoader::loadLevel(nextLevel);
+	}
 
+	while (engine->gameLoop())
+	{
+		if (maxTicks > 0 && Funny::Engine::getTickCount() >= maxTicks)
+		{
+			break;
+		}
 	}
 
 	engine->close();
 	delete(engine);
-	return 0;
-}
\ No newline at end of file
+	return Funny::Engine::startupWithinBudget() ? 0 : 2;
+}